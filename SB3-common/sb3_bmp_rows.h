@@ -0,0 +1,198 @@
+/*
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 AyAztuB
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ *
+ * AUTHOR
+ *
+ * AyAztuB (ayaztub@gmail.com) from https://github.com/AyAztuB/SB3-Project
+ *
+ */
+
+
+
+#ifndef __SB3_BMP_ROWS_H__
+#define __SB3_BMP_ROWS_H__
+
+// bmp scanline kernels shared by the dev and release libraries (header only: everything is static inline)
+// a codec picks one kernel per file from (file depth x image format), the hot loops are then only loads, lookups
+// and stores: the palette bounds and the grayness of a row are collected in flags checked once per row
+
+#include <stdint.h>
+#include <string.h>
+
+// flags returned by the decoding kernels
+#define __SB3_BMP_OUT_OF_TABLE 1 // index outside of the color table
+#define __SB3_BMP_NOT_GRAY 2 // color with r, g, b not equal
+
+// destinations of the decoding kernels
+typedef enum {
+    __SB3_BMP_TO_RGB, // 3 bytes r, g, b
+    __SB3_BMP_TO_GRAY, // 1 byte (mono and binary images)
+    __SB3_BMP_TO_INDEX, // 1 byte index in the color table
+} __SB3_BMP_destination_t;
+
+// color table of a file expanded once for the lookups
+typedef struct {
+    uint8_t rgb[256 * 3];
+    uint8_t gray[256];
+    uint8_t flags[256];
+} __SB3_BMP_lut_t;
+
+// color_table: colors_used BGRA entries (only the 256 first ones are read)
+static inline void __SB3_BMP_lut(__SB3_BMP_lut_t* lut, const uint8_t* color_table, uint32_t colors_used)
+{
+    for(uint32_t i = 0; i < 256; i++)
+    {
+        uint8_t r = 0, g = 0, b = 0;
+        if(i < colors_used)
+        {
+            b = color_table[i*4+0];
+            g = color_table[i*4+1];
+            r = color_table[i*4+2];
+        }
+        lut->rgb[i*3+0] = r;
+        lut->rgb[i*3+1] = g;
+        lut->rgb[i*3+2] = b;
+        lut->gray[i] = r;
+        lut->flags[i] = (i >= colors_used ? __SB3_BMP_OUT_OF_TABLE : 0) | (r != g || g != b ? __SB3_BMP_NOT_GRAY : 0);
+    }
+}
+
+// index of pixel x in a scanline of bits per pixel indexes (first pixel in the most significant bits)
+#define __SB3_BMP_INDEX(src, x, bits) \
+    (((src)[(size_t)(x) * (bits) / 8] >> (8 - (bits) - (x) * (bits) % 8)) & ((1 << (bits)) - 1))
+
+#define __SB3_BMP_STORE_RGB(dst, x, index, lut) memcpy((dst) + (size_t)(x) * 3, (lut)->rgb + (index) * 3, 3)
+#define __SB3_BMP_STORE_GRAY(dst, x, index, lut) ((dst)[x] = (lut)->gray[index])
+#define __SB3_BMP_STORE_INDEX(dst, x, index, lut) ((dst)[x] = (index))
+
+// decode width pixels of a scanline (src == dst allowed when both have the same size), return the flags met
+typedef uint8_t (*__SB3_BMP_decode_t)(const uint8_t* src, uint8_t* dst, int width, const __SB3_BMP_lut_t* lut);
+
+#define __SB3_BMP_PALETTE_KERNEL(bits, name, STORE) \
+    static inline uint8_t __SB3_BMP_decode##bits##_##name(const uint8_t* src, uint8_t* dst, int width, const __SB3_BMP_lut_t* lut) \
+    { \
+        uint8_t flags = 0; \
+        for(int x = 0; x < width; x++) \
+        { \
+            unsigned index = __SB3_BMP_INDEX(src, x, bits); \
+            flags |= lut->flags[index]; \
+            STORE(dst, x, index, lut); \
+        } \
+        return flags; \
+    }
+
+#define __SB3_BMP_PALETTE_KERNELS(bits) \
+    __SB3_BMP_PALETTE_KERNEL(bits, rgb, __SB3_BMP_STORE_RGB) \
+    __SB3_BMP_PALETTE_KERNEL(bits, gray, __SB3_BMP_STORE_GRAY) \
+    __SB3_BMP_PALETTE_KERNEL(bits, index, __SB3_BMP_STORE_INDEX)
+
+__SB3_BMP_PALETTE_KERNELS(1)
+__SB3_BMP_PALETTE_KERNELS(2)
+__SB3_BMP_PALETTE_KERNELS(4)
+__SB3_BMP_PALETTE_KERNELS(8)
+
+// b, g, r <-> r, g, b (src == dst allowed)
+static inline void __SB3_BMP_swap_rb(const uint8_t* src, uint8_t* dst, int width)
+{
+    for(int x = 0; x < width; x++)
+    {
+        uint8_t first = src[x*3+0], second = src[x*3+1], third = src[x*3+2];
+        dst[x*3+0] = third;
+        dst[x*3+1] = second;
+        dst[x*3+2] = first;
+    }
+}
+
+static inline uint8_t __SB3_BMP_decode24_rgb(const uint8_t* src, uint8_t* dst, int width, const __SB3_BMP_lut_t* lut)
+{
+    (void)lut;
+    __SB3_BMP_swap_rb(src, dst, width);
+    return 0;
+}
+
+static inline uint8_t __SB3_BMP_decode24_gray(const uint8_t* src, uint8_t* dst, int width, const __SB3_BMP_lut_t* lut)
+{
+    (void)lut;
+    uint8_t differ = 0;
+    for(int x = 0; x < width; x++)
+    {
+        differ |= (src[x*3+0] ^ src[x*3+1]) | (src[x*3+1] ^ src[x*3+2]);
+        dst[x] = src[x*3+2];
+    }
+    return differ ? __SB3_BMP_NOT_GRAY : 0;
+}
+
+// kernel of a file depth and a destination, NULL for an unsupported pair
+static inline __SB3_BMP_decode_t __SB3_BMP_decoder(int bits, __SB3_BMP_destination_t destination)
+{
+    switch(bits)
+    {
+        case 1:
+            return destination == __SB3_BMP_TO_RGB ? __SB3_BMP_decode1_rgb : destination == __SB3_BMP_TO_GRAY ? __SB3_BMP_decode1_gray : __SB3_BMP_decode1_index;
+        case 2:
+            return destination == __SB3_BMP_TO_RGB ? __SB3_BMP_decode2_rgb : destination == __SB3_BMP_TO_GRAY ? __SB3_BMP_decode2_gray : __SB3_BMP_decode2_index;
+        case 4:
+            return destination == __SB3_BMP_TO_RGB ? __SB3_BMP_decode4_rgb : destination == __SB3_BMP_TO_GRAY ? __SB3_BMP_decode4_gray : __SB3_BMP_decode4_index;
+        case 8:
+            return destination == __SB3_BMP_TO_RGB ? __SB3_BMP_decode8_rgb : destination == __SB3_BMP_TO_GRAY ? __SB3_BMP_decode8_gray : __SB3_BMP_decode8_index;
+        case 24:
+            return destination == __SB3_BMP_TO_RGB ? __SB3_BMP_decode24_rgb : destination == __SB3_BMP_TO_GRAY ? __SB3_BMP_decode24_gray : NULL;
+        default:
+            return NULL;
+    }
+}
+
+// pack width indexes on bits per pixel (dst: (width * bits + 7) / 8 bytes), return non zero if an index reaches limit
+#define __SB3_BMP_PACK_KERNEL(bits) \
+    static inline uint8_t __SB3_BMP_pack##bits(const uint8_t* src, uint8_t* dst, int width, unsigned limit) \
+    { \
+        uint8_t outside = 0; \
+        memset(dst, 0, ((size_t)width * (bits) + 7) / 8); \
+        for(int x = 0; x < width; x++) \
+        { \
+            outside |= src[x] >= limit; \
+            dst[(size_t)x * (bits) / 8] |= src[x] << (8 - (bits) - x * (bits) % 8); \
+        } \
+        return outside; \
+    }
+
+__SB3_BMP_PACK_KERNEL(1)
+__SB3_BMP_PACK_KERNEL(4)
+__SB3_BMP_PACK_KERNEL(8)
+
+// pack width black (0) and white (255) pixels on 1 bit, return non zero if another value is met
+static inline uint8_t __SB3_BMP_pack_binary(const uint8_t* src, uint8_t* dst, int width)
+{
+    uint8_t other = 0;
+    memset(dst, 0, ((size_t)width + 7) / 8);
+    for(int x = 0; x < width; x++)
+    {
+        other |= (uint8_t)(src[x] + 1) > 1;
+        dst[x / 8] |= (src[x] & 1) << (7 - x % 8);
+    }
+    return other;
+}
+
+#endif // __SB3_BMP_ROWS_H__
@@ -33,6 +33,7 @@
 #ifndef __SB3_DEV_H__
 #define __SB3_DEV_H__
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
 
@@ -44,6 +45,7 @@ typedef enum {
     SB3_DEV_RGB_FORMAT,
     SB3_DEV_MONO_COLOR_FORMAT,
     SB3_DEV_BINARY_COLOR_FORMAT, // only white and black
+    SB3_DEV_INDEXED_FORMAT, // one byte index per pixel in palette (1, 2, 4 or 8 bits bmp files)
 } SB3_DEV_image_format_t;
 
 typedef enum {
@@ -55,8 +57,37 @@ typedef enum {
     SB3_DEV_NULL_IMAGE_ERROR,
     SB3_DEV_UNSUPORTED_BMP_FORMAT_ERROR,
     SB3_DEV_NULL_PATH_ERROR,
+    SB3_DEV_NULL_PIPELINE_ERROR,
+    SB3_DEV_OUT_OF_BOUNDS_ERROR,
+    SB3_DEV_IO_ERROR,
+    SB3_DEV_SIZE_MISMATCH_ERROR,
+    SB3_DEV_NULL_BUFFER_ERROR,
+    SB3_DEV_BUFFER_TOO_SMALL_ERROR,
+    SB3_DEV_IMAGES_MISMATCH_ERROR,
+    SB3_DEV_OUT_OF_MEMORY_ERROR,
 } SB3_DEV_errors_t;
 
+typedef enum {
+    SB3_DEV_SOBEL_OPERATOR,
+    SB3_DEV_SCHARR_OPERATOR,
+} SB3_DEV_gradient_operator_t;
+
+typedef enum {
+    SB3_DEV_RECT_ELEMENT,
+    SB3_DEV_CROSS_ELEMENT,
+} SB3_DEV_structuring_element_t;
+
+// orientation changes, as the image is displayed
+typedef enum {
+    SB3_DEV_ROTATE_90, // clockwise
+    SB3_DEV_ROTATE_180,
+    SB3_DEV_ROTATE_270,
+    SB3_DEV_FLIP_HORIZONTAL, // left / right mirror
+    SB3_DEV_FLIP_VERTICAL, // upside down
+    SB3_DEV_TRANSPOSE, // mirror over the top-left / bottom-right diagonal
+    SB3_DEV_TRANSVERSE, // mirror over the top-right / bottom-left diagonal
+} SB3_DEV_transform_t;
+
 // STRUCTS
 
 typedef struct {
@@ -67,12 +98,20 @@ typedef struct {
     uint8_t color;
 } SB3_DEV_monoColor_t;
 
+// reference counted pixel storage, shared by an image and its views (see SB3_DEV_crop)
+typedef struct SB3_DEV_buffer_s SB3_DEV_buffer_t;
+
 typedef struct {
     union {int w; int width;};
     union {int h; int height;};
     SB3_DEV_image_format_t format;
     SB3_DEV_RGBColor_t** rgb_pixels;
     SB3_DEV_monoColor_t** mono_pixels;
+    void* pixels; // first row of the row-major storage, rgb_pixels / mono_pixels point into it
+    size_t stride; // bytes from a row to the next one (w * pixel size, more for views)
+    SB3_DEV_buffer_t* buffer; // storage owning pixels
+    SB3_DEV_RGBColor_t* palette; // SB3_DEV_INDEXED_FORMAT only: 256 entries, palette_size used
+    int palette_size;
 } SB3_DEV_image_t;
 
 typedef struct {
@@ -80,13 +119,109 @@ typedef struct {
     double* kernel;
 } SB3_DEV_kernel_t;
 
+// sequence of stages run row by row (see SB3_DEV_NewPipeline)
+typedef struct SB3_DEV_pipeline_s SB3_DEV_pipeline_t;
+
+// bmp file metadata (see SB3_DEV_BMP_probe)
+typedef struct {
+    int width, height; // height < 0 for top-down files
+    int bits_per_pixels;
+    uint32_t compression;
+    uint32_t colors_used; // palette entries stored in the file (0: 2^bits_per_pixels)
+    uint32_t file_size;
+    uint32_t pixel_array_offset;
+    uint32_t info_header_size;
+} SB3_DEV_BMP_info_t;
+
+// bmp writing options (see SB3_DEV_BMP_write_image_opt), zero initialized: same as SB3_DEV_BMP_write_image
+typedef struct {
+    int quantize; // 0: keep the image format, 2 to 256: palette of at most quantize colors (<= 16: 4 bits file, else 8 bits)
+    char top_down; // scanlines stored from the top row (negative height), read back by every reader
+} SB3_DEV_BMP_options_t;
+
+// lazy image graph (see SB3_DEV_NewGraph)
+typedef struct SB3_DEV_graph_s SB3_DEV_graph_t;
+typedef struct SB3_DEV_node_s SB3_DEV_node_t;
+
+// custom io (see SB3_DEV_BMP_decode_io): read / write return the bytes transferred (0 at the end, < 0 on error),
+// seek (may be NULL) works as lseek (whence: SEEK_SET, SEEK_CUR or SEEK_END) and returns < 0 on error
+typedef struct {
+    long (*read)(void* handle, void* data, size_t size);
+    long (*write)(void* handle, const void* data, size_t size);
+    long (*seek)(void* handle, long offset, int whence);
+    void* handle;
+} SB3_DEV_io_t;
+
+// caller owned memory of SB3_DEV_io_memory: reads data[position, size), writes up to capacity (size grows with them)
+typedef struct {
+    void* data;
+    size_t size, capacity, position;
+} SB3_DEV_memory_t;
+
+// library memory accounting (see SB3_DEV_GetAllocatorStats)
+typedef struct {
+    size_t live_bytes; // allocated and not freed yet
+    size_t peak_bytes; // highest live_bytes since the last reset
+    size_t allocations; // count since the last reset
+} SB3_DEV_allocator_stats_t;
+
+// memory accounting of one operation (see SB3_DEV_NewAllocatorScope)
+typedef struct SB3_DEV_allocator_scope_s SB3_DEV_allocator_scope_t;
+
 // FUNCTIONS
 
-// last error message (don't reset it)
+// last error message of the calling thread (don't reset it)
 char* SB3_DEV_GetError(void);
+// release a raw buffer returned by the library (convolution results)
+void SB3_DEV_Free(void* ptr);
+// allocator of the library (NULL malloc_fn or free_fn: back to malloc / free), set it before any allocation
+// aligned_alloc_fn (may be NULL) receives the pixel blocks, its memory is released by free_fn
+// everything given to the caller comes from it too: release it with the matching Free function (SB3_DEV_Free for raw buffers)
+void SB3_DEV_SetAllocator(void* (*malloc_fn)(size_t size, void* userdata), void (*free_fn)(void* ptr, void* userdata),
+        void* (*aligned_alloc_fn)(size_t alignment, size_t size, void* userdata), void* userdata);
+// counters shared by every thread: reset them before an operation to get its peak and allocation count
+void SB3_DEV_GetAllocatorStats(SB3_DEV_allocator_stats_t* stats);
+void SB3_DEV_ResetAllocatorStats(void);
+// per operation counters (concurrent requests each get their own): the blocks allocated while a scope is set on
+// the calling thread are counted in it, including the ones of the workers of its calls, until they are freed
+SB3_DEV_allocator_scope_t* SB3_DEV_NewAllocatorScope(void);
+// the scope stays valid until its last block is freed
+void SB3_DEV_FreeAllocatorScope(SB3_DEV_allocator_scope_t* scope);
+// scope of the calling thread (NULL: none), returns the previous one
+SB3_DEV_allocator_scope_t* SB3_DEV_SetAllocatorScope(SB3_DEV_allocator_scope_t* scope);
+void SB3_DEV_GetAllocatorScopeStats(SB3_DEV_allocator_scope_t* scope, SB3_DEV_allocator_stats_t* stats);
 // read and write bitmap files
 SB3_DEV_errors_t SB3_DEV_BMP_write_image(const char* path, SB3_DEV_image_t* image);
 SB3_DEV_image_t* SB3_DEV_BMP_read_image(const char* path, SB3_DEV_image_format_t format);
+// decode into an existing image / a raw buffer (rows bottom to top, 3 bytes r, g, b per pixel or 1 byte) without any allocation
+// (the palette of an indexed file is only kept by read_into)
+// fail with SB3_DEV_SIZE_MISMATCH_ERROR if the file hasn't the same dimensions (the content is undefined after a decoding error)
+SB3_DEV_errors_t SB3_DEV_BMP_read_into(const char* path, SB3_DEV_image_t* image);
+SB3_DEV_errors_t SB3_DEV_BMP_read_into_buffer(const char* path, SB3_DEV_image_format_t format, void* pixels, int width, int height);
+// read and validate only the headers of a bitmap file (one read call, no pixel decoded), info may be NULL
+SB3_DEV_errors_t SB3_DEV_BMP_probe(const char* path, SB3_DEV_BMP_info_t* info);
+// read with the scanlines split in bands decoded on threads workers (<= 0: one per cpu), each band reading its own part of the file
+SB3_DEV_image_t* SB3_DEV_BMP_read_image_parallel(const char* path, SB3_DEV_image_format_t format, int threads);
+// write by mapping the output file (sized up front) and encoding the rows in place on threads workers (<= 0: one per cpu)
+SB3_DEV_errors_t SB3_DEV_BMP_write_image_mapped(const char* path, SB3_DEV_image_t* image, int threads);
+// read / write count bitmap files at once: disk io is queued asynchronously (io_uring, pread / pwrite when unavailable)
+// and overlapped with decoding / encoding on threads workers (<= 0: one per cpu)
+// images[i] is NULL when file i failed, errors (may be NULL) receives the error of each file, return the first error
+SB3_DEV_errors_t SB3_DEV_BMP_read_batch(const char** paths, int count, SB3_DEV_image_format_t format, SB3_DEV_image_t** images, SB3_DEV_errors_t* errors, int threads);
+SB3_DEV_errors_t SB3_DEV_BMP_write_batch(const char** paths, SB3_DEV_image_t** images, int count, SB3_DEV_errors_t* errors, int threads);
+// write with options (options may be NULL)
+SB3_DEV_errors_t SB3_DEV_BMP_write_image_opt(const char* path, SB3_DEV_image_t* image, const SB3_DEV_BMP_options_t* options);
+// io backends: memory buffer, file descriptor and stdio stream (none of them is closed by the library)
+SB3_DEV_io_t SB3_DEV_io_memory(SB3_DEV_memory_t* memory);
+SB3_DEV_io_t SB3_DEV_io_fd(int fd);
+SB3_DEV_io_t SB3_DEV_io_stream(FILE* stream);
+// decode / encode a bmp file from the current position of any io, or straight from / to memory (no path, no extension check)
+SB3_DEV_image_t* SB3_DEV_BMP_decode_io(const SB3_DEV_io_t* io, SB3_DEV_image_format_t format);
+SB3_DEV_errors_t SB3_DEV_BMP_encode_io(const SB3_DEV_io_t* io, SB3_DEV_image_t* image);
+SB3_DEV_image_t* SB3_DEV_BMP_decode_memory(const void* data, size_t size, SB3_DEV_image_format_t format);
+// bytes written by encode_memory (0 for a NULL image), which fails with SB3_DEV_BUFFER_TOO_SMALL_ERROR below it
+size_t SB3_DEV_BMP_encoded_size(SB3_DEV_image_t* image);
+SB3_DEV_errors_t SB3_DEV_BMP_encode_memory(SB3_DEV_image_t* image, void* data, size_t capacity, size_t* size);
 // utils (create color, image / free color, image / get color in image / change color in image by a new one)
 SB3_DEV_RGBColor_t* SB3_DEV_NewRGB(uint8_t r, uint8_t g, uint8_t b);
 SB3_DEV_monoColor_t* SB3_DEV_NewMonoColor(uint8_t color);
@@ -94,17 +229,141 @@ SB3_DEV_image_t* SB3_DEV_NewImage(int width, int height, SB3_DEV_image_format_t
 void SB3_DEV_FreeImage(SB3_DEV_image_t* image);
 void* SB3_DEV_GetPixel(SB3_DEV_image_t* image, int index);
 void* SB3_DEV_GetPixelPos(SB3_DEV_image_t* image, int x, int y);
+// SetPixel copies the value of pixel in the image and frees pixel
 void SB3_DEV_SetPixel(SB3_DEV_image_t* image, void* pixel, int index);
 void SB3_DEV_SetPixelPos(SB3_DEV_image_t* image, void* pixel, int x, int y);
-// image processing
+// indexed images: colors of the indexes of row y (w * 3 bytes r, g, b) without expanding the image,
+// or a whole rgb / mono (luminance of the palette) image
+void SB3_DEV_expand_row(SB3_DEV_image_t* image, int y, uint8_t* rgb);
+SB3_DEV_image_t* SB3_DEV_expand(SB3_DEV_image_t* image, SB3_DEV_image_format_t format);
+SB3_DEV_errors_t SB3_DEV_apply_expand(SB3_DEV_image_t* image, SB3_DEV_image_format_t format);
+// zero-copy views: the image shares the storage of image (freed with the last image using it)
+// and gets its own copy on its first change by the library (copy on write), as image does while views exist
+// views have no rgb_pixels / mono_pixels arrays (use GetPixel), detach them before writing through GetPixel pointers
+SB3_DEV_image_t* SB3_DEV_crop(SB3_DEV_image_t* image, int x, int y, int width, int height);
+SB3_DEV_image_t* SB3_DEV_row_band(SB3_DEV_image_t* image, int y, int height);
+// channel (0: r, 1: g, 2: b) of an rgb image as a new mono image (copied, mono pixels are packed)
+SB3_DEV_image_t* SB3_DEV_channel(SB3_DEV_image_t* image, int channel);
+// give image its own contiguous storage (no-op when it already owns it alone)
+void SB3_DEV_detach(SB3_DEV_image_t* image);
+// rotations, flips and transposes of any image (cache blocked tiles)
+SB3_DEV_image_t* SB3_DEV_transform(SB3_DEV_image_t* image, SB3_DEV_transform_t transform);
+SB3_DEV_errors_t SB3_DEV_apply_transform(SB3_DEV_image_t* image, SB3_DEV_transform_t transform);
+// indexed image of at most colors (2 to 256) colors: median cut palette, nearest entry for each pixel
+SB3_DEV_image_t* SB3_DEV_quantize(SB3_DEV_image_t* image, int colors);
+// image processing (rgb, mono or binary images, expand indexed images first)
+// kernels of gaussian_kernel only (not the cached ones)
 void SB3_DEV_FreeKernel(SB3_DEV_kernel_t* kernel);
+// kernels of dim >= SB3_DEV_FFT_CONVOLUTION_DIM are applied through tiled fft (one worker per cpu), smaller ones directly
+#define SB3_DEV_FFT_CONVOLUTION_DIM 7
+// w * h * pixel size values, free them with SB3_DEV_Free
 int* SB3_DEV_convolution(SB3_DEV_image_t* image, SB3_DEV_kernel_t* kernel);
 void SB3_DEV_apply_convolution(SB3_DEV_image_t* image, SB3_DEV_kernel_t* kernel);
 SB3_DEV_image_t* SB3_DEV_grayscale(SB3_DEV_image_t* image, double boost);
 SB3_DEV_errors_t SB3_DEV_image_to_grayscale(SB3_DEV_image_t* image, double boost);
 SB3_DEV_kernel_t* SB3_DEV_gaussian_kernel(unsigned int kernel_radius);
+// separable blur in fixed point (rounded, borders are replicated) on one worker per cpu, sigma is kernel_radius / 2
 SB3_DEV_image_t* SB3_DEV_gaussian_blur(SB3_DEV_image_t* image, unsigned int kernel_radius);
 void SB3_DEV_apply_gaussian_blur(SB3_DEV_image_t* image, unsigned int kernel_radius);
+// same with an explicit sigma (<= 0: kernel_radius / 2)
+SB3_DEV_image_t* SB3_DEV_gaussian_blur_sigma(SB3_DEV_image_t* image, unsigned int kernel_radius, double sigma);
+void SB3_DEV_apply_gaussian_blur_sigma(SB3_DEV_image_t* image, unsigned int kernel_radius, double sigma);
+// unsharp mask: value + amount * (value - gaussian blurred value) where they differ by more than threshold,
+// blurred like SB3_DEV_gaussian_blur in the same pass over the rows
+SB3_DEV_image_t* SB3_DEV_unsharp_mask(SB3_DEV_image_t* image, unsigned int kernel_radius, double amount, int threshold);
+void SB3_DEV_apply_unsharp_mask(SB3_DEV_image_t* image, unsigned int kernel_radius, double amount, int threshold);
+// large radii: passes (<= 0: 3, at most 8) successive box filters approximating the gaussian of sigma,
+// the cost per pixel doesn't depend on sigma (running sums, one worker per cpu)
+// against SB3_DEV_gaussian_blur_sigma(image, 3 * sigma, sigma): mean difference below 1 on smooth images,
+// a few levels around sharp edges (3 passes measured the closest)
+SB3_DEV_image_t* SB3_DEV_box_gaussian_blur(SB3_DEV_image_t* image, double sigma, int passes);
+void SB3_DEV_apply_box_gaussian_blur(SB3_DEV_image_t* image, double sigma, int passes);
+// shared gaussian kernels (thread safe): computed on the first request of a (radius, sigma <= 0: radius / 2) pair
+// and kept until SB3_DEV_ClearKernelCache (call it only when no cached kernel is in use), never change or free them
+SB3_DEV_kernel_t* SB3_DEV_cached_gaussian_kernel(unsigned int kernel_radius, double sigma);
+// separable variants: the 2d kernel is the product of these 2 * kernel_radius + 1 weights by themselves
+const double* SB3_DEV_cached_gaussian_weights(unsigned int kernel_radius, double sigma);
+// weights in fixed point, summing to exactly 1 << SB3_DEV_KERNEL_SHIFT
+#define SB3_DEV_KERNEL_SHIFT 16
+const int32_t* SB3_DEV_cached_gaussian_quantized(unsigned int kernel_radius, double sigma);
+void SB3_DEV_ClearKernelCache(void);
+// thresholding (rgb, mono or binary image to binary image: pixel > threshold => white)
+int SB3_DEV_otsu_level(SB3_DEV_image_t* image);
+SB3_DEV_image_t* SB3_DEV_threshold(SB3_DEV_image_t* image, uint8_t level);
+SB3_DEV_errors_t SB3_DEV_apply_threshold(SB3_DEV_image_t* image, uint8_t level);
+SB3_DEV_image_t* SB3_DEV_otsu_threshold(SB3_DEV_image_t* image);
+SB3_DEV_errors_t SB3_DEV_apply_otsu_threshold(SB3_DEV_image_t* image);
+// local mean of a (2*radius+1)^2 window: white if pixel > mean - offset
+SB3_DEV_image_t* SB3_DEV_mean_threshold(SB3_DEV_image_t* image, unsigned int radius, int offset);
+SB3_DEV_errors_t SB3_DEV_apply_mean_threshold(SB3_DEV_image_t* image, unsigned int radius, int offset);
+// sauvola: white if pixel > mean * (1 + k * (deviation / 128 - 1)) (k is usually between 0.2 and 0.5)
+SB3_DEV_image_t* SB3_DEV_sauvola_threshold(SB3_DEV_image_t* image, unsigned int radius, double k);
+SB3_DEV_errors_t SB3_DEV_apply_sauvola_threshold(SB3_DEV_image_t* image, unsigned int radius, double k);
+// gradient of the luminance in one pass over the rows (borders are replicated)
+// gx and gy (w * h values in storage order, can be NULL) receive the raw derivatives
+// (x to the right, y to the top: rows are stored bottom to top, so gy is row y + 1 minus row y - 1)
+// returns the magnitude (saturated at 255, scharr one divided by 4) as a mono image
+// direction (can be NULL) receives a mono image of quantized directions (0, 45, 90 or 135 degrees,
+// counterclockwise from the x axis as displayed: 45 points to the top-right, 135 to the top-left)
+SB3_DEV_image_t* SB3_DEV_gradient(SB3_DEV_image_t* image, SB3_DEV_gradient_operator_t op,
+        int16_t* gx, int16_t* gy, SB3_DEV_image_t** direction);
+SB3_DEV_image_t* SB3_DEV_sobel(SB3_DEV_image_t* image);
+// median of the (2*radius+1)^2 window for each channel (borders are replicated)
+SB3_DEV_image_t* SB3_DEV_median_filter(SB3_DEV_image_t* image, unsigned int kernel_radius);
+void SB3_DEV_apply_median_filter(SB3_DEV_image_t* image, unsigned int kernel_radius);
+// binary morphology (white is the foreground, outside pixels never change the result)
+// the element is (2*radius_x+1) * (2*radius_y+1) (a rectangle or the horizontal and vertical arms of a cross)
+SB3_DEV_image_t* SB3_DEV_erode(SB3_DEV_image_t* image, SB3_DEV_structuring_element_t element,
+        unsigned int radius_x, unsigned int radius_y);
+SB3_DEV_errors_t SB3_DEV_apply_erode(SB3_DEV_image_t* image, SB3_DEV_structuring_element_t element,
+        unsigned int radius_x, unsigned int radius_y);
+SB3_DEV_image_t* SB3_DEV_dilate(SB3_DEV_image_t* image, SB3_DEV_structuring_element_t element,
+        unsigned int radius_x, unsigned int radius_y);
+SB3_DEV_errors_t SB3_DEV_apply_dilate(SB3_DEV_image_t* image, SB3_DEV_structuring_element_t element,
+        unsigned int radius_x, unsigned int radius_y);
+SB3_DEV_image_t* SB3_DEV_open(SB3_DEV_image_t* image, SB3_DEV_structuring_element_t element,
+        unsigned int radius_x, unsigned int radius_y);
+SB3_DEV_errors_t SB3_DEV_apply_open(SB3_DEV_image_t* image, SB3_DEV_structuring_element_t element,
+        unsigned int radius_x, unsigned int radius_y);
+SB3_DEV_image_t* SB3_DEV_close(SB3_DEV_image_t* image, SB3_DEV_structuring_element_t element,
+        unsigned int radius_x, unsigned int radius_y);
+SB3_DEV_errors_t SB3_DEV_apply_close(SB3_DEV_image_t* image, SB3_DEV_structuring_element_t element,
+        unsigned int radius_x, unsigned int radius_y);
+// pipeline: stages are fused and run row by row, intermediate rows stay in small rings
+// (only the rows a stage still needs) and only the final image is allocated
+SB3_DEV_pipeline_t* SB3_DEV_NewPipeline(void);
+void SB3_DEV_FreePipeline(SB3_DEV_pipeline_t* pipeline);
+SB3_DEV_errors_t SB3_DEV_pipeline_grayscale(SB3_DEV_pipeline_t* pipeline, double boost);
+SB3_DEV_errors_t SB3_DEV_pipeline_gaussian_blur(SB3_DEV_pipeline_t* pipeline, unsigned int kernel_radius);
+// values saturated to [0, 255] (SB3_DEV_apply_convolution stores them modulo 256)
+SB3_DEV_errors_t SB3_DEV_pipeline_convolution(SB3_DEV_pipeline_t* pipeline, SB3_DEV_kernel_t* kernel);
+SB3_DEV_errors_t SB3_DEV_pipeline_threshold(SB3_DEV_pipeline_t* pipeline, uint8_t level);
+SB3_DEV_errors_t SB3_DEV_pipeline_mean_threshold(SB3_DEV_pipeline_t* pipeline, unsigned int radius, int offset);
+SB3_DEV_image_t* SB3_DEV_pipeline_run(SB3_DEV_pipeline_t* pipeline, SB3_DEV_image_t* image);
+// lazy graph: nodes only describe operations, rendering a region computes the 64x64 tiles it needs
+// computed tiles are kept in a cache of cache_size bytes (least recently used tiles are dropped)
+// source images must live as long as the graph, FreeGraph frees every node and tile
+SB3_DEV_graph_t* SB3_DEV_NewGraph(size_t cache_size);
+void SB3_DEV_FreeGraph(SB3_DEV_graph_t* graph);
+SB3_DEV_node_t* SB3_DEV_graph_source(SB3_DEV_graph_t* graph, SB3_DEV_image_t* image);
+SB3_DEV_node_t* SB3_DEV_graph_crop(SB3_DEV_node_t* input, int x, int y, int width, int height);
+SB3_DEV_node_t* SB3_DEV_graph_resize(SB3_DEV_node_t* input, int width, int height); // bilinear
+SB3_DEV_node_t* SB3_DEV_graph_convolution(SB3_DEV_node_t* input, SB3_DEV_kernel_t* kernel);
+SB3_DEV_node_t* SB3_DEV_graph_grayscale(SB3_DEV_node_t* input, double boost);
+void SB3_DEV_graph_size(SB3_DEV_node_t* node, int* width, int* height);
+SB3_DEV_image_t* SB3_DEV_graph_render(SB3_DEV_node_t* node, int x, int y, int width, int height);
+SB3_DEV_image_t* SB3_DEV_graph_to_image(SB3_DEV_node_t* node);
+// comparisons of two images (one worker per cpu)
+// same dimensions, format, palette and pixels (0 without error for different dimensions or formats)
+char SB3_DEV_equal(SB3_DEV_image_t* a, SB3_DEV_image_t* b);
+// the other ones need images of the same dimensions and format (SB3_DEV_IMAGES_MISMATCH_ERROR), NAN on error
+// |a - b| for each channel, in an image of their format
+SB3_DEV_image_t* SB3_DEV_difference(SB3_DEV_image_t* a, SB3_DEV_image_t* b);
+// mean squared difference of the channel values, psnr in dB (INFINITY for equal pixels)
+double SB3_DEV_mse(SB3_DEV_image_t* a, SB3_DEV_image_t* b);
+double SB3_DEV_psnr(SB3_DEV_image_t* a, SB3_DEV_image_t* b);
+// mean structural similarity of the luminances over the (2*radius+1)^2 windows (0: radius 3) clamped in the image
+double SB3_DEV_ssim(SB3_DEV_image_t* a, SB3_DEV_image_t* b, unsigned int radius);
 // TODO
 
 #endif // __SB3_DEV_H__
@@ -0,0 +1,245 @@
+/*
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 AyAztuB
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ *
+ * AUTHOR
+ *
+ * AyAztuB (ayaztub@gmail.com) from https://github.com/AyAztuB/SB3-Project
+ *
+ */
+
+
+
+#include "sb3_dev_internal.h"
+#include <stdatomic.h>
+#include <stdlib.h>
+
+// counters of the blocks of one scope, freed with its last reference (the owner and each live block)
+// scopes use plain malloc, not the allocator that may change meanwhile
+struct SB3_DEV_allocator_scope_s {
+    atomic_size_t live_bytes, peak_bytes, allocations;
+    atomic_size_t references;
+};
+
+// every block starts with its size, the pointer given by the allocator and its scope, right before the returned address
+typedef struct {
+    size_t size;
+    void* base;
+    SB3_DEV_allocator_scope_t* scope;
+    size_t padding;
+} __SB3_DEV_block_t;
+
+_Static_assert(sizeof(__SB3_DEV_block_t) == 32, "block headers keep the 16 bytes alignment of malloc");
+
+void* __SB3_DEV_default_malloc(size_t size, void* userdata)
+{
+    (void)userdata;
+    return malloc(size);
+}
+
+void __SB3_DEV_default_free(void* ptr, void* userdata)
+{
+    (void)userdata;
+    free(ptr);
+}
+
+static struct {
+    void* (*malloc_fn)(size_t size, void* userdata);
+    void (*free_fn)(void* ptr, void* userdata);
+    void* (*aligned_alloc_fn)(size_t alignment, size_t size, void* userdata);
+    void* userdata;
+} __SB3_DEV_allocator = {
+    .malloc_fn = __SB3_DEV_default_malloc,
+    .free_fn = __SB3_DEV_default_free,
+};
+
+static atomic_size_t __SB3_DEV_live_bytes, __SB3_DEV_peak_bytes, __SB3_DEV_allocations;
+static _Thread_local SB3_DEV_allocator_scope_t* __SB3_DEV_scope = NULL;
+
+void SB3_DEV_SetAllocator(void* (*malloc_fn)(size_t size, void* userdata), void (*free_fn)(void* ptr, void* userdata),
+        void* (*aligned_alloc_fn)(size_t alignment, size_t size, void* userdata), void* userdata)
+{
+    char custom = malloc_fn && free_fn;
+    __SB3_DEV_allocator.malloc_fn = custom ? malloc_fn : __SB3_DEV_default_malloc;
+    __SB3_DEV_allocator.free_fn = custom ? free_fn : __SB3_DEV_default_free;
+    __SB3_DEV_allocator.aligned_alloc_fn = custom ? aligned_alloc_fn : NULL;
+    __SB3_DEV_allocator.userdata = custom ? userdata : NULL;
+}
+
+void SB3_DEV_GetAllocatorStats(SB3_DEV_allocator_stats_t* stats)
+{
+    *stats = (SB3_DEV_allocator_stats_t) {
+        .live_bytes = atomic_load(&__SB3_DEV_live_bytes),
+        .peak_bytes = atomic_load(&__SB3_DEV_peak_bytes),
+        .allocations = atomic_load(&__SB3_DEV_allocations),
+    };
+}
+
+void SB3_DEV_ResetAllocatorStats(void)
+{
+    atomic_store(&__SB3_DEV_peak_bytes, atomic_load(&__SB3_DEV_live_bytes));
+    atomic_store(&__SB3_DEV_allocations, 0);
+}
+
+SB3_DEV_allocator_scope_t* SB3_DEV_NewAllocatorScope(void)
+{
+    SB3_DEV_allocator_scope_t* scope = malloc(sizeof(*scope));
+    atomic_init(&scope->live_bytes, 0);
+    atomic_init(&scope->peak_bytes, 0);
+    atomic_init(&scope->allocations, 0);
+    atomic_init(&scope->references, 1);
+    return scope;
+}
+
+void SB3_DEV_FreeAllocatorScope(SB3_DEV_allocator_scope_t* scope)
+{
+    if(scope && atomic_fetch_sub(&scope->references, 1) == 1)
+        free(scope);
+}
+
+SB3_DEV_allocator_scope_t* __SB3_DEV_allocator_scope(void)
+{
+    return __SB3_DEV_scope;
+}
+
+SB3_DEV_allocator_scope_t* SB3_DEV_SetAllocatorScope(SB3_DEV_allocator_scope_t* scope)
+{
+    SB3_DEV_allocator_scope_t* previous = __SB3_DEV_scope;
+    __SB3_DEV_scope = scope;
+    return previous;
+}
+
+void SB3_DEV_GetAllocatorScopeStats(SB3_DEV_allocator_scope_t* scope, SB3_DEV_allocator_stats_t* stats)
+{
+    *stats = (SB3_DEV_allocator_stats_t) {
+        .live_bytes = atomic_load(&scope->live_bytes),
+        .peak_bytes = atomic_load(&scope->peak_bytes),
+        .allocations = atomic_load(&scope->allocations),
+    };
+}
+
+static void __SB3_DEV_count(atomic_size_t* live_bytes, atomic_size_t* peak_bytes, atomic_size_t* allocations, size_t size)
+{
+    size_t live = atomic_fetch_add(live_bytes, size) + size;
+    size_t peak = atomic_load(peak_bytes);
+    while(live > peak && !atomic_compare_exchange_weak(peak_bytes, &peak, live));
+    atomic_fetch_add(allocations, 1);
+}
+
+// header written, accounting updated (global counters and scope of the calling thread)
+void* __SB3_DEV_block(void* base, size_t offset, size_t size)
+{
+    if(!base)
+        return NULL;
+    uint8_t* ptr = (uint8_t*)base + offset;
+    SB3_DEV_allocator_scope_t* scope = __SB3_DEV_scope;
+    ((__SB3_DEV_block_t*)ptr)[-1] = (__SB3_DEV_block_t) { .size = size, .base = base, .scope = scope };
+    __SB3_DEV_count(&__SB3_DEV_live_bytes, &__SB3_DEV_peak_bytes, &__SB3_DEV_allocations, size);
+    if(scope)
+    {
+        atomic_fetch_add(&scope->references, 1);
+        __SB3_DEV_count(&scope->live_bytes, &scope->peak_bytes, &scope->allocations, size);
+    }
+    return ptr;
+}
+
+void* __SB3_DEV_malloc(size_t size)
+{
+    if(size > SIZE_MAX - sizeof(__SB3_DEV_block_t))
+        return NULL;
+    return __SB3_DEV_block(__SB3_DEV_allocator.malloc_fn(size + sizeof(__SB3_DEV_block_t), __SB3_DEV_allocator.userdata),
+        sizeof(__SB3_DEV_block_t), size);
+}
+
+void* __SB3_DEV_calloc(size_t count, size_t size)
+{
+    if(count && size > (SIZE_MAX - sizeof(__SB3_DEV_block_t)) / count)
+        return NULL;
+    size *= count;
+    // calloc keeps the lazily zeroed pages of the system
+    if(__SB3_DEV_allocator.malloc_fn == __SB3_DEV_default_malloc)
+        return __SB3_DEV_block(calloc(1, size + sizeof(__SB3_DEV_block_t)), sizeof(__SB3_DEV_block_t), size);
+    void* ptr = __SB3_DEV_malloc(size);
+    if(ptr)
+        memset(ptr, 0, size);
+    return ptr;
+}
+
+// ptr is kept when the new block can't be allocated
+void* __SB3_DEV_realloc(void* ptr, size_t size)
+{
+    void* res = __SB3_DEV_malloc(size);
+    if(!res)
+        return NULL;
+    if(ptr)
+    {
+        size_t old = ((__SB3_DEV_block_t*)ptr)[-1].size;
+        memcpy(res, ptr, old < size ? old : size);
+    }
+    __SB3_DEV_free(ptr);
+    return res;
+}
+
+void* __SB3_DEV_pixels_alloc(size_t size, char zero)
+{
+    const size_t alignment = __SB3_DEV_PIXELS_ALIGNMENT;
+    if(size > SIZE_MAX - alignment - sizeof(__SB3_DEV_block_t))
+        return NULL;
+    if(__SB3_DEV_allocator.aligned_alloc_fn)
+    {
+        // the header lives in the first alignment bytes
+        void* ptr = __SB3_DEV_block(__SB3_DEV_allocator.aligned_alloc_fn(alignment, size + alignment, __SB3_DEV_allocator.userdata),
+            alignment, size);
+        if(ptr && zero)
+            memset(ptr, 0, size);
+        return ptr;
+    }
+    // over-allocation aligned by hand
+    size_t total = size + alignment + sizeof(__SB3_DEV_block_t);
+    uint8_t* base = __SB3_DEV_allocator.malloc_fn == __SB3_DEV_default_malloc && zero
+        ? calloc(1, total) : __SB3_DEV_allocator.malloc_fn(total, __SB3_DEV_allocator.userdata);
+    if(!base)
+        return NULL;
+    size_t offset = alignment - ((uintptr_t)(base + sizeof(__SB3_DEV_block_t)) & (alignment - 1)) + sizeof(__SB3_DEV_block_t);
+    if(offset - sizeof(__SB3_DEV_block_t) == alignment)
+        offset = sizeof(__SB3_DEV_block_t);
+    void* ptr = __SB3_DEV_block(base, offset, size);
+    if(zero && __SB3_DEV_allocator.malloc_fn != __SB3_DEV_default_malloc)
+        memset(ptr, 0, size);
+    return ptr;
+}
+
+void __SB3_DEV_free(void* ptr)
+{
+    if(!ptr)
+        return;
+    __SB3_DEV_block_t block = ((__SB3_DEV_block_t*)ptr)[-1];
+    atomic_fetch_sub(&__SB3_DEV_live_bytes, block.size);
+    if(block.scope)
+    {
+        atomic_fetch_sub(&block.scope->live_bytes, block.size);
+        SB3_DEV_FreeAllocatorScope(block.scope);
+    }
+    __SB3_DEV_allocator.free_fn(block.base, __SB3_DEV_allocator.userdata);
+}
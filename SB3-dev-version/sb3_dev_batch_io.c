@@ -0,0 +1,698 @@
+/*
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 AyAztuB
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ *
+ * AUTHOR
+ *
+ * AyAztuB (ayaztub@gmail.com) from https://github.com/AyAztuB/SB3-Project
+ *
+ */
+
+
+
+#include "sb3_dev_internal.h"
+#include <err.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#define __SB3_DEV_IO_DEPTH 32         // requests in flight on the disk
+#define __SB3_DEV_IO_CHUNK (1 << 22)  // large files are transfered by 4MB requests
+#define __SB3_DEV_IO_WINDOW 64        // files held in memory between the io loop and the workers
+
+// io_uring through the raw syscalls (no liburing dependency)
+typedef struct {
+    int fd;
+    unsigned *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_sqe* sqes;
+    struct io_uring_cqe* cqes;
+    void *sq_ring, *cq_ring;
+    size_t sq_ring_size, cq_ring_size, sqes_size;
+} __SB3_DEV_uring_t;
+
+void __SB3_DEV_uring_exit(__SB3_DEV_uring_t* ring)
+{
+    if(ring->sqes != MAP_FAILED)
+        munmap(ring->sqes, ring->sqes_size);
+    if(ring->cq_ring != MAP_FAILED && ring->cq_ring != ring->sq_ring)
+        munmap(ring->cq_ring, ring->cq_ring_size);
+    if(ring->sq_ring != MAP_FAILED)
+        munmap(ring->sq_ring, ring->sq_ring_size);
+    close(ring->fd);
+}
+
+// 0 when the kernel has no io_uring (or forbids it)
+char __SB3_DEV_uring_init(__SB3_DEV_uring_t* ring, unsigned entries)
+{
+#ifdef __NR_io_uring_setup
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    ring->fd = syscall(__NR_io_uring_setup, entries, &params);
+    if(ring->fd < 0)
+        return 0;
+    ring->sq_ring = ring->cq_ring = ring->sqes = MAP_FAILED;
+    ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    char single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if(single && ring->cq_ring_size > ring->sq_ring_size)
+        ring->sq_ring_size = ring->cq_ring_size;
+    ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    if(ring->sq_ring != MAP_FAILED)
+        ring->cq_ring = single ? ring->sq_ring : mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+    if(ring->cq_ring != MAP_FAILED)
+        ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    if(ring->sqes == MAP_FAILED)
+    {
+        __SB3_DEV_uring_exit(ring);
+        return 0;
+    }
+    uint8_t* sq = ring->sq_ring;
+    uint8_t* cq = ring->cq_ring;
+    ring->sq_tail = (unsigned*)(sq + params.sq_off.tail);
+    ring->sq_mask = (unsigned*)(sq + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned*)(sq + params.sq_off.array);
+    ring->cq_head = (unsigned*)(cq + params.cq_off.head);
+    ring->cq_tail = (unsigned*)(cq + params.cq_off.tail);
+    ring->cq_mask = (unsigned*)(cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+    return 1;
+#else
+    (void)ring;
+    (void)entries;
+    return 0;
+#endif
+}
+
+typedef struct {
+    int fd;
+    uint8_t* data;
+    size_t size, submitted, completed;
+    int inflight;
+    char failed;
+} __SB3_DEV_io_file_t;
+
+typedef struct {
+    int file;
+    struct iovec iov;
+    off_t offset;
+} __SB3_DEV_io_slot_t;
+
+// transfers of whole files split in chunks, done(context, i) is called (by the io thread) once file i is complete or failed
+typedef struct {
+    __SB3_DEV_uring_t ring;
+    char uring, write;
+    __SB3_DEV_io_file_t* files;
+    __SB3_DEV_io_slot_t slots[__SB3_DEV_IO_DEPTH];
+    int free_slots[__SB3_DEV_IO_DEPTH], free_count;
+    int* pending; // files waiting for submission
+    int pending_head, pending_tail;
+    unsigned to_submit;
+    int inflight;
+    void (*done)(void* context, int i);
+    void* context;
+} __SB3_DEV_io_t;
+
+void __SB3_DEV_io_init(__SB3_DEV_io_t* io, int count, char write, void (*done)(void* context, int i), void* context)
+{
+    io->uring = __SB3_DEV_uring_init(&io->ring, __SB3_DEV_IO_DEPTH);
+    io->write = write;
+    io->files = __SB3_DEV_calloc(count, sizeof(__SB3_DEV_io_file_t));
+    io->pending = __SB3_DEV_malloc(count * sizeof(int));
+    io->pending_head = io->pending_tail = 0;
+    for(int s = 0; s < __SB3_DEV_IO_DEPTH; s++)
+        io->free_slots[s] = s;
+    io->free_count = __SB3_DEV_IO_DEPTH;
+    io->to_submit = 0;
+    io->inflight = 0;
+    io->done = done;
+    io->context = context;
+}
+
+void __SB3_DEV_io_exit(__SB3_DEV_io_t* io)
+{
+    if(io->uring)
+        __SB3_DEV_uring_exit(&io->ring);
+    __SB3_DEV_free(io->files);
+    __SB3_DEV_free(io->pending);
+}
+
+void __SB3_DEV_io_queue(__SB3_DEV_io_t* io, int i, int fd, uint8_t* data, size_t size)
+{
+    io->files[i] = (__SB3_DEV_io_file_t) {
+        .fd = fd,
+        .data = data,
+        .size = size,
+    };
+    io->pending[io->pending_tail++] = i;
+}
+
+void __SB3_DEV_io_finish(__SB3_DEV_io_t* io, int i)
+{
+    close(io->files[i].fd);
+    io->done(io->context, i);
+}
+
+void __SB3_DEV_io_prepare(__SB3_DEV_io_t* io, int s)
+{
+    __SB3_DEV_uring_t* ring = &io->ring;
+    __SB3_DEV_io_slot_t* slot = &io->slots[s];
+    unsigned tail = *ring->sq_tail;
+    unsigned index = tail & *ring->sq_mask;
+    struct io_uring_sqe* sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    // vectored opcodes: available on every io_uring kernel
+    sqe->opcode = io->write ? IORING_OP_WRITEV : IORING_OP_READV;
+    sqe->fd = io->files[slot->file].fd;
+    sqe->addr = (uint64_t)(uintptr_t)&slot->iov;
+    sqe->len = 1;
+    sqe->off = slot->offset;
+    sqe->user_data = s;
+    ring->sq_array[index] = index;
+    __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    io->to_submit++;
+}
+
+void __SB3_DEV_io_enter(__SB3_DEV_io_t* io, unsigned wait)
+{
+    int submitted;
+    do
+        submitted = syscall(__NR_io_uring_enter, io->ring.fd, io->to_submit, wait, wait ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+    while(submitted < 0 && errno == EINTR);
+    if(submitted > 0)
+        io->to_submit -= submitted;
+}
+
+// synchronous transfer of a whole file (kernels without io_uring)
+void __SB3_DEV_io_blocking(__SB3_DEV_io_t* io, int i)
+{
+    __SB3_DEV_io_file_t* file = &io->files[i];
+    while(file->completed < file->size)
+    {
+        ssize_t done = io->write
+            ? pwrite(file->fd, file->data + file->completed, file->size - file->completed, file->completed)
+            : pread(file->fd, file->data + file->completed, file->size - file->completed, file->completed);
+        if(done < 0 && errno == EINTR)
+            continue;
+        if(done <= 0)
+        {
+            file->failed = 1;
+            break;
+        }
+        file->completed += done;
+    }
+    __SB3_DEV_io_finish(io, i);
+}
+
+// fill the free slots with chunks of the pending files
+void __SB3_DEV_io_submit(__SB3_DEV_io_t* io)
+{
+    while(io->pending_head < io->pending_tail && (!io->uring || io->free_count))
+    {
+        int i = io->pending[io->pending_head];
+        __SB3_DEV_io_file_t* file = &io->files[i];
+        if(!io->uring || !file->size)
+        {
+            io->pending_head++;
+            __SB3_DEV_io_blocking(io, i);
+            continue;
+        }
+        int s = io->free_slots[--io->free_count];
+        size_t length = file->size - file->submitted;
+        if(length > __SB3_DEV_IO_CHUNK)
+            length = __SB3_DEV_IO_CHUNK;
+        io->slots[s] = (__SB3_DEV_io_slot_t) {
+            .file = i,
+            .iov = { .iov_base = file->data + file->submitted, .iov_len = length },
+            .offset = file->submitted,
+        };
+        file->submitted += length;
+        file->inflight++;
+        io->inflight++;
+        __SB3_DEV_io_prepare(io, s);
+        if(file->submitted == file->size)
+            io->pending_head++;
+    }
+    if(io->to_submit)
+        __SB3_DEV_io_enter(io, 0);
+}
+
+// wait for at least one completion and handle all the available ones
+void __SB3_DEV_io_reap(__SB3_DEV_io_t* io)
+{
+    __SB3_DEV_uring_t* ring = &io->ring;
+    __SB3_DEV_io_enter(io, 1);
+    unsigned head = *ring->cq_head;
+    while(head != __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE))
+    {
+        struct io_uring_cqe* cqe = &ring->cqes[head & *ring->cq_mask];
+        int s = cqe->user_data;
+        int result = cqe->res;
+        head++;
+        __SB3_DEV_io_slot_t* slot = &io->slots[s];
+        __SB3_DEV_io_file_t* file = &io->files[slot->file];
+        if(result == -EAGAIN || result == -EINTR || (result > 0 && (size_t)result < slot->iov.iov_len))
+        {
+            // short or interrupted transfer: send the rest again
+            if(result > 0)
+            {
+                slot->iov.iov_base = (uint8_t*)slot->iov.iov_base + result;
+                slot->iov.iov_len -= result;
+                slot->offset += result;
+                file->completed += result;
+            }
+            __SB3_DEV_io_prepare(io, s);
+            continue;
+        }
+        io->free_slots[io->free_count++] = s;
+        io->inflight--;
+        file->inflight--;
+        if(result <= 0)
+        {
+            file->failed = 1;
+            // don't submit the rest of the file
+            file->submitted = file->size;
+            if(io->pending_head < io->pending_tail && io->pending[io->pending_head] == slot->file)
+                io->pending_head++;
+        }
+        else
+            file->completed += result;
+        if(!file->inflight && (file->failed || file->completed == file->size))
+            __SB3_DEV_io_finish(io, slot->file);
+    }
+    __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+}
+
+// state shared by the io loop (calling thread) and the workers
+typedef struct {
+    __SB3_DEV_io_t io;
+    int count;
+    const char** paths;
+    SB3_DEV_image_format_t format;
+    SB3_DEV_image_t** images;
+    SB3_DEV_errors_t* status;
+    // files handed from the io loop to the workers (read) or from the workers to the io loop (write)
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int* queue;
+    int head, tail;
+    char closed;
+    sem_t window;
+    atomic_int next;
+    int finished;
+    SB3_DEV_allocator_scope_t* scope; // of the calling thread, set on the workers
+} __SB3_DEV_batch_t;
+
+void __SB3_DEV_batch_push(__SB3_DEV_batch_t* batch, int i)
+{
+    pthread_mutex_lock(&batch->lock);
+    batch->queue[batch->tail++] = i;
+    pthread_cond_signal(&batch->cond);
+    pthread_mutex_unlock(&batch->lock);
+}
+
+// -1 when the queue is empty (and closed if block)
+int __SB3_DEV_batch_pop(__SB3_DEV_batch_t* batch, char block)
+{
+    pthread_mutex_lock(&batch->lock);
+    while(block && batch->head == batch->tail && !batch->closed)
+        pthread_cond_wait(&batch->cond, &batch->lock);
+    int i = batch->head < batch->tail ? batch->queue[batch->head++] : -1;
+    pthread_mutex_unlock(&batch->lock);
+    return i;
+}
+
+void __SB3_DEV_batch_window(__SB3_DEV_batch_t* batch)
+{
+    while(sem_wait(&batch->window) && errno == EINTR)
+        ;
+}
+
+void __SB3_DEV_batch_init(__SB3_DEV_batch_t* batch, int count, char write, void (*done)(void* context, int i))
+{
+    batch->count = count;
+    __SB3_DEV_io_init(&batch->io, count, write, done, batch);
+    batch->status = __SB3_DEV_malloc(count * sizeof(SB3_DEV_errors_t));
+    pthread_mutex_init(&batch->lock, NULL);
+    pthread_cond_init(&batch->cond, NULL);
+    batch->queue = __SB3_DEV_malloc(count * sizeof(int));
+    batch->head = batch->tail = 0;
+    batch->closed = 0;
+    sem_init(&batch->window, 0, __SB3_DEV_IO_WINDOW);
+    atomic_init(&batch->next, 0);
+    batch->finished = 0;
+    batch->scope = __SB3_DEV_allocator_scope();
+}
+
+SB3_DEV_errors_t __SB3_DEV_batch_exit(__SB3_DEV_batch_t* batch, SB3_DEV_errors_t* errors)
+{
+    SB3_DEV_errors_t first = SB3_DEV_SUCCESS_EXIT;
+    for(int i = 0; i < batch->count; i++)
+    {
+        if(errors)
+            errors[i] = batch->status[i];
+        if(first == SB3_DEV_SUCCESS_EXIT)
+            first = batch->status[i];
+    }
+    __SB3_DEV_io_exit(&batch->io);
+    __SB3_DEV_free(batch->status);
+    __SB3_DEV_free(batch->queue);
+    pthread_mutex_destroy(&batch->lock);
+    pthread_cond_destroy(&batch->cond);
+    sem_destroy(&batch->window);
+    SB3_DEV_SetError(first);
+    return first;
+}
+
+// read done: hand the file to the decoders
+void __SB3_DEV_read_done(void* context, int i)
+{
+    __SB3_DEV_batch_push(context, i);
+}
+
+void* __SB3_DEV_read_worker(void* context)
+{
+    __SB3_DEV_batch_t* batch = context;
+    SB3_DEV_SetAllocatorScope(batch->scope);
+    int i;
+    while((i = __SB3_DEV_batch_pop(batch, 1)) >= 0)
+    {
+        __SB3_DEV_io_file_t* file = &batch->io.files[i];
+        batch->images[i] = NULL;
+        if(file->failed)
+        {
+            #ifdef SB3_DEV_CRASH_WHEN_ERROR
+                errx(EXIT_FAILURE, "READ_BATCH: Cannot read file at '%s'", batch->paths[i]);
+            #else
+                batch->status[i] = SB3_DEV_IO_ERROR;
+            #endif
+        }
+        else
+        {
+            __SB3_DEV_reader_t reader = { .data = file->data, .size = file->size };
+            batch->images[i] = __SB3_DEV_BMP_decode(&reader, batch->format);
+            batch->status[i] = batch->images[i] ? SB3_DEV_SUCCESS_EXIT : __SB3_DEV_LastError();
+        }
+        __SB3_DEV_free(file->data);
+        file->data = NULL;
+        sem_post(&batch->window);
+    }
+    return NULL;
+}
+
+// open file i and queue its read (or fail it)
+void __SB3_DEV_read_open(__SB3_DEV_batch_t* batch, int i)
+{
+    const char* path = batch->paths[i];
+    SB3_DEV_errors_t error = SB3_DEV_SUCCESS_EXIT;
+    int fd = -1;
+    struct stat st;
+    if(!path)
+    {
+        #ifdef SB3_DEV_CRASH_WHEN_ERROR
+            errx(EXIT_FAILURE, "READ_BATCH: NULL path error");
+        #else
+            error = SB3_DEV_NULL_PATH_ERROR;
+        #endif
+    }
+    else if(!__SB3_DEV_BMP_extension(path))
+    {
+        #ifdef SB3_DEV_CRASH_WHEN_ERROR
+            errx(EXIT_FAILURE, "READ_BATCH: Bad file extension (%s) (expected '.BMP' extension (with lower or upper cases))", path);
+        #else
+            error = SB3_DEV_BAD_EXTENSION_ERROR;
+        #endif
+    }
+    else if((fd = open(path, O_RDONLY | O_CLOEXEC)) < 0 || fstat(fd, &st))
+    {
+        if(fd >= 0)
+            close(fd);
+        #ifdef SB3_DEV_CRASH_WHEN_ERROR
+            errx(EXIT_FAILURE, "READ_BATCH: Cannot open file at '%s'", path);
+        #else
+            error = SB3_DEV_CANNOT_OPEN_FILE_ERROR;
+        #endif
+    }
+    if(error != SB3_DEV_SUCCESS_EXIT)
+    {
+        batch->images[i] = NULL;
+        batch->status[i] = error;
+        batch->finished++;
+        sem_post(&batch->window);
+        return;
+    }
+    __SB3_DEV_io_queue(&batch->io, i, fd, __SB3_DEV_malloc(st.st_size ? st.st_size : 1), st.st_size);
+}
+
+SB3_DEV_errors_t SB3_DEV_BMP_read_batch(const char** paths, int count, SB3_DEV_image_format_t format, SB3_DEV_image_t** images, SB3_DEV_errors_t* errors, int threads)
+{
+    if(!paths || !images)
+    {
+        #ifdef SB3_DEV_CRASH_WHEN_ERROR
+            errx(EXIT_FAILURE, "READ_BATCH: NULL path error");
+        #else
+            SB3_DEV_SetError(SB3_DEV_NULL_PATH_ERROR);
+            return SB3_DEV_NULL_PATH_ERROR;
+        #endif
+    }
+    if(count <= 0)
+    {
+        SB3_DEV_SetError(SB3_DEV_SUCCESS_EXIT);
+        return SB3_DEV_SUCCESS_EXIT;
+    }
+    __SB3_DEV_batch_t batch = {
+        .paths = paths,
+        .format = format,
+        .images = images,
+    };
+    __SB3_DEV_batch_init(&batch, count, 0, __SB3_DEV_read_done);
+
+    // continue with the workers that did start, without any the files are read one after the other
+    int workers = __SB3_DEV_thread_count(threads), started = 0;
+    pthread_t tids[workers];
+    for(; started < workers; started++)
+        if(pthread_create(&tids[started], NULL, __SB3_DEV_read_worker, &batch))
+            break;
+    if(!started)
+    {
+        for(int i = 0; i < count; i++)
+        {
+            images[i] = SB3_DEV_BMP_read_image(paths[i], format);
+            batch.status[i] = images[i] ? SB3_DEV_SUCCESS_EXIT : __SB3_DEV_LastError();
+        }
+        return __SB3_DEV_batch_exit(&batch, errors);
+    }
+
+    // io loop: keep the disk queue full while the workers decode the completed files
+    __SB3_DEV_io_t* io = &batch.io;
+    int opened = 0;
+    while(opened < count || io->inflight || io->pending_head < io->pending_tail)
+    {
+        while(opened < count && !sem_trywait(&batch.window))
+            __SB3_DEV_read_open(&batch, opened++);
+        __SB3_DEV_io_submit(io);
+        if(io->inflight)
+            __SB3_DEV_io_reap(io);
+        else if(opened < count && io->pending_head == io->pending_tail)
+        {
+            // every buffered file is waiting for a decoder
+            __SB3_DEV_batch_window(&batch);
+            __SB3_DEV_read_open(&batch, opened++);
+        }
+    }
+
+    pthread_mutex_lock(&batch.lock);
+    batch.closed = 1;
+    pthread_cond_broadcast(&batch.cond);
+    pthread_mutex_unlock(&batch.lock);
+    for(int t = 0; t < started; t++)
+        pthread_join(tids[t], NULL);
+    return __SB3_DEV_batch_exit(&batch, errors);
+}
+
+// write done: release the encoded file
+void __SB3_DEV_write_done(void* context, int i)
+{
+    __SB3_DEV_batch_t* batch = context;
+    __SB3_DEV_io_file_t* file = &batch->io.files[i];
+    if(file->failed)
+    {
+        #ifdef SB3_DEV_CRASH_WHEN_ERROR
+            errx(EXIT_FAILURE, "WRITE_BATCH: Cannot write file at '%s'", batch->paths[i]);
+        #else
+            batch->status[i] = SB3_DEV_IO_ERROR;
+        #endif
+    }
+    __SB3_DEV_free(file->data);
+    file->data = NULL;
+    batch->finished++;
+    sem_post(&batch->window);
+}
+
+void* __SB3_DEV_write_worker(void* context)
+{
+    __SB3_DEV_batch_t* batch = context;
+    SB3_DEV_SetAllocatorScope(batch->scope);
+    int i;
+    while((i = atomic_fetch_add(&batch->next, 1)) < batch->count)
+    {
+        __SB3_DEV_batch_window(batch);
+        __SB3_DEV_io_file_t* file = &batch->io.files[i];
+        SB3_DEV_image_t* image = batch->images[i];
+        const char* path = batch->paths[i];
+        SB3_DEV_errors_t error = SB3_DEV_SUCCESS_EXIT;
+        __SB3_DEV_writer_t writer = { 0 };
+        if(!image)
+        {
+            #ifdef SB3_DEV_CRASH_WHEN_ERROR
+                errx(EXIT_FAILURE, "WRITE_BATCH: NULL image cannot be saved");
+            #else
+                error = SB3_DEV_NULL_IMAGE_ERROR;
+            #endif
+        }
+        else if(!path)
+        {
+            #ifdef SB3_DEV_CRASH_WHEN_ERROR
+                errx(EXIT_FAILURE, "WRITE_BATCH: NULL path error");
+            #else
+                error = SB3_DEV_NULL_PATH_ERROR;
+            #endif
+        }
+        else if(!__SB3_DEV_BMP_extension(path))
+        {
+            #ifdef SB3_DEV_CRASH_WHEN_ERROR
+                errx(EXIT_FAILURE, "WRITE_BATCH: Bad file extension (%s) (expected '.BMP' extension (with lower or upper cases))", path);
+            #else
+                error = SB3_DEV_BAD_EXTENSION_ERROR;
+            #endif
+        }
+        else
+            error = __SB3_DEV_BMP_encode(&writer, image, 0);
+        file->data = writer.data;
+        file->size = writer.size;
+        batch->status[i] = error;
+        __SB3_DEV_batch_push(batch, i);
+    }
+    return NULL;
+}
+
+// open the output of an encoded file and queue its write (or fail it)
+void __SB3_DEV_write_open(__SB3_DEV_batch_t* batch, int i)
+{
+    __SB3_DEV_io_file_t* file = &batch->io.files[i];
+    int fd = -1;
+    if(batch->status[i] == SB3_DEV_SUCCESS_EXIT && (fd = open(batch->paths[i], O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666)) < 0)
+    {
+        #ifdef SB3_DEV_CRASH_WHEN_ERROR
+            errx(EXIT_FAILURE, "WRITE_BATCH: Cannot open file at '%s'", batch->paths[i]);
+        #else
+            batch->status[i] = SB3_DEV_CANNOT_OPEN_FILE_ERROR;
+        #endif
+    }
+    if(batch->status[i] != SB3_DEV_SUCCESS_EXIT)
+    {
+        __SB3_DEV_free(file->data);
+        file->data = NULL;
+        batch->finished++;
+        sem_post(&batch->window);
+        return;
+    }
+    __SB3_DEV_io_queue(&batch->io, i, fd, file->data, file->size);
+}
+
+SB3_DEV_errors_t SB3_DEV_BMP_write_batch(const char** paths, SB3_DEV_image_t** images, int count, SB3_DEV_errors_t* errors, int threads)
+{
+    if(!paths)
+    {
+        #ifdef SB3_DEV_CRASH_WHEN_ERROR
+            errx(EXIT_FAILURE, "WRITE_BATCH: NULL path error");
+        #else
+            SB3_DEV_SetError(SB3_DEV_NULL_PATH_ERROR);
+            return SB3_DEV_NULL_PATH_ERROR;
+        #endif
+    }
+    if(!images)
+    {
+        #ifdef SB3_DEV_CRASH_WHEN_ERROR
+            errx(EXIT_FAILURE, "WRITE_BATCH: NULL image cannot be saved");
+        #else
+            SB3_DEV_SetError(SB3_DEV_NULL_IMAGE_ERROR);
+            return SB3_DEV_NULL_IMAGE_ERROR;
+        #endif
+    }
+    if(count <= 0)
+    {
+        SB3_DEV_SetError(SB3_DEV_SUCCESS_EXIT);
+        return SB3_DEV_SUCCESS_EXIT;
+    }
+    __SB3_DEV_batch_t batch = {
+        .paths = paths,
+        .images = images,
+    };
+    __SB3_DEV_batch_init(&batch, count, 1, __SB3_DEV_write_done);
+
+    // continue with the workers that did start, without any the files are written one after the other
+    int workers = __SB3_DEV_thread_count(threads), started = 0;
+    pthread_t tids[workers];
+    for(; started < workers; started++)
+        if(pthread_create(&tids[started], NULL, __SB3_DEV_write_worker, &batch))
+            break;
+    if(!started)
+    {
+        for(int i = 0; i < count; i++)
+            batch.status[i] = SB3_DEV_BMP_write_image(paths[i], images[i]);
+        return __SB3_DEV_batch_exit(&batch, errors);
+    }
+
+    // io loop: write the files as soon as they are encoded
+    __SB3_DEV_io_t* io = &batch.io;
+    while(batch.finished < count)
+    {
+        // nothing to wait for on the disk: wait for an encoder
+        char block = !io->inflight && io->pending_head == io->pending_tail;
+        int i;
+        while((i = __SB3_DEV_batch_pop(&batch, block)) >= 0)
+        {
+            block = 0;
+            __SB3_DEV_write_open(&batch, i);
+        }
+        __SB3_DEV_io_submit(io);
+        if(io->inflight)
+            __SB3_DEV_io_reap(io);
+    }
+
+    for(int t = 0; t < started; t++)
+        pthread_join(tids[t], NULL);
+    return __SB3_DEV_batch_exit(&batch, errors);
+}
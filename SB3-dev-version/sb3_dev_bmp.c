@@ -30,15 +30,45 @@
  */
 
 
-#include "sb3_dev.h"
+#include "sb3_dev_internal.h"
+#include "../SB3-common/sb3_bmp_rows.h"
 #include <err.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
 
 
-void SB3_DEV_SetError(SB3_DEV_errors_t error);
+char __SB3_DEV_BMP_extension(const char* path)
+{
+    int len = strlen(path);
+    return !(len <= 4 || path[len-4] != '.' || (path[len-3] != 'B' && path[len-3] != 'b') ||
+            (path[len-2] != 'M' && path[len-2] != 'm') || (path[len-1] != 'P' && path[len-1] != 'p'));
+}
+
+void __SB3_DEV_reserve(__SB3_DEV_writer_t* writer, size_t capacity)
+{
+    if(writer->file || writer->io || capacity <= writer->capacity)
+        return;
+    uint8_t* data = __SB3_DEV_realloc(writer->data, capacity);
+    if(!data)
+    {
+        #ifdef SB3_DEV_CRASH_WHEN_ERROR
+            errx(EXIT_FAILURE, "WRITE_IMAGE: Out of memory");
+        #else
+            writer->failed = 1;
+            return;
+        #endif
+    }
+    writer->data = data;
+    writer->capacity = capacity;
+}
 
-SB3_DEV_errors_t SB3_DEV_BMP_write_image(const char* path, SB3_DEV_image_t* image) {
+SB3_DEV_errors_t __SB3_DEV_BMP_write_image(const char* path, SB3_DEV_image_t* image, char top_down)
+{
     if(!image)
     {
         #ifdef SB3_DEV_CRASH_WHEN_ERROR
@@ -57,9 +87,7 @@ SB3_DEV_errors_t SB3_DEV_BMP_write_image(const char* path, SB3_DEV_image_t* imag
             return SB3_DEV_NULL_PATH_ERROR;
         #endif
     }
-    int len = strlen(path);
-    if (len <= 4 || path[len-4] != '.' || (path[len-3] != 'B' && path[len-3] != 'b') ||
-            (path[len-2] != 'M' && path[len-2] != 'm') || (path[len-1] != 'P' && path[len-1] != 'p'))
+    if(!__SB3_DEV_BMP_extension(path))
     {
         #ifdef SB3_DEV_CRASH_WHEN_ERROR
             errx(EXIT_FAILURE, "WRITE_IMAGE: Bad file extension (%s) (expected '.BMP' extension (with lower or upper cases))", path);
@@ -79,23 +107,180 @@ SB3_DEV_errors_t SB3_DEV_BMP_write_image(const char* path, SB3_DEV_image_t* imag
             return SB3_DEV_CANNOT_OPEN_FILE_ERROR;
         #endif
     }
-    
-    int padding = ((4 - (image->w * 3) % 4) % 4);
-    if(image->format == SB3_DEV_MONO_COLOR_FORMAT)
-        padding = image->w % 4;
-    else if(image->format == SB3_DEV_BINARY_COLOR_FORMAT)
-        padding = ((image->w % 8) + (image->w / 8)%4) % 4;
+    __SB3_DEV_writer_t writer = { .file = file };
+    SB3_DEV_errors_t error = __SB3_DEV_BMP_encode(&writer, image, top_down);
+    fclose(file);
+    return error;
+}
+
+SB3_DEV_errors_t SB3_DEV_BMP_write_image(const char* path, SB3_DEV_image_t* image)
+{
+    return __SB3_DEV_BMP_write_image(path, image, 0);
+}
+
+SB3_DEV_errors_t SB3_DEV_BMP_write_image_opt(const char* path, SB3_DEV_image_t* image, const SB3_DEV_BMP_options_t* options)
+{
+    SB3_DEV_BMP_options_t defaults = { 0 };
+    if(!options)
+        options = &defaults;
+    if(!options->quantize || !image)
+        return __SB3_DEV_BMP_write_image(path, image, options->top_down);
+    SB3_DEV_image_t* indexed = SB3_DEV_quantize(image, options->quantize);
+    if(!indexed)
+        return __SB3_DEV_LastError();
+    SB3_DEV_errors_t error = __SB3_DEV_BMP_write_image(path, indexed, options->top_down);
+    SB3_DEV_FreeImage(indexed);
+    return error;
+}
+
+typedef struct {
+    SB3_DEV_image_t* image;
+    const __SB3_DEV_BMP_layout_t* layout;
+    uint8_t* pixel_array;
+    int band;
+    atomic_int error;
+} __SB3_DEV_mapped_t;
+
+void __SB3_DEV_mapped_band(void* context, int i)
+{
+    __SB3_DEV_mapped_t* mapped = context;
+    int end = (i + 1) * mapped->band < mapped->image->h ? (i + 1) * mapped->band : mapped->image->h;
+    for(int y = i * mapped->band; y < end; y++)
+    {
+        SB3_DEV_errors_t error = __SB3_DEV_BMP_encode_row(mapped->image, y, mapped->layout, mapped->pixel_array + (size_t)y * mapped->layout->row_size);
+        if(error != SB3_DEV_SUCCESS_EXIT)
+        {
+            atomic_store(&mapped->error, error);
+            return;
+        }
+    }
+}
+
+SB3_DEV_errors_t SB3_DEV_BMP_write_image_mapped(const char* path, SB3_DEV_image_t* image, int threads)
+{
+    if(!image)
+    {
+        #ifdef SB3_DEV_CRASH_WHEN_ERROR
+            errx(EXIT_FAILURE, "WRITE_IMAGE_MAPPED: NULL image cannot be saved");
+        #else
+            SB3_DEV_SetError(SB3_DEV_NULL_IMAGE_ERROR);
+            return SB3_DEV_NULL_IMAGE_ERROR;
+        #endif
+    }
+    if(!path)
+    {
+        #ifdef SB3_DEV_CRASH_WHEN_ERROR
+            errx(EXIT_FAILURE, "WRITE_IMAGE_MAPPED: NULL path error");
+        #else
+            SB3_DEV_SetError(SB3_DEV_NULL_PATH_ERROR);
+            return SB3_DEV_NULL_PATH_ERROR;
+        #endif
+    }
+    if(!__SB3_DEV_BMP_extension(path))
+    {
+        #ifdef SB3_DEV_CRASH_WHEN_ERROR
+            errx(EXIT_FAILURE, "WRITE_IMAGE_MAPPED: Bad file extension (%s) (expected '.BMP' extension (with lower or upper cases))", path);
+        #else
+            SB3_DEV_SetError(SB3_DEV_BAD_EXTENSION_ERROR);
+            return SB3_DEV_BAD_EXTENSION_ERROR;
+        #endif
+    }
+    __SB3_DEV_BMP_layout_t layout;
+    __SB3_DEV_BMP_layout(image, &layout);
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    if(fd < 0)
+    {
+        #ifdef SB3_DEV_CRASH_WHEN_ERROR
+            errx(EXIT_FAILURE, "WRITE_IMAGE_MAPPED: Cannot open file at '%s'", path);
+        #else
+            SB3_DEV_SetError(SB3_DEV_CANNOT_OPEN_FILE_ERROR);
+            return SB3_DEV_CANNOT_OPEN_FILE_ERROR;
+        #endif
+    }
+    uint8_t* map = MAP_FAILED;
+    if(!ftruncate(fd, layout.total_size))
+        map = mmap(NULL, layout.total_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(map == MAP_FAILED)
+    {
+        // no empty or truncated bitmap left behind
+        unlink(path);
+        #ifdef SB3_DEV_CRASH_WHEN_ERROR
+            errx(EXIT_FAILURE, "WRITE_IMAGE_MAPPED: Cannot map file at '%s'", path);
+        #else
+            SB3_DEV_SetError(SB3_DEV_IO_ERROR);
+            return SB3_DEV_IO_ERROR;
+        #endif
+    }
+
+    __SB3_DEV_BMP_header(image, &layout, map);
+    // bands of rows encoded in place by the workers
+    __SB3_DEV_mapped_t mapped = {
+        .image = image,
+        .layout = &layout,
+        .pixel_array = map + layout.pixel_array_offset,
+        .band = 64,
+    };
+    atomic_init(&mapped.error, SB3_DEV_SUCCESS_EXIT);
+    __SB3_DEV_parallel_for((image->h + mapped.band - 1) / mapped.band, threads, __SB3_DEV_mapped_band, &mapped);
+    munmap(map, layout.total_size);
 
+    SB3_DEV_errors_t error = atomic_load(&mapped.error);
+    if(error != SB3_DEV_SUCCESS_EXIT)
+        unlink(path);
+    SB3_DEV_SetError(error);
+    return error;
+}
+
+int __SB3_DEV_BMP_padding(int width, int bits_per_pixels)
+{
+    // scanlines are aligned on 4 bytes
+    return (4 - ((width * bits_per_pixels + 7) / 8) % 4) % 4;
+}
+
+void __SB3_DEV_BMP_layout(SB3_DEV_image_t* image, __SB3_DEV_BMP_layout_t* layout)
+{
     int bits_per_pixels = 24;
     int color_table_size = 0;
     if(image->format == SB3_DEV_MONO_COLOR_FORMAT)
     { color_table_size = 256; bits_per_pixels = 8; }
     else if(image->format == SB3_DEV_BINARY_COLOR_FORMAT)
     { color_table_size = 2; bits_per_pixels = 1; }
+    else if(image->format == SB3_DEV_INDEXED_FORMAT)
+    {
+        // smallest depth holding the palette
+        color_table_size = image->palette_size;
+        bits_per_pixels = color_table_size <= 2 ? 1 : color_table_size <= 16 ? 4 : 8;
+    }
+    int padding = __SB3_DEV_BMP_padding(image->w, bits_per_pixels);
 
-    uint8_t color_table[color_table_size * 4];
+    const int file_header_size = 14;
+    const int info_header_size = 40;
+    layout->padding = padding;
+    layout->bits_per_pixels = bits_per_pixels;
+    layout->color_table_size = color_table_size;
+    layout->pixel_array_offset = file_header_size + info_header_size + color_table_size * 4;
+    layout->row_size = (image->w * bits_per_pixels + 7) / 8 + padding;
+    layout->total_size = layout->pixel_array_offset + (size_t)layout->row_size * image->h;
+    layout->file_size = layout->total_size;
+    layout->top_down = 0;
+}
+
+void __SB3_DEV_BMP_header(SB3_DEV_image_t* image, const __SB3_DEV_BMP_layout_t* layout, uint8_t* out)
+{
+    uint8_t color_table[layout->color_table_size * 4];
     
-    if(color_table_size == 2)
+    if(image->format == SB3_DEV_INDEXED_FORMAT)
+    {
+        for(int i = 0; i < layout->color_table_size; i++)
+        {
+            color_table[i*4+0] = image->palette[i].b;
+            color_table[i*4+1] = image->palette[i].g;
+            color_table[i*4+2] = image->palette[i].r;
+            color_table[i*4+3] = 0;
+        }
+    }
+    else if(layout->color_table_size == 2)
     {
         for(int i = 0; i < 2; i++)
         {
@@ -105,7 +290,7 @@ SB3_DEV_errors_t SB3_DEV_BMP_write_image(const char* path, SB3_DEV_image_t* imag
     }
     else
     {
-        for(int i = 0; i < color_table_size; i++)
+        for(int i = 0; i < layout->color_table_size; i++)
         {
             color_table[i*4+0] = color_table[i*4+1] = color_table[i*4+2] = i;
             color_table[i*4+3] = 0;
@@ -114,9 +299,7 @@ SB3_DEV_errors_t SB3_DEV_BMP_write_image(const char* path, SB3_DEV_image_t* imag
         
     const int file_header_size = 14;
     const int info_header_size = 40;
-    const int file_size = file_header_size + info_header_size + color_table_size * 4 + image->h * image->w * ((double)bits_per_pixels / 8.) + padding * image->h;
-    const int pixel_array_offset = file_header_size + info_header_size + color_table_size * 4;
-    
+
     // FILE HEADER
     uint8_t file_header[file_header_size];
     
@@ -124,10 +307,10 @@ SB3_DEV_errors_t SB3_DEV_BMP_write_image(const char* path, SB3_DEV_image_t* imag
     file_header[0] = 'B';
     file_header[1] = 'M';
     // file size
-    file_header[2] = file_size;
-    file_header[3] = file_size >> 8;
-    file_header[4] = file_size >> 16;
-    file_header[5] = file_size >> 24;
+    file_header[2] = layout->file_size;
+    file_header[3] = layout->file_size >> 8;
+    file_header[4] = layout->file_size >> 16;
+    file_header[5] = layout->file_size >> 24;
     // reserved 1 => UNUSED
     file_header[6] = 0;
     file_header[7] = 0;
@@ -135,10 +318,10 @@ SB3_DEV_errors_t SB3_DEV_BMP_write_image(const char* path, SB3_DEV_image_t* imag
     file_header[8] = 0;
     file_header[9] = 0;
     // file offset to pixel array
-    file_header[10] = pixel_array_offset;
-    file_header[11] = pixel_array_offset >> 8;
-    file_header[12] = pixel_array_offset >> 16;
-    file_header[13] = pixel_array_offset >> 24;
+    file_header[10] = layout->pixel_array_offset;
+    file_header[11] = layout->pixel_array_offset >> 8;
+    file_header[12] = layout->pixel_array_offset >> 16;
+    file_header[13] = layout->pixel_array_offset >> 24;
     
     // INFO HEADER
     uint8_t info_header[info_header_size];
@@ -153,16 +336,17 @@ SB3_DEV_errors_t SB3_DEV_BMP_write_image(const char* path, SB3_DEV_image_t* imag
     info_header[5] = image->w >> 8;
     info_header[6] = image->w >> 16;
     info_header[7] = image->w >> 24;
-    // image height
-    info_header[8] = image->h;
-    info_header[9] = image->h >> 8;
-    info_header[10] = image->h >> 16;
-    info_header[11] = image->h >> 24;
+    // image height (negative: top-down scanlines)
+    int height = layout->top_down ? -image->h : image->h;
+    info_header[8] = height;
+    info_header[9] = height >> 8;
+    info_header[10] = height >> 16;
+    info_header[11] = height >> 24;
     // planes
     info_header[12] = 1;
     info_header[13] = 0;
     // bits per pixels (24 for 3 bytes(RGB))
-    info_header[14] = bits_per_pixels;
+    info_header[14] = layout->bits_per_pixels;
     info_header[15] = 0;
     // compression (BI_RGB => no compression methodes => 0)
     info_header[16] = 0;
@@ -185,221 +369,321 @@ SB3_DEV_errors_t SB3_DEV_BMP_write_image(const char* path, SB3_DEV_image_t* imag
     info_header[30] = 0;
     info_header[31] = 0;
     // color palette (0 to default)
-    info_header[32] = color_table_size;
-    info_header[33] = color_table_size >> 8;
-    info_header[34] = color_table_size >> 16;
-    info_header[35] = color_table_size >> 24;
+    info_header[32] = layout->color_table_size;
+    info_header[33] = layout->color_table_size >> 8;
+    info_header[34] = layout->color_table_size >> 16;
+    info_header[35] = layout->color_table_size >> 24;
     // important colors (generally ignored)
     info_header[36] = 0;
     info_header[37] = 0;
     info_header[38] = 0;
     info_header[39] = 0;
     
-    for(int i = 0; i < file_header_size; i++)
-        fputc(file_header[i], file);
-    for(int i = 0; i < info_header_size; i++)
-        fputc(info_header[i], file);
-    for(int i = 0; i < color_table_size*4; i++)
-        fputc(color_table[i], file);
-    
+    memcpy(out, file_header, file_header_size);
+    memcpy(out + file_header_size, info_header, info_header_size);
+    memcpy(out + file_header_size + info_header_size, color_table, layout->color_table_size * 4);
+}
+
+SB3_DEV_errors_t __SB3_DEV_BMP_encode_row(SB3_DEV_image_t* image, int y, const __SB3_DEV_BMP_layout_t* layout, uint8_t* out)
+{
+    const uint8_t* row = __SB3_DEV_row(image, y);
+    if(image->format == SB3_DEV_RGB_FORMAT)
+    {
+        __SB3_DEV_swap_rb(row, out, image->w);
+        out += 3 * image->w;
+    }
+    else if(image->format == SB3_DEV_MONO_COLOR_FORMAT)
+    {
+        memcpy(out, row, image->w);
+        out += image->w;
+    }
+    else
+    {
+        uint8_t invalid = image->format == SB3_DEV_BINARY_COLOR_FORMAT ? __SB3_BMP_pack_binary(row, out, image->w)
+            : layout->bits_per_pixels == 1 ? __SB3_BMP_pack1(row, out, image->w, image->palette_size)
+            : layout->bits_per_pixels == 4 ? __SB3_BMP_pack4(row, out, image->w, image->palette_size)
+            : __SB3_BMP_pack8(row, out, image->w, image->palette_size);
+        if(invalid)
+        {
+            #ifdef SB3_DEV_CRASH_WHEN_ERROR
+                if(image->format == SB3_DEV_BINARY_COLOR_FORMAT)
+                    errx(EXIT_FAILURE, "WRITE_IMAGE: Bad binary format for image not only white and black");
+                errx(EXIT_FAILURE, "WRITE_IMAGE: Bad indexed image: index outside of the palette (%d colors)", image->palette_size);
+            #else
+                SB3_DEV_SetError(SB3_DEV_BAD_FORMAT_ERROR);
+                return SB3_DEV_BAD_FORMAT_ERROR;
+            #endif
+        }
+        out += (image->w * layout->bits_per_pixels + 7) / 8;
+    }
+    memset(out, 0, layout->padding);
+    return SB3_DEV_SUCCESS_EXIT;
+}
+
+SB3_DEV_errors_t __SB3_DEV_BMP_encode(__SB3_DEV_writer_t* writer, SB3_DEV_image_t* image, char top_down)
+{
+    __SB3_DEV_BMP_layout_t layout;
+    __SB3_DEV_BMP_layout(image, &layout);
+    layout.top_down = top_down;
+    __SB3_DEV_reserve(writer, layout.total_size);
+    if(writer->failed)
+    {
+        SB3_DEV_SetError(SB3_DEV_OUT_OF_MEMORY_ERROR);
+        return SB3_DEV_OUT_OF_MEMORY_ERROR;
+    }
+
+    uint8_t header[layout.pixel_array_offset];
+    __SB3_DEV_BMP_header(image, &layout, header);
+    __SB3_DEV_write(writer, header, layout.pixel_array_offset);
+
     // IMAGE DATA
+    uint8_t* row = __SB3_DEV_malloc(layout.row_size);
     for(int y = 0; y < image->h; y++)
     {
-        for(int x = 0; x < image->w; x++)
+        if(__SB3_DEV_BMP_encode_row(image, top_down ? image->h - 1 - y : y, &layout, row) != SB3_DEV_SUCCESS_EXIT)
         {
-            uint8_t r, g, b;
-            if(image->format == SB3_DEV_RGB_FORMAT)
-            {
-                SB3_DEV_RGBColor_t* color = image->rgb_pixels[y * image->w + x];
-                r = color->r; g = color->g; b = color->b;
-                fputc(b, file);
-                fputc(g, file);
-                fputc(r, file);
-            }
-            else if(image->format == SB3_DEV_MONO_COLOR_FORMAT)
-            {
-                fputc(image->mono_pixels[y*image->w+x]->color, file);
-            }
-            else
-            {
-                uint8_t to_put = 0;
-                for(int i = 0; i < 8 && x+i < image->w; i++)
-                {
-                    uint color = image->mono_pixels[y*image->w+x+i]->color;
-                    if(color == 0)
-                        to_put = to_put | (0 << (7-i));
-                    else if(color == 255)
-                        to_put = to_put | (1 << (7-i));
-                    else
-                    {
-                        fclose(file);
-                        #ifdef SB3_DEV_CRASH_WHEN_ERROR
-                            errx(EXIT_FAILURE, "WRITE_IMAGE: Bad binary format for image not only white and black");
-                        #else
-                            SB3_DEV_SetError(SB3_DEV_BAD_FORMAT_ERROR);
-                            return SB3_DEV_BAD_FORMAT_ERROR;
-                        #endif
-                    }
-                }
-                fputc(to_put, file);
-                x += 7;
-            }
+            __SB3_DEV_free(row);
+            return SB3_DEV_BAD_FORMAT_ERROR;
         }
-        for(int i = 0; i < padding; i++)
-            fputc(0, file);
+        __SB3_DEV_write(writer, row, layout.row_size);
     }
-    fclose(file);
+    __SB3_DEV_free(row);
     SB3_DEV_SetError(SB3_DEV_SUCCESS_EXIT);
     return SB3_DEV_SUCCESS_EXIT;
 }
 
-SB3_DEV_image_t* SB3_DEV_BMP_read_image(const char* path, SB3_DEV_image_format_t format)
+SB3_DEV_errors_t __SB3_DEV_BMP_parse(const uint8_t* headers, size_t size, SB3_DEV_BMP_info_t* info, const char* caller)
+{
+    const int file_header_size = 14;
+    const uint8_t* file_header = headers;
+    const uint8_t* info_header = headers + file_header_size;
+    if(size < 2 || file_header[0] != 'B' || file_header[1] != 'M')
+    {
+        #ifdef SB3_DEV_CRASH_WHEN_ERROR
+            errx(EXIT_FAILURE, "%s: Corrupted image => 'BM' signature not present at 2 first bytes of header bmp file", caller);
+        #else
+            (void)caller;
+            SB3_DEV_SetError(SB3_DEV_CORRUPTED_FILE_ERROR);
+            return SB3_DEV_CORRUPTED_FILE_ERROR;
+        #endif
+    }
+    if(size < __SB3_DEV_BMP_HEADERS_SIZE)
+    {
+        #ifdef SB3_DEV_CRASH_WHEN_ERROR
+            errx(EXIT_FAILURE, "%s: Corrupted file => truncated headers", caller);
+        #else
+            SB3_DEV_SetError(SB3_DEV_CORRUPTED_FILE_ERROR);
+            return SB3_DEV_CORRUPTED_FILE_ERROR;
+        #endif
+    }
+    
+    const uint32_t info_header_size = info_header[0] + (info_header[1] << 8) + (info_header[2] << 16) + ((uint32_t)info_header[3] << 24);
+    if(info_header_size < 40 || info_header_size == 64)
+    {
+        #ifdef SB3_DEV_CRASH_WHEN_ERROR
+            errx(EXIT_FAILURE, "%s: Unsuported bmp image format (suported: BITMAP(V[2,3,4,5])INFOHEADER))", caller);
+        #else
+            SB3_DEV_SetError(SB3_DEV_UNSUPORTED_BMP_FORMAT_ERROR);
+            return SB3_DEV_UNSUPORTED_BMP_FORMAT_ERROR;
+        #endif
+    }
+
+    uint32_t compression = info_header[16] + (info_header[17] << 8) + (info_header[18] << 16) + ((uint32_t)info_header[19] << 24);
+    if(compression != 0)
+    {
+        #ifdef SB3_DEV_CRASH_WHEN_ERROR
+            errx(EXIT_FAILURE, "%s: Unsuported bmp image format (unsuported bmp compression)[received: %d compression value]", caller, compression);
+        #else
+            SB3_DEV_SetError(SB3_DEV_UNSUPORTED_BMP_FORMAT_ERROR);
+            return SB3_DEV_UNSUPORTED_BMP_FORMAT_ERROR;
+        #endif
+    }
+    
+    int bit_color = info_header[14] + (info_header[15] << 8);
+    if(bit_color != 1 && bit_color != 2 && bit_color != 4 && bit_color != 8 && bit_color != 24)
+    {
+        if(bit_color == 16 || bit_color == 32)
+        {
+            #ifdef SB3_DEV_CRASH_WHEN_ERROR
+                errx(EXIT_FAILURE, "%s: Unsuported bmp image format (unsuported RGBA format (Alpha not suported))", caller);
+            #else
+                SB3_DEV_SetError(SB3_DEV_UNSUPORTED_BMP_FORMAT_ERROR);
+                return SB3_DEV_UNSUPORTED_BMP_FORMAT_ERROR;
+            #endif
+        }
+        else
+        {
+            #ifdef SB3_DEV_CRASH_WHEN_ERROR
+                errx(EXIT_FAILURE, "%s: Corrupted file => bit per color must be in {1,2,4,8,24} : 16 and 32 not supported", caller);
+            #else
+                SB3_DEV_SetError(SB3_DEV_CORRUPTED_FILE_ERROR);
+                return SB3_DEV_CORRUPTED_FILE_ERROR;
+            #endif
+        }
+    }
+
+    *info = (SB3_DEV_BMP_info_t) {
+        .width = info_header[4] + (info_header[5] << 8) + (info_header[6] << 16) + (info_header[7] << 24),
+        .height = (int32_t)(info_header[8] + (info_header[9] << 8) + (info_header[10] << 16) + ((uint32_t)info_header[11] << 24)),
+        .bits_per_pixels = bit_color,
+        .compression = compression,
+        .colors_used = info_header[32] + (info_header[33] << 8) + (info_header[34] << 16) + ((uint32_t)info_header[35] << 24),
+        .file_size = file_header[2] + (file_header[3] << 8) + (file_header[4] << 16) + ((uint32_t)file_header[5] << 24),
+        .pixel_array_offset = file_header[10] + (file_header[11] << 8) + (file_header[12] << 16) + ((uint32_t)file_header[13] << 24),
+        .info_header_size = info_header_size,
+    };
+    if(info->height == INT32_MIN)
+    {
+        #ifdef SB3_DEV_CRASH_WHEN_ERROR
+            errx(EXIT_FAILURE, "%s: Corrupted file => invalid height", caller);
+        #else
+            SB3_DEV_SetError(SB3_DEV_CORRUPTED_FILE_ERROR);
+            return SB3_DEV_CORRUPTED_FILE_ERROR;
+        #endif
+    }
+    SB3_DEV_SetError(SB3_DEV_SUCCESS_EXIT);
+    return SB3_DEV_SUCCESS_EXIT;
+}
+
+SB3_DEV_errors_t SB3_DEV_BMP_probe(const char* path, SB3_DEV_BMP_info_t* info)
 {
     if(!path)
     {
         #ifdef SB3_DEV_CRASH_WHEN_ERROR
-            errx(EXIT_FAILURE, "READ_IMAGE: NULL path error");
+            errx(EXIT_FAILURE, "PROBE: NULL path error");
         #else
             SB3_DEV_SetError(SB3_DEV_NULL_PATH_ERROR);
-            return NULL;
+            return SB3_DEV_NULL_PATH_ERROR;
         #endif
     }
-    int len = strlen(path);
-    if (len <= 4 || path[len-4] != '.' || (path[len-3] != 'B' && path[len-3] != 'b') ||
-            (path[len-2] != 'M' && path[len-2] != 'm') || (path[len-1] != 'P' && path[len-1] != 'p'))
+    if(!__SB3_DEV_BMP_extension(path))
     {
         #ifdef SB3_DEV_CRASH_WHEN_ERROR
-            errx(EXIT_FAILURE, "READ_IMAGE: Bad file extension (%s) (expected '.BMP' extension (with lower or upper cases))", path);
+            errx(EXIT_FAILURE, "PROBE: Bad file extension (%s) (expected '.BMP' extension (with lower or upper cases))", path);
         #else
             SB3_DEV_SetError(SB3_DEV_BAD_EXTENSION_ERROR);
-            return NULL;
+            return SB3_DEV_BAD_EXTENSION_ERROR;
         #endif
     }
-    FILE* file;
-    file = fopen(path, "rb");
-    if(!file)
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if(fd < 0)
     {
         #ifdef SB3_DEV_CRASH_WHEN_ERROR
-            errx(EXIT_FAILURE, "READ_IMAGE: Cannot open file at '%s'", path);
+            errx(EXIT_FAILURE, "PROBE: Cannot open file at '%s'", path);
         #else
             SB3_DEV_SetError(SB3_DEV_CANNOT_OPEN_FILE_ERROR);
-            return NULL;
+            return SB3_DEV_CANNOT_OPEN_FILE_ERROR;
         #endif
     }
-    
-    const int file_header_size = 14;
-    
-    uint8_t file_header[file_header_size];    
-    if((file_header[0] = fgetc(file)) != 'B' || (file_header[1] = fgetc(file)) != 'M')
+    // the file header and the part of the info header shared by all the versions, in one read
+    uint8_t headers[__SB3_DEV_BMP_HEADERS_SIZE];
+    ssize_t size;
+    do
+        size = read(fd, headers, sizeof(headers));
+    while(size < 0 && errno == EINTR);
+    close(fd);
+    if(size < 0)
     {
-        fclose(file);
         #ifdef SB3_DEV_CRASH_WHEN_ERROR
-            errx(EXIT_FAILURE, "READ_IMAGE: Corrupted image => 'BM' signature not present at 2 first bytes of header bmp file");
+            errx(EXIT_FAILURE, "PROBE: Cannot read file at '%s'", path);
         #else
-            SB3_DEV_SetError(SB3_DEV_CORRUPTED_FILE_ERROR);
-            return NULL;
+            SB3_DEV_SetError(SB3_DEV_IO_ERROR);
+            return SB3_DEV_IO_ERROR;
         #endif
     }
-    for(int i = 2; i < file_header_size; i++)
-        file_header[i] = fgetc(file);
+    SB3_DEV_BMP_info_t parsed;
+    SB3_DEV_errors_t error = __SB3_DEV_BMP_parse(headers, size, &parsed, "PROBE");
+    if(error == SB3_DEV_SUCCESS_EXIT && info)
+        *info = parsed;
+    return error;
+}
 
-    // int file_size = file_header[2] + (file_header[3] << 8) + (file_header[4] << 16) + (file_header[5] << 24);
-    
-    const uint32_t info_header_size = fgetc(file) + (fgetc(file) << 8) + (fgetc(file) << 16) + (fgetc(file) << 24);
-    if(info_header_size < 40 || info_header_size == 64)
+SB3_DEV_image_t* SB3_DEV_BMP_read_image(const char* path, SB3_DEV_image_format_t format)
+{
+    if(!path)
     {
-        fclose(file);
         #ifdef SB3_DEV_CRASH_WHEN_ERROR
-            errx(EXIT_FAILURE, "READ_IMAGE: Unsuported bmp image format (suported: BITMAP(V[2,3,4,5])INFOHEADER))");
+            errx(EXIT_FAILURE, "READ_IMAGE: NULL path error");
         #else
-            SB3_DEV_SetError(SB3_DEV_UNSUPORTED_BMP_FORMAT_ERROR);
+            SB3_DEV_SetError(SB3_DEV_NULL_PATH_ERROR);
             return NULL;
         #endif
     }
-    uint8_t info_header[info_header_size];
-    info_header[0] = info_header_size;
-    info_header[1] = info_header_size >> 8;
-    info_header[2] = info_header_size >> 16;
-    info_header[3] = info_header_size >> 24;
-    for(uint i = 4; i < info_header_size; i++)
-        info_header[i] = fgetc(file);
-
-    /*
-    if(info_header[13] != 1 || info_header[14] != 0)
+    if(!__SB3_DEV_BMP_extension(path))
     {
-        fclose(file);
         #ifdef SB3_DEV_CRASH_WHEN_ERROR
-            errx(EXIT_FAILURE, "READ_IMAGE: Corrupted file => color planes must be 1 :)(receved: %d)", info_header[13] + (info_header[14] << 8));
+            errx(EXIT_FAILURE, "READ_IMAGE: Bad file extension (%s) (expected '.BMP' extension (with lower or upper cases))", path);
         #else
-            SB3_DEV_SetError(SB3_DEV_CORRUPTED_FILE_ERROR);
+            SB3_DEV_SetError(SB3_DEV_BAD_EXTENSION_ERROR);
             return NULL;
         #endif
     }
-    */
-    int width = info_header[4] + (info_header[5] << 8) + (info_header[6] << 16) + (info_header[7] << 24);
-    int height = info_header[8] + (info_header[9] << 8) + (info_header[10] << 16) + (info_header[11] << 24);
-    
-    uint32_t compression = info_header[16] + (info_header[17] << 8) + (info_header[18] << 16) + (info_header[19] << 24);
-    // uint32_t image_size = info_header[20] + (info_header[21] << 8) + (info_header[22] << 16) + (info_header[23] << 24);
-    
-    if(compression != 0)
+    FILE* file;
+    file = fopen(path, "rb");
+    if(!file)
     {
-        fclose(file);
         #ifdef SB3_DEV_CRASH_WHEN_ERROR
-            errx(EXIT_FAILURE, "READ_IMAGE: Unsuported bmp image format (unsuported bmp compression)[received: %d compression value]", compression);
+            errx(EXIT_FAILURE, "READ_IMAGE: Cannot open file at '%s'", path);
         #else
-            SB3_DEV_SetError(SB3_DEV_UNSUPORTED_BMP_FORMAT_ERROR);
+            SB3_DEV_SetError(SB3_DEV_CANNOT_OPEN_FILE_ERROR);
             return NULL;
         #endif
     }
-    
-    uint32_t colors_used = info_header[32] + (info_header[33] << 8) + (info_header[34] << 16) + (info_header[35] << 24);
-    int bit_color = info_header[14] + (info_header[15] << 8);
-    
+    __SB3_DEV_reader_t reader = { .file = file };
+    SB3_DEV_image_t* image = __SB3_DEV_BMP_decode(&reader, format);
+    fclose(file);
+    return image;
+}
+
+SB3_DEV_errors_t __SB3_DEV_BMP_decode_header(__SB3_DEV_reader_t* reader, SB3_DEV_image_format_t format, SB3_DEV_BMP_info_t* info, uint8_t* color_table)
+{
+    uint8_t headers[__SB3_DEV_BMP_HEADERS_SIZE];
+    for(int i = 0; i < __SB3_DEV_BMP_HEADERS_SIZE; i++)
+        headers[i] = __SB3_DEV_getc(reader);
+    SB3_DEV_errors_t error = __SB3_DEV_BMP_parse(headers, __SB3_DEV_BMP_HEADERS_SIZE, info, "READ_IMAGE");
+    if(error != SB3_DEV_SUCCESS_EXIT)
+        return error;
+    // skip the end of the V[2,3,4,5] info headers
+    for(uint32_t i = 40; i < info->info_header_size; i++)
+        __SB3_DEV_getc(reader);
+
+    int bit_color = info->bits_per_pixels;
     if(format == SB3_DEV_BINARY_COLOR_FORMAT && bit_color != 1)
     {
-        fclose(file);
         #ifdef SB3_DEV_CRASH_WHEN_ERROR
             errx(EXIT_FAILURE, "READ_IMAGE: Bad format: 1bit per pixels <= BINARY_COLOR_FORMAT");
         #else
             SB3_DEV_SetError(SB3_DEV_BAD_FORMAT_ERROR);
-            return NULL;
+            return SB3_DEV_BAD_FORMAT_ERROR;
         #endif
     }
     
-    if(bit_color != 1 && bit_color != 2 && bit_color != 4 && bit_color != 8 && bit_color != 24)
+    if(format == SB3_DEV_INDEXED_FORMAT && bit_color > 8)
     {
-        fclose(file);
-        if(bit_color == 16 || bit_color == 32)
-        {
-            #ifdef SB3_DEV_CRASH_WHEN_ERROR
-                errx(EXIT_FAILURE, "READ_IMAGE: Unsuported bmp image format (unsuported RGBA format (Alpha not suported))");
-            #else
-                SB3_DEV_SetError(SB3_DEV_UNSUPORTED_BMP_FORMAT_ERROR);
-                return NULL;
-            #endif
-        }
-        else
-        {
-            #ifdef SB3_DEV_CRASH_WHEN_ERROR
-                errx(EXIT_FAILURE, "READ_IMAGE: Corrupted file => bit per color must be in {1,2,4,8,24} : 16 and 32 not supported");
-            #else
-                SB3_DEV_SetError(SB3_DEV_CORRUPTED_FILE_ERROR);
-                return NULL;
-            #endif
-        }
+        #ifdef SB3_DEV_CRASH_WHEN_ERROR
+            errx(EXIT_FAILURE, "READ_IMAGE: Bad format: INDEXED_FORMAT needs a palette (1, 2, 4 or 8 bits per pixels)");
+        #else
+            SB3_DEV_SetError(SB3_DEV_BAD_FORMAT_ERROR);
+            return SB3_DEV_BAD_FORMAT_ERROR;
+        #endif
     }
-    
-    uint8_t* color_table = NULL;
-    if(colors_used == 0)
-        colors_used = 2<<(bit_color - 1);
-    int cool_size = colors_used * 4;
+
     if(bit_color < 16)
     {
-        color_table = malloc(cool_size * sizeof(uint8_t));
-        for(int i = 0; i < cool_size; i++)
-            color_table[i] = fgetc(file);
+        if(info->colors_used == 0)
+            info->colors_used = 2<<(bit_color - 1);
+        // indexes can't reach more than 256 entries: the rest of a bigger table is skipped
+        for(uint32_t i = 0; i < info->colors_used * 4; i++)
+        {
+            uint8_t c = __SB3_DEV_getc(reader);
+            if(i < __SB3_DEV_BMP_COLOR_TABLE_SIZE)
+                color_table[i] = c;
+        }
     }
+    // some writers leave a gap before the pixel array
+    uint64_t position = __SB3_DEV_BMP_headers_end(info);
+    if(info->pixel_array_offset > position)
+        __SB3_DEV_skip(reader, info->pixel_array_offset - position);
     if(format == SB3_DEV_BINARY_COLOR_FORMAT)
     {
         for(int i = 0; i < bit_color; i++)
@@ -407,200 +691,427 @@ SB3_DEV_image_t* SB3_DEV_BMP_read_image(const char* path, SB3_DEV_image_format_t
             uint8_t r = color_table[i*4+2], g = color_table[i*4+1], b = color_table[i*4+0];
             if(r!=g || g!=b || (r!=0 && r!=255))
             {
-                fclose(file);
-                free(color_table);
                 #ifdef SB3_DEV_CRASH_WHEN_ERROR
                     errx(EXIT_FAILURE, "READ_IMAGE: Bad format: expected black and white image");
                 #else
                     SB3_DEV_SetError(SB3_DEV_BAD_FORMAT_ERROR);
-                    return NULL;
+                    return SB3_DEV_BAD_FORMAT_ERROR;
                 #endif
             }
         }
     }
+    return SB3_DEV_SUCCESS_EXIT;
+}
 
-    SB3_DEV_RGBColor_t** rgb_pixels = NULL;
-    SB3_DEV_monoColor_t** mono_pixels = NULL;
-    
-    if(format == SB3_DEV_RGB_FORMAT)
-        rgb_pixels = malloc(width*height*sizeof(SB3_DEV_RGBColor_t*));
-    else
-        mono_pixels = malloc(width*height*sizeof(SB3_DEV_monoColor_t*));
-
-    int padding = 0;
-    if(bit_color == 24)
-        padding = ((4 - (width * 3) % 4) % 4);
-    else if(bit_color == 8)
-        padding = width % 4;
-    else if(bit_color == 4)
-        padding = ((width % 2) + (width / 2)%4) % 4;
-    else if(bit_color == 2)
-        padding = ((width % 4) + (width / 4)%4) % 4;
-    else if(bit_color == 1)
-        padding = ((width % 8) + (width / 8)%4) % 4;
-    
-    for (int y = 0; y < height; y++)
+// specializations using the simd conversions of sb3_dev_color.c
+static uint8_t __SB3_DEV_BMP_decode24_rgb(const uint8_t* src, uint8_t* dst, int width, const __SB3_BMP_lut_t* lut)
+{
+    (void)lut;
+    __SB3_DEV_swap_rb(src, dst, width);
+    return 0;
+}
+
+// 8 bits files with the identity gray palette: copied / expanded without lookups
+static uint8_t __SB3_DEV_BMP_decode_gray8_rgb(const uint8_t* src, uint8_t* dst, int width, const __SB3_BMP_lut_t* lut)
+{
+    (void)lut;
+    __SB3_DEV_gray_to_rgb(src, dst, width);
+    return 0;
+}
+
+static uint8_t __SB3_DEV_BMP_decode_gray8_gray(const uint8_t* src, uint8_t* dst, int width, const __SB3_BMP_lut_t* lut)
+{
+    (void)lut;
+    if(src != dst)
+        memcpy(dst, src, width);
+    return 0;
+}
+
+SB3_DEV_errors_t __SB3_DEV_BMP_decode_rows(__SB3_DEV_reader_t* reader, SB3_DEV_image_format_t format, const SB3_DEV_BMP_info_t* info, const uint8_t* color_table, uint8_t* pixels, int first, int last)
+{
+    int width = info->width;
+    int height = __SB3_DEV_BMP_rows(info);
+    int bit_color = info->bits_per_pixels;
+    int padding = __SB3_DEV_BMP_padding(width, bit_color);
+
+    // one kernel for the whole file
+    __SB3_BMP_destination_t destination = format == SB3_DEV_RGB_FORMAT ? __SB3_BMP_TO_RGB
+        : format == SB3_DEV_INDEXED_FORMAT ? __SB3_BMP_TO_INDEX : __SB3_BMP_TO_GRAY;
+    __SB3_BMP_decode_t decode = __SB3_BMP_decoder(bit_color, destination);
+    __SB3_BMP_lut_t lut;
+    if(bit_color <= 8)
+        __SB3_BMP_lut(&lut, color_table, info->colors_used);
+    char gray_palette = bit_color == 8 && info->colors_used >= 256 && destination != __SB3_BMP_TO_INDEX;
+    for(int i = 0; gray_palette && i < 256; i++)
+        gray_palette = lut.gray[i] == i && !lut.flags[i];
+    if(gray_palette)
+        decode = destination == __SB3_BMP_TO_RGB ? __SB3_DEV_BMP_decode_gray8_rgb : __SB3_DEV_BMP_decode_gray8_gray;
+    else if(bit_color == 24 && destination == __SB3_BMP_TO_RGB)
+        decode = __SB3_DEV_BMP_decode24_rgb;
+    // indexes are only checked against the table for rgb and indexed images
+    uint8_t checked = destination == __SB3_BMP_TO_GRAY ? __SB3_BMP_OUT_OF_TABLE | __SB3_BMP_NOT_GRAY : __SB3_BMP_OUT_OF_TABLE;
+
+    // scanlines as large as the decoded rows are decoded in place, the others go through packed
+    // by chunks of __SB3_DEV_BMP_CHUNK pixels (a multiple of 8: chunks start on a byte) without allocation
+    size_t packed_size = ((size_t)width * bit_color + 7) / 8;
+    int pixel_size = __SB3_DEV_pixel_size(format);
+    size_t row_size = (size_t)width * pixel_size;
+    char in_place = packed_size == row_size;
+    uint8_t packed[__SB3_DEV_BMP_CHUNK * 3];
+
+    for (int file_y = first; file_y < last; file_y++)
     {
-        for(int x = 0; x < width; x++)
+        // rows land at their final place: no reordering pass for top-down files
+        int y = info->height < 0 ? height - 1 - file_y : file_y;
+        uint8_t* row = pixels + (size_t)y * row_size;
+        uint8_t flags = 0;
+        if(in_place)
         {
-            uint8_t r, g, b;
-            if(bit_color == 24)
-            {
-                b = fgetc(file);
-                g = fgetc(file);
-                r = fgetc(file);
-            }
-            else
+            __SB3_DEV_read(reader, row, packed_size);
+            flags = decode(row, row, width, &lut);
+        }
+        else
+            for(int x = 0; x < width; x += __SB3_DEV_BMP_CHUNK)
             {
-                uint8_t uwu = fgetc(file);
-                if(bit_color == 8)
-                {
-                    if(uwu >= colors_used)
-                    {
-                        free(color_table);
-                        fclose(file);
-                        if(format == SB3_DEV_RGB_FORMAT)
-                        { for(int k = 0; k < y*width+x; k++) free(rgb_pixels[k]); free(rgb_pixels); }
-                        else
-                        { for(int k = 0; k < y*width+x; k++) free(mono_pixels[k]); free(mono_pixels); }
-                        #ifdef SB3_DEV_CRASH_WHEN_ERROR
-                            errx(EXIT_FAILURE, "READ_FILE: Corrupted color table size");
-                        #else
-                            SB3_DEV_SetError(SB3_DEV_CORRUPTED_FILE_ERROR);
-                            return NULL;
-                        #endif
-                    }
-                    b = color_table[uwu*4+0];
-                    g = color_table[uwu*4+1];
-                    r = color_table[uwu*4+2];
-                }
-                else
-                {
-                    for(int i = 0; i*bit_color < 8 && x+i < width; i++)
-                    {
-                        uint alcohol = uwu >> (8 - bit_color - (i * bit_color));
-                        switch(bit_color)
-                        {
-                            case 4:
-                                alcohol = alcohol & 0b1111;
-                                break;
-                            case 2:
-                                alcohol = alcohol & 0b11;
-                                break;
-                            case 1:
-                                alcohol = alcohol & 0b1;
-                                break;
-                        }
-                        if(alcohol >= colors_used)
-                        {
-                            free(color_table);
-                            fclose(file);
-                            if(format == SB3_DEV_RGB_FORMAT)
-                            { for(int k = 0; k < y*width+x+i; k++) free(rgb_pixels[k]); free(rgb_pixels); }
-                            else
-                            { for(int k = 0; k < y*width+x+i; k++) free(mono_pixels[k]); free(mono_pixels); }
-                            #ifdef SB3_DEV_CRASH_WHEN_ERROR
-                                errx(EXIT_FAILURE, "READ_FILE: Corrupted color table size (color_table_size = %d and index = %d)", colors_used, alcohol);
-                            #else
-                                SB3_DEV_SetError(SB3_DEV_CORRUPTED_FILE_ERROR);
-                                return NULL;
-                            #endif
-                        }
-                        b = color_table[alcohol*4+0];
-                        g = color_table[alcohol*4+1];
-                        r = color_table[alcohol*4+2];
-                        if(format == SB3_DEV_RGB_FORMAT)
-                        {
-                            SB3_DEV_RGBColor_t* color = malloc(sizeof(*color));
-                            *color = (SB3_DEV_RGBColor_t) {
-                                .r = r,
-                                .g = g,
-                                .b = b,
-                            };
-                            rgb_pixels[y*width+x+i] = color;
-                        }
-                        else
-                        {
-                            if(r==g&&g==b)
-                            {
-                                SB3_DEV_monoColor_t* color = malloc(sizeof(*color));
-                                color->color = r;
-                                mono_pixels[y*width+x+i] = color;
-                            }
-                            else
-                            {
-                                free(color_table); fclose(file);
-                                for(int k = 0; k < y*width+x+i; k++)
-                                    free(mono_pixels[k]);
-                                free(mono_pixels);
-                                #ifdef SB3_DEV_CRASH_WHEN_ERROR
-                                    errx(EXIT_FAILURE, "READ_FILE: Incorrect Mono color format");
-                                #else
-                                    SB3_DEV_SetError(SB3_DEV_BAD_FORMAT_ERROR);
-                                    return NULL;
-                                #endif
-                            }
-                        }
-                    }
-                    x += 8/bit_color -1;
-                    continue;
-                }
+                int count = width - x < __SB3_DEV_BMP_CHUNK ? width - x : __SB3_DEV_BMP_CHUNK;
+                __SB3_DEV_read(reader, packed, ((size_t)count * bit_color + 7) / 8);
+                flags |= decode(packed, row + (size_t)x * pixel_size, count, &lut);
             }
-            if(format == SB3_DEV_RGB_FORMAT)
+        flags &= checked;
+        for(int i = 0; i < padding; i++)
+            __SB3_DEV_getc(reader);
+        if(flags)
+        {
+            if(flags & __SB3_BMP_OUT_OF_TABLE)
             {
-                SB3_DEV_RGBColor_t* color = malloc(sizeof(*color));
-                *color = (SB3_DEV_RGBColor_t) {
-                    .r = r,
-                    .g = g,
-                    .b = b,
-                };
-                rgb_pixels[y * width + x] = color;
+                #ifdef SB3_DEV_CRASH_WHEN_ERROR
+                    errx(EXIT_FAILURE, "READ_FILE: Corrupted color table size (color_table_size = %d)", info->colors_used);
+                #else
+                    SB3_DEV_SetError(SB3_DEV_CORRUPTED_FILE_ERROR);
+                    return SB3_DEV_CORRUPTED_FILE_ERROR;
+                #endif
             }
-            else
+            #ifdef SB3_DEV_CRASH_WHEN_ERROR
+                errx(EXIT_FAILURE, "READ_FILE: Incorrect Mono color format");
+            #else
+                SB3_DEV_SetError(SB3_DEV_BAD_FORMAT_ERROR);
+                return SB3_DEV_BAD_FORMAT_ERROR;
+            #endif
+        }
+    }
+
+    SB3_DEV_SetError(SB3_DEV_SUCCESS_EXIT);
+    return SB3_DEV_SUCCESS_EXIT;
+}
+
+SB3_DEV_errors_t __SB3_DEV_BMP_decode_pixels(__SB3_DEV_reader_t* reader, SB3_DEV_image_format_t format, const SB3_DEV_BMP_info_t* info, const uint8_t* color_table, uint8_t* pixels)
+{
+    return __SB3_DEV_BMP_decode_rows(reader, format, info, color_table, pixels, 0, __SB3_DEV_BMP_rows(info));
+}
+
+void __SB3_DEV_BMP_palette(SB3_DEV_image_t* image, const SB3_DEV_BMP_info_t* info, const uint8_t* color_table)
+{
+    image->palette_size = info->colors_used < 256 ? info->colors_used : 256;
+    for(int i = 0; i < image->palette_size; i++)
+        image->palette[i] = (SB3_DEV_RGBColor_t) {
+            .r = color_table[i*4+2],
+            .g = color_table[i*4+1],
+            .b = color_table[i*4+0],
+        };
+}
+
+SB3_DEV_image_t* __SB3_DEV_BMP_decode(__SB3_DEV_reader_t* reader, SB3_DEV_image_format_t format)
+{
+    SB3_DEV_BMP_info_t info;
+    uint8_t color_table[__SB3_DEV_BMP_COLOR_TABLE_SIZE];
+    if(__SB3_DEV_BMP_decode_header(reader, format, &info, color_table) != SB3_DEV_SUCCESS_EXIT)
+        return NULL;
+    SB3_DEV_image_t* image = SB3_DEV_NewImage(info.width, __SB3_DEV_BMP_rows(&info), format);
+    if(format == SB3_DEV_INDEXED_FORMAT)
+        __SB3_DEV_BMP_palette(image, &info, color_table);
+    if(__SB3_DEV_BMP_decode_pixels(reader, format, &info, color_table, image->pixels) != SB3_DEV_SUCCESS_EXIT)
+    {
+        SB3_DEV_FreeImage(image);
+        return NULL;
+    }
+    return image;
+}
+
+void __SB3_DEV_read(__SB3_DEV_reader_t* reader, uint8_t* dst, size_t size)
+{
+    while(size)
+    {
+        size_t n = reader->size - reader->pos;
+        if(!n)
+        {
+            if(reader->file)
             {
-                if(r == g && g == b)
-                {
-                    SB3_DEV_monoColor_t* color = malloc(sizeof(*color));
-                    color->color = r;
-                    mono_pixels[y * width + x] = color;
-                }
-                else
-                {
-                    if(bit_color < 16)
-                        free(color_table);
-                    fclose(file);
-                    for(int i = 0; i < y * width + x; i++)
-                        free(mono_pixels[i]);
-                    free(mono_pixels);
-                    #ifdef SB3_DEV_CRASH_WHEN_ERROR
-                        errx(EXIT_FAILURE, "READ_FILE: Incorrect Mono color format");
-                    #else
-                        SB3_DEV_SetError(SB3_DEV_BAD_FORMAT_ERROR);
-                        return NULL;
-                    #endif
-                }
+                n = fread(dst, 1, size, reader->file);
+                // EOF bytes, as __SB3_DEV_getc
+                memset(dst + n, (uint8_t)EOF, size - n);
+                return;
             }
+            if(!reader->buffer)
+                break;
+            // refill consumes the first byte
+            *dst++ = __SB3_DEV_refill(reader);
+            size--;
+            if(!reader->size)
+                break;
+            continue;
         }
-        for(int i = 0; i < padding; i++)
-            fgetc(file);
+        if(n > size)
+            n = size;
+        memcpy(dst, reader->data + reader->pos, n);
+        reader->pos += n;
+        dst += n;
+        size -= n;
     }
-    fclose(file);
+    memset(dst, (uint8_t)EOF, size);
+}
 
-    SB3_DEV_image_t* image = malloc(sizeof(*image));
-    *image = (SB3_DEV_image_t) {
-        .w = width,
-        .h = height,
-        .format = format,
-        .mono_pixels = mono_pixels,
-        .rgb_pixels = rgb_pixels,
-    };
-    
-    if(bit_color < 16)
-        free(color_table);
+void __SB3_DEV_skip(__SB3_DEV_reader_t* reader, size_t size)
+{
+    size_t n = reader->size - reader->pos;
+    if(size <= n)
+    {
+        reader->pos += size;
+        return;
+    }
+    size -= n;
+    reader->pos = reader->size;
+    if(reader->file)
+    {
+        fseek(reader->file, size, SEEK_CUR);
+        return;
+    }
+    if(!reader->buffer)
+        return;
+    if(reader->io ? reader->io->seek && reader->io->seek(reader->io->handle, size, SEEK_CUR) >= 0
+        : lseek(reader->fd, size, SEEK_CUR) >= 0)
+        return;
+    // not seekable (pipe, io without seek): read the gap
+    while(size)
+    {
+        __SB3_DEV_refill(reader);
+        if(!reader->size)
+            return;
+        reader->pos = size < reader->size ? size : reader->size;
+        size -= reader->pos;
+    }
+}
 
-    SB3_DEV_SetError(SB3_DEV_SUCCESS_EXIT);
-    return image;
+uint8_t __SB3_DEV_refill(__SB3_DEV_reader_t* reader)
+{
+    ssize_t size;
+    if(reader->io)
+        size = reader->io->read(reader->io->handle, reader->buffer, reader->capacity);
+    else
+        do
+            size = read(reader->fd, reader->buffer, reader->capacity);
+        while(size < 0 && errno == EINTR);
+    reader->data = reader->buffer;
+    reader->size = size > 0 ? size : 0;
+    reader->pos = 0;
+    return reader->size ? reader->data[reader->pos++] : (uint8_t)EOF;
 }
 
+// image (may be NULL) receives the palette of indexed files
+SB3_DEV_errors_t __SB3_DEV_BMP_read_into(const char* path, SB3_DEV_image_format_t format, void* pixels, int width, int height, SB3_DEV_image_t* image)
+{
+    if(!path)
+    {
+        #ifdef SB3_DEV_CRASH_WHEN_ERROR
+            errx(EXIT_FAILURE, "READ_INTO: NULL path error");
+        #else
+            SB3_DEV_SetError(SB3_DEV_NULL_PATH_ERROR);
+            return SB3_DEV_NULL_PATH_ERROR;
+        #endif
+    }
+    if(!pixels)
+    {
+        #ifdef SB3_DEV_CRASH_WHEN_ERROR
+            errx(EXIT_FAILURE, "READ_INTO: NULL image or buffer");
+        #else
+            SB3_DEV_SetError(SB3_DEV_NULL_IMAGE_ERROR);
+            return SB3_DEV_NULL_IMAGE_ERROR;
+        #endif
+    }
+    if(!__SB3_DEV_BMP_extension(path))
+    {
+        #ifdef SB3_DEV_CRASH_WHEN_ERROR
+            errx(EXIT_FAILURE, "READ_INTO: Bad file extension (%s) (expected '.BMP' extension (with lower or upper cases))", path);
+        #else
+            SB3_DEV_SetError(SB3_DEV_BAD_EXTENSION_ERROR);
+            return SB3_DEV_BAD_EXTENSION_ERROR;
+        #endif
+    }
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if(fd < 0)
+    {
+        #ifdef SB3_DEV_CRASH_WHEN_ERROR
+            errx(EXIT_FAILURE, "READ_INTO: Cannot open file at '%s'", path);
+        #else
+            SB3_DEV_SetError(SB3_DEV_CANNOT_OPEN_FILE_ERROR);
+            return SB3_DEV_CANNOT_OPEN_FILE_ERROR;
+        #endif
+    }
+    // no FILE: the read buffer lives on the stack
+    uint8_t buffer[1 << 16];
+    __SB3_DEV_reader_t reader = { .fd = fd, .buffer = buffer, .capacity = sizeof(buffer) };
+    SB3_DEV_BMP_info_t info;
+    uint8_t color_table[__SB3_DEV_BMP_COLOR_TABLE_SIZE];
+    SB3_DEV_errors_t error = __SB3_DEV_BMP_decode_header(&reader, format, &info, color_table);
+    if(error == SB3_DEV_SUCCESS_EXIT && (info.width != width || __SB3_DEV_BMP_rows(&info) != height))
+    {
+        close(fd);
+        #ifdef SB3_DEV_CRASH_WHEN_ERROR
+            errx(EXIT_FAILURE, "READ_INTO: Size mismatch: file is %dx%d, destination is %dx%d", info.width, __SB3_DEV_BMP_rows(&info), width, height);
+        #else
+            SB3_DEV_SetError(SB3_DEV_SIZE_MISMATCH_ERROR);
+            return SB3_DEV_SIZE_MISMATCH_ERROR;
+        #endif
+    }
+    if(error == SB3_DEV_SUCCESS_EXIT)
+        error = __SB3_DEV_BMP_decode_pixels(&reader, format, &info, color_table, pixels);
+    if(error == SB3_DEV_SUCCESS_EXIT && image && format == SB3_DEV_INDEXED_FORMAT)
+        __SB3_DEV_BMP_palette(image, &info, color_table);
+    close(fd);
+    return error;
+}
 
+SB3_DEV_errors_t SB3_DEV_BMP_read_into_buffer(const char* path, SB3_DEV_image_format_t format, void* pixels, int width, int height)
+{
+    return __SB3_DEV_BMP_read_into(path, format, pixels, width, height, NULL);
+}
 
+SB3_DEV_errors_t SB3_DEV_BMP_read_into(const char* path, SB3_DEV_image_t* image)
+{
+    if(!image)
+    {
+        #ifdef SB3_DEV_CRASH_WHEN_ERROR
+            errx(EXIT_FAILURE, "READ_INTO: NULL image or buffer");
+        #else
+            SB3_DEV_SetError(SB3_DEV_NULL_IMAGE_ERROR);
+            return SB3_DEV_NULL_IMAGE_ERROR;
+        #endif
+    }
+    __SB3_DEV_writable(image, 0);
+    return __SB3_DEV_BMP_read_into(path, image->format, image->pixels, image->w, image->h, image);
+}
+
+typedef struct {
+    int fd;
+    off_t offset;
+} __SB3_DEV_pread_t;
+
+// io reading a file from its own offset: bands share the descriptor without seeking
+long __SB3_DEV_pread(void* handle, void* data, size_t size)
+{
+    __SB3_DEV_pread_t* source = handle;
+    ssize_t n;
+    do
+        n = pread(source->fd, data, size, source->offset);
+    while(n < 0 && errno == EINTR);
+    if(n > 0)
+        source->offset += n;
+    return n;
+}
+
+typedef struct {
+    int fd;
+    SB3_DEV_image_format_t format;
+    const SB3_DEV_BMP_info_t* info;
+    const uint8_t* color_table;
+    uint8_t* pixels;
+    off_t pixel_array;
+    size_t row_size;
+    int band;
+    atomic_int error;
+} __SB3_DEV_parallel_read_t;
+
+void __SB3_DEV_parallel_read_band(void* context, int i)
+{
+    __SB3_DEV_parallel_read_t* read = context;
+    int height = __SB3_DEV_BMP_rows(read->info);
+    int first = i * read->band;
+    int last = first + read->band < height ? first + read->band : height;
+    __SB3_DEV_pread_t source = { .fd = read->fd, .offset = read->pixel_array + (off_t)first * read->row_size };
+    SB3_DEV_io_t io = { .read = __SB3_DEV_pread, .handle = &source };
+    uint8_t buffer[1 << 16];
+    __SB3_DEV_reader_t reader = { .io = &io, .buffer = buffer, .capacity = sizeof(buffer) };
+    SB3_DEV_errors_t error = __SB3_DEV_BMP_decode_rows(&reader, read->format, read->info, read->color_table, read->pixels, first, last);
+    if(error != SB3_DEV_SUCCESS_EXIT)
+        atomic_store(&read->error, error);
+}
+
+SB3_DEV_image_t* SB3_DEV_BMP_read_image_parallel(const char* path, SB3_DEV_image_format_t format, int threads)
+{
+    if(!path)
+    {
+        #ifdef SB3_DEV_CRASH_WHEN_ERROR
+            errx(EXIT_FAILURE, "READ_IMAGE_PARALLEL: NULL path error");
+        #else
+            SB3_DEV_SetError(SB3_DEV_NULL_PATH_ERROR);
+            return NULL;
+        #endif
+    }
+    if(!__SB3_DEV_BMP_extension(path))
+    {
+        #ifdef SB3_DEV_CRASH_WHEN_ERROR
+            errx(EXIT_FAILURE, "READ_IMAGE_PARALLEL: Bad file extension (%s) (expected '.BMP' extension (with lower or upper cases))", path);
+        #else
+            SB3_DEV_SetError(SB3_DEV_BAD_EXTENSION_ERROR);
+            return NULL;
+        #endif
+    }
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if(fd < 0)
+    {
+        #ifdef SB3_DEV_CRASH_WHEN_ERROR
+            errx(EXIT_FAILURE, "READ_IMAGE_PARALLEL: Cannot open file at '%s'", path);
+        #else
+            SB3_DEV_SetError(SB3_DEV_CANNOT_OPEN_FILE_ERROR);
+            return NULL;
+        #endif
+    }
+    // headers read sequentially, the pixel array is then addressed by offset
+    uint8_t buffer[1 << 12];
+    __SB3_DEV_reader_t reader = { .fd = fd, .buffer = buffer, .capacity = sizeof(buffer) };
+    SB3_DEV_BMP_info_t info;
+    uint8_t color_table[__SB3_DEV_BMP_COLOR_TABLE_SIZE];
+    if(__SB3_DEV_BMP_decode_header(&reader, format, &info, color_table) != SB3_DEV_SUCCESS_EXIT)
+    {
+        close(fd);
+        return NULL;
+    }
+    uint64_t pixel_array = __SB3_DEV_BMP_headers_end(&info);
+    if(info.pixel_array_offset > pixel_array)
+        pixel_array = info.pixel_array_offset;
+
+    SB3_DEV_image_t* image = SB3_DEV_NewImage(info.width, __SB3_DEV_BMP_rows(&info), format);
+    if(format == SB3_DEV_INDEXED_FORMAT)
+        __SB3_DEV_BMP_palette(image, &info, color_table);
+    __SB3_DEV_parallel_read_t read = {
+        .fd = fd,
+        .format = format,
+        .info = &info,
+        .color_table = color_table,
+        .pixels = image->pixels,
+        .pixel_array = pixel_array,
+        .row_size = ((size_t)info.width * info.bits_per_pixels + 7) / 8 + __SB3_DEV_BMP_padding(info.width, info.bits_per_pixels),
+        .band = 64,
+    };
+    atomic_init(&read.error, SB3_DEV_SUCCESS_EXIT);
+    __SB3_DEV_parallel_for((image->h + read.band - 1) / read.band, threads, __SB3_DEV_parallel_read_band, &read);
+    close(fd);
+
+    SB3_DEV_errors_t error = atomic_load(&read.error);
+    SB3_DEV_SetError(error);
+    if(error != SB3_DEV_SUCCESS_EXIT)
+    {
+        SB3_DEV_FreeImage(image);
+        return NULL;
+    }
+    return image;
+}
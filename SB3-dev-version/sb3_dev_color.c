@@ -0,0 +1,251 @@
+/*
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 AyAztuB
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ *
+ * AUTHOR
+ *
+ * AyAztuB (ayaztub@gmail.com) from https://github.com/AyAztuB/SB3-Project
+ *
+ */
+
+
+
+#include "sb3_dev_internal.h"
+#include <err.h>
+#include <math.h>
+
+#ifdef __x86_64__
+#include <immintrin.h>
+#define __SB3_DEV_SSSE3 __attribute__((target("ssse3")))
+
+static inline int __SB3_DEV_ssse3(void)
+{
+    return __builtin_cpu_supports("ssse3");
+}
+
+// 5 pixels per 16 bytes, the 16th byte is left as it is (in place safe)
+__SB3_DEV_SSSE3 static int __SB3_DEV_swap_rb_ssse3(const uint8_t* src, uint8_t* dst, int count)
+{
+    const __m128i swap = _mm_setr_epi8(2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, 14, 13, 12, 15);
+    int i = 0;
+    for(; i + 6 <= count; i += 5)
+        _mm_storeu_si128((__m128i*)(dst + 3 * i), _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(src + 3 * i)), swap));
+    return i;
+}
+
+// 16 pixels per iteration: r, g, b gathered in 16 bits lanes then weighted
+__SB3_DEV_SSSE3 static int __SB3_DEV_rgb_to_gray_ssse3(const uint8_t* rgb, uint8_t* gray, int count)
+{
+    const __m128i r00 = _mm_setr_epi8(0, -128, 3, -128, 6, -128, 9, -128, 12, -128, 15, -128, -128, -128, -128, -128);
+    const __m128i r01 = _mm_setr_epi8(-128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, 2, -128, 5, -128);
+    const __m128i g00 = _mm_setr_epi8(1, -128, 4, -128, 7, -128, 10, -128, 13, -128, -128, -128, -128, -128, -128, -128);
+    const __m128i g01 = _mm_setr_epi8(-128, -128, -128, -128, -128, -128, -128, -128, -128, -128, 0, -128, 3, -128, 6, -128);
+    const __m128i b00 = _mm_setr_epi8(2, -128, 5, -128, 8, -128, 11, -128, 14, -128, -128, -128, -128, -128, -128, -128);
+    const __m128i b01 = _mm_setr_epi8(-128, -128, -128, -128, -128, -128, -128, -128, -128, -128, 1, -128, 4, -128, 7, -128);
+    const __m128i r11 = _mm_setr_epi8(8, -128, 11, -128, 14, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128);
+    const __m128i r12 = _mm_setr_epi8(-128, -128, -128, -128, -128, -128, 1, -128, 4, -128, 7, -128, 10, -128, 13, -128);
+    const __m128i g11 = _mm_setr_epi8(9, -128, 12, -128, 15, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128);
+    const __m128i g12 = _mm_setr_epi8(-128, -128, -128, -128, -128, -128, 2, -128, 5, -128, 8, -128, 11, -128, 14, -128);
+    const __m128i b11 = _mm_setr_epi8(10, -128, 13, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128);
+    const __m128i b12 = _mm_setr_epi8(-128, -128, -128, -128, 0, -128, 3, -128, 6, -128, 9, -128, 12, -128, 15, -128);
+    const __m128i wr = _mm_set1_epi16(__SB3_DEV_LUMA_R), wg = _mm_set1_epi16(__SB3_DEV_LUMA_G), wb = _mm_set1_epi16(__SB3_DEV_LUMA_B);
+    int i = 0;
+    for(; i + 16 <= count; i += 16)
+    {
+        __m128i a0 = _mm_loadu_si128((const __m128i*)(rgb + 3 * i));
+        __m128i a1 = _mm_loadu_si128((const __m128i*)(rgb + 3 * i + 16));
+        __m128i a2 = _mm_loadu_si128((const __m128i*)(rgb + 3 * i + 32));
+        // max 255 * 256: no overflow in unsigned 16 bits
+        __m128i lo = _mm_add_epi16(_mm_add_epi16(
+            _mm_mullo_epi16(_mm_or_si128(_mm_shuffle_epi8(a0, r00), _mm_shuffle_epi8(a1, r01)), wr),
+            _mm_mullo_epi16(_mm_or_si128(_mm_shuffle_epi8(a0, g00), _mm_shuffle_epi8(a1, g01)), wg)),
+            _mm_mullo_epi16(_mm_or_si128(_mm_shuffle_epi8(a0, b00), _mm_shuffle_epi8(a1, b01)), wb));
+        __m128i hi = _mm_add_epi16(_mm_add_epi16(
+            _mm_mullo_epi16(_mm_or_si128(_mm_shuffle_epi8(a1, r11), _mm_shuffle_epi8(a2, r12)), wr),
+            _mm_mullo_epi16(_mm_or_si128(_mm_shuffle_epi8(a1, g11), _mm_shuffle_epi8(a2, g12)), wg)),
+            _mm_mullo_epi16(_mm_or_si128(_mm_shuffle_epi8(a1, b11), _mm_shuffle_epi8(a2, b12)), wb));
+        _mm_storeu_si128((__m128i*)(gray + i), _mm_packus_epi16(_mm_srli_epi16(lo, 8), _mm_srli_epi16(hi, 8)));
+    }
+    return i;
+}
+
+__SB3_DEV_SSSE3 static int __SB3_DEV_gray_to_rgb_ssse3(const uint8_t* gray, uint8_t* rgb, int count)
+{
+    const __m128i m0 = _mm_setr_epi8(0, 0, 0, 1, 1, 1, 2, 2, 2, 3, 3, 3, 4, 4, 4, 5);
+    const __m128i m1 = _mm_setr_epi8(5, 5, 6, 6, 6, 7, 7, 7, 8, 8, 8, 9, 9, 9, 10, 10);
+    const __m128i m2 = _mm_setr_epi8(10, 11, 11, 11, 12, 12, 12, 13, 13, 13, 14, 14, 14, 15, 15, 15);
+    int i = 0;
+    for(; i + 16 <= count; i += 16)
+    {
+        __m128i g = _mm_loadu_si128((const __m128i*)(gray + i));
+        _mm_storeu_si128((__m128i*)(rgb + 3 * i), _mm_shuffle_epi8(g, m0));
+        _mm_storeu_si128((__m128i*)(rgb + 3 * i + 16), _mm_shuffle_epi8(g, m1));
+        _mm_storeu_si128((__m128i*)(rgb + 3 * i + 32), _mm_shuffle_epi8(g, m2));
+    }
+    return i;
+}
+#endif
+
+void __SB3_DEV_swap_rb(const uint8_t* src, uint8_t* dst, int count)
+{
+    int i = 0;
+#ifdef __x86_64__
+    if(__SB3_DEV_ssse3())
+        i = __SB3_DEV_swap_rb_ssse3(src, dst, count);
+#endif
+    for(; i < count; i++)
+    {
+        uint8_t a = src[3 * i];
+        dst[3 * i + 1] = src[3 * i + 1];
+        dst[3 * i] = src[3 * i + 2];
+        dst[3 * i + 2] = a;
+    }
+}
+
+void __SB3_DEV_rgb_to_gray(const uint8_t* rgb, uint8_t* gray, int count, const uint8_t* lut)
+{
+    int i = 0;
+#ifdef __x86_64__
+    if(__SB3_DEV_ssse3())
+        i = __SB3_DEV_rgb_to_gray_ssse3(rgb, gray, count);
+#endif
+    for(; i < count; i++)
+        gray[i] = __SB3_DEV_luma(rgb[3 * i], rgb[3 * i + 1], rgb[3 * i + 2]);
+    if(lut)
+        for(i = 0; i < count; i++)
+            gray[i] = lut[gray[i]];
+}
+
+void __SB3_DEV_gray_to_rgb(const uint8_t* gray, uint8_t* rgb, int count)
+{
+    int i = 0;
+#ifdef __x86_64__
+    if(__SB3_DEV_ssse3())
+        i = __SB3_DEV_gray_to_rgb_ssse3(gray, rgb, count);
+#endif
+    for(; i < count; i++)
+        rgb[3 * i] = rgb[3 * i + 1] = rgb[3 * i + 2] = gray[i];
+}
+
+uint8_t __SB3_DEV_grayscale_boost(uint8_t color, double num)
+{
+    if(color <= 255/2)
+        return (uint8_t) ((255./2.) * pow((double)2*color/255, num));
+    return 255 - __SB3_DEV_grayscale_boost(255 - color, num);
+}
+
+const uint8_t* __SB3_DEV_boost_lut(double boost, uint8_t* lut)
+{
+    if(!boost)
+        return NULL;
+    for(int v = 0; v < 256; v++)
+        lut[v] = __SB3_DEV_grayscale_boost(v, boost);
+    return lut;
+}
+
+void SB3_DEV_expand_row(SB3_DEV_image_t* image, int y, uint8_t* rgb)
+{
+    const uint8_t* row = __SB3_DEV_row(image, y);
+    if(image->format == SB3_DEV_RGB_FORMAT)
+        memcpy(rgb, row, (size_t)image->w * 3);
+    else if(image->format != SB3_DEV_INDEXED_FORMAT)
+        __SB3_DEV_gray_to_rgb(row, rgb, image->w);
+    else
+        for(int x = 0; x < image->w; x++, rgb += 3)
+        {
+            SB3_DEV_RGBColor_t color = image->palette[row[x]];
+            rgb[0] = color.r;
+            rgb[1] = color.g;
+            rgb[2] = color.b;
+        }
+}
+
+SB3_DEV_errors_t __SB3_DEV_expand_check(SB3_DEV_image_t* image, SB3_DEV_image_format_t format)
+{
+    if(!image)
+    {
+        #ifdef SB3_DEV_CRASH_WHEN_ERROR
+            errx(EXIT_FAILURE, "EXPAND: NULL image");
+        #else
+            SB3_DEV_SetError(SB3_DEV_NULL_IMAGE_ERROR);
+            return SB3_DEV_NULL_IMAGE_ERROR;
+        #endif
+    }
+    if(image->format != SB3_DEV_INDEXED_FORMAT || (format != SB3_DEV_RGB_FORMAT && format != SB3_DEV_MONO_COLOR_FORMAT))
+    {
+        #ifdef SB3_DEV_CRASH_WHEN_ERROR
+            errx(EXIT_FAILURE, "EXPAND: invalid format (expected indexed image expanded to rgb or mono)");
+        #else
+            SB3_DEV_SetError(SB3_DEV_BAD_FORMAT_ERROR);
+            return SB3_DEV_BAD_FORMAT_ERROR;
+        #endif
+    }
+    return SB3_DEV_SUCCESS_EXIT;
+}
+
+void __SB3_DEV_expand(SB3_DEV_image_t* image, SB3_DEV_image_format_t format, uint8_t* pixels)
+{
+    if(format == SB3_DEV_RGB_FORMAT)
+    {
+        for(int y = 0; y < image->h; y++)
+            SB3_DEV_expand_row(image, y, pixels + (size_t)y * image->w * 3);
+    }
+    else
+    {
+        uint8_t lut[256];
+        for(int i = 0; i < 256; i++)
+            lut[i] = __SB3_DEV_luma(image->palette[i].r, image->palette[i].g, image->palette[i].b);
+        for(int y = 0; y < image->h; y++)
+        {
+            const uint8_t* indexes = __SB3_DEV_row(image, y);
+            uint8_t* out = pixels + (size_t)y * image->w;
+            for(int x = 0; x < image->w; x++)
+                out[x] = lut[indexes[x]];
+        }
+    }
+    SB3_DEV_SetError(SB3_DEV_SUCCESS_EXIT);
+}
+
+SB3_DEV_image_t* SB3_DEV_expand(SB3_DEV_image_t* image, SB3_DEV_image_format_t format)
+{
+    if(__SB3_DEV_expand_check(image, format) != SB3_DEV_SUCCESS_EXIT)
+        return NULL;
+    SB3_DEV_image_t* res = SB3_DEV_NewImage(image->w, image->h, format);
+    __SB3_DEV_expand(image, format, res->pixels);
+    return res;
+}
+
+SB3_DEV_errors_t SB3_DEV_apply_expand(SB3_DEV_image_t* image, SB3_DEV_image_format_t format)
+{
+    SB3_DEV_errors_t error = __SB3_DEV_expand_check(image, format);
+    if(error != SB3_DEV_SUCCESS_EXIT)
+        return error;
+    uint8_t* pixels = __SB3_DEV_pixels_alloc((size_t)image->w * image->h * __SB3_DEV_pixel_size(format), 0);
+    __SB3_DEV_expand(image, format, pixels);
+    __SB3_DEV_set_pixels(image, format, pixels);
+    __SB3_DEV_free(image->palette);
+    image->palette = NULL;
+    image->palette_size = 0;
+    return SB3_DEV_SUCCESS_EXIT;
+}
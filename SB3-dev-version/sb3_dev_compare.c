@@ -0,0 +1,304 @@
+/*
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 AyAztuB
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ *
+ * AUTHOR
+ *
+ * AyAztuB (ayaztub@gmail.com) from https://github.com/AyAztuB/SB3-Project
+ *
+ */
+
+
+
+#include "sb3_dev_internal.h"
+#include <err.h>
+#include <math.h>
+#include <stdlib.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/* ROW KERNELS */
+
+// |a - b| for count values
+void __SB3_DEV_absolute_difference(const uint8_t* a, const uint8_t* b, uint8_t* out, size_t count)
+{
+    size_t i = 0;
+#ifdef __SSE2__
+    for(; i + 16 <= count; i += 16)
+    {
+        __m128i va = _mm_loadu_si128((const __m128i*)(a + i)), vb = _mm_loadu_si128((const __m128i*)(b + i));
+        _mm_storeu_si128((__m128i*)(out + i), _mm_or_si128(_mm_subs_epu8(va, vb), _mm_subs_epu8(vb, va)));
+    }
+#endif
+    for(; i < count; i++)
+        out[i] = a[i] > b[i] ? a[i] - b[i] : b[i] - a[i];
+}
+
+// sum of (a - b)^2 over count values
+uint64_t __SB3_DEV_squared_difference(const uint8_t* a, const uint8_t* b, size_t count)
+{
+    uint64_t res = 0;
+    size_t i = 0;
+#ifdef __SSE2__
+    const __m128i zero = _mm_setzero_si128();
+    while(i + 16 <= count)
+    {
+        // 32 bits lanes grow by at most 4 * 255^2 per 16 values: flushed every 4096 iterations
+        __m128i acc = _mm_setzero_si128();
+        for(int k = 0; k < 4096 && i + 16 <= count; k++, i += 16)
+        {
+            __m128i va = _mm_loadu_si128((const __m128i*)(a + i)), vb = _mm_loadu_si128((const __m128i*)(b + i));
+            __m128i d = _mm_or_si128(_mm_subs_epu8(va, vb), _mm_subs_epu8(vb, va));
+            __m128i lo = _mm_unpacklo_epi8(d, zero), hi = _mm_unpackhi_epi8(d, zero);
+            acc = _mm_add_epi32(acc, _mm_add_epi32(_mm_madd_epi16(lo, lo), _mm_madd_epi16(hi, hi)));
+        }
+        uint32_t lanes[4];
+        _mm_storeu_si128((__m128i*)lanes, acc);
+        res += (uint64_t)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    }
+#endif
+    for(; i < count; i++)
+        res += (a[i] - b[i]) * (a[i] - b[i]);
+    return res;
+}
+
+/* CHECKS */
+
+// both images given, same dimensions and format (caller names the api function in the errors)
+char __SB3_DEV_compare_check(SB3_DEV_image_t* a, SB3_DEV_image_t* b, const char* caller)
+{
+    if(!a || !b)
+    {
+        #ifdef SB3_DEV_CRASH_WHEN_ERROR
+            errx(EXIT_FAILURE, "%s: NULL image cannot be compared", caller);
+        #else
+            (void)caller;
+            SB3_DEV_SetError(SB3_DEV_NULL_IMAGE_ERROR);
+            return 0;
+        #endif
+    }
+    if(a->w != b->w || a->h != b->h || a->format != b->format)
+    {
+        #ifdef SB3_DEV_CRASH_WHEN_ERROR
+            errx(EXIT_FAILURE, "%s: images of different dimensions or formats cannot be compared", caller);
+        #else
+            SB3_DEV_SetError(SB3_DEV_IMAGES_MISMATCH_ERROR);
+            return 0;
+        #endif
+    }
+    return 1;
+}
+
+/* BANDS */
+
+// every metric runs over bands of rows, one result per band summed in order (same result whatever the workers)
+typedef struct {
+    SB3_DEV_image_t* a;
+    SB3_DEV_image_t* b;
+    uint8_t* difference; // contiguous output of SB3_DEV_difference
+    atomic_char differ; // equality: set by the first band that finds a difference
+    uint64_t* squares; // per band
+    int band;
+} __SB3_DEV_compare_t;
+
+static inline int __SB3_DEV_band_end(__SB3_DEV_compare_t* compare, int i)
+{
+    return (i + 1) * compare->band < compare->a->h ? (i + 1) * compare->band : compare->a->h;
+}
+
+void __SB3_DEV_equal_band(void* context, int i)
+{
+    __SB3_DEV_compare_t* compare = context;
+    size_t row_size = (size_t)compare->a->w * __SB3_DEV_pixel_size(compare->a->format);
+    for(int y = i * compare->band; y < __SB3_DEV_band_end(compare, i); y++)
+    {
+        if(atomic_load_explicit(&compare->differ, memory_order_relaxed))
+            return;
+        // memcmp is already vectorized
+        if(memcmp(__SB3_DEV_row(compare->a, y), __SB3_DEV_row(compare->b, y), row_size))
+            atomic_store_explicit(&compare->differ, 1, memory_order_relaxed);
+    }
+}
+
+void __SB3_DEV_difference_band(void* context, int i)
+{
+    __SB3_DEV_compare_t* compare = context;
+    size_t row_size = (size_t)compare->a->w * __SB3_DEV_pixel_size(compare->a->format);
+    for(int y = i * compare->band; y < __SB3_DEV_band_end(compare, i); y++)
+        __SB3_DEV_absolute_difference(__SB3_DEV_row(compare->a, y), __SB3_DEV_row(compare->b, y),
+            compare->difference + y * row_size, row_size);
+}
+
+void __SB3_DEV_squares_band(void* context, int i)
+{
+    __SB3_DEV_compare_t* compare = context;
+    size_t row_size = (size_t)compare->a->w * __SB3_DEV_pixel_size(compare->a->format);
+    compare->squares[i] = 0;
+    for(int y = i * compare->band; y < __SB3_DEV_band_end(compare, i); y++)
+        compare->squares[i] += __SB3_DEV_squared_difference(__SB3_DEV_row(compare->a, y), __SB3_DEV_row(compare->b, y), row_size);
+}
+
+static inline int __SB3_DEV_bands(__SB3_DEV_compare_t* compare)
+{
+    return (compare->a->h + compare->band - 1) / compare->band;
+}
+
+/* METRICS */
+
+char SB3_DEV_equal(SB3_DEV_image_t* a, SB3_DEV_image_t* b)
+{
+    if(!a || !b)
+    {
+        #ifdef SB3_DEV_CRASH_WHEN_ERROR
+            errx(EXIT_FAILURE, "EQUAL: NULL image cannot be compared");
+        #else
+            SB3_DEV_SetError(SB3_DEV_NULL_IMAGE_ERROR);
+            return 0;
+        #endif
+    }
+    SB3_DEV_SetError(SB3_DEV_SUCCESS_EXIT);
+    if(a->w != b->w || a->h != b->h || a->format != b->format || a->palette_size != b->palette_size)
+        return 0;
+    if(a->palette && memcmp(a->palette, b->palette, a->palette_size * sizeof(SB3_DEV_RGBColor_t)))
+        return 0;
+    if(a->buffer == b->buffer && a->pixels == b->pixels && a->stride == b->stride)
+        return 1;
+    __SB3_DEV_compare_t compare = { .a = a, .b = b, .band = 64 };
+    atomic_init(&compare.differ, 0);
+    __SB3_DEV_parallel_for(__SB3_DEV_bands(&compare), 0, __SB3_DEV_equal_band, &compare);
+    return !atomic_load(&compare.differ);
+}
+
+SB3_DEV_image_t* SB3_DEV_difference(SB3_DEV_image_t* a, SB3_DEV_image_t* b)
+{
+    if(!__SB3_DEV_compare_check(a, b, "DIFFERENCE"))
+        return NULL;
+    SB3_DEV_image_t* res = SB3_DEV_NewImage(a->w, a->h, a->format);
+    __SB3_DEV_compare_t compare = { .a = a, .b = b, .difference = res->pixels, .band = 64 };
+    __SB3_DEV_parallel_for(__SB3_DEV_bands(&compare), 0, __SB3_DEV_difference_band, &compare);
+    SB3_DEV_SetError(SB3_DEV_SUCCESS_EXIT);
+    return res;
+}
+
+double __SB3_DEV_mse(SB3_DEV_image_t* a, SB3_DEV_image_t* b)
+{
+    __SB3_DEV_compare_t compare = { .a = a, .b = b, .band = 64 };
+    int bands = __SB3_DEV_bands(&compare);
+    compare.squares = __SB3_DEV_malloc(bands * sizeof(uint64_t));
+    __SB3_DEV_parallel_for(bands, 0, __SB3_DEV_squares_band, &compare);
+    uint64_t sum = 0;
+    for(int i = 0; i < bands; i++)
+        sum += compare.squares[i];
+    __SB3_DEV_free(compare.squares);
+    size_t count = (size_t)a->w * a->h * __SB3_DEV_pixel_size(a->format);
+    SB3_DEV_SetError(SB3_DEV_SUCCESS_EXIT);
+    return count ? (double)sum / count : 0;
+}
+
+double SB3_DEV_mse(SB3_DEV_image_t* a, SB3_DEV_image_t* b)
+{
+    if(!__SB3_DEV_compare_check(a, b, "MSE"))
+        return NAN;
+    return __SB3_DEV_mse(a, b);
+}
+
+double SB3_DEV_psnr(SB3_DEV_image_t* a, SB3_DEV_image_t* b)
+{
+    if(!__SB3_DEV_compare_check(a, b, "PSNR"))
+        return NAN;
+    double mse = __SB3_DEV_mse(a, b);
+    return mse ? 10 * log10(255. * 255. / mse) : INFINITY;
+}
+
+/* SSIM */
+
+// constants of Wang et al. (2004) for 8 bits values
+#define __SB3_DEV_SSIM_C1 (0.01 * 255 * 0.01 * 255)
+#define __SB3_DEV_SSIM_C2 (0.03 * 255 * 0.03 * 255)
+
+typedef struct {
+    int w, h, radius;
+    __SB3_DEV_integral_t* a;
+    __SB3_DEV_integral_t* b;
+    uint64_t* products;
+    double* sums; // per band
+    int band;
+} __SB3_DEV_ssim_t;
+
+// windows [x0, x1[ * [y0, y1[ clamped in the image, as the adaptive thresholds
+void __SB3_DEV_ssim_band(void* context, int i)
+{
+    __SB3_DEV_ssim_t* ssim = context;
+    int stride = ssim->w + 1, r = ssim->radius;
+    int end = (i + 1) * ssim->band < ssim->h ? (i + 1) * ssim->band : ssim->h;
+    double sum = 0;
+    for(int y = i * ssim->band; y < end; y++)
+    {
+        int y0 = y - r < 0 ? 0 : y - r;
+        int y1 = y + r + 1 > ssim->h ? ssim->h : y + r + 1;
+        for(int x = 0; x < ssim->w; x++)
+        {
+            int x0 = x - r < 0 ? 0 : x - r;
+            int x1 = x + r + 1 > ssim->w ? ssim->w : x + r + 1;
+            double area = (double)(x1 - x0) * (y1 - y0);
+            double mean_a = __SB3_DEV_integral_sum(ssim->a, x0, y0, x1, y1) / area;
+            double mean_b = __SB3_DEV_integral_sum(ssim->b, x0, y0, x1, y1) / area;
+            double variance_a = __SB3_DEV_WINDOW(ssim->a->squares, stride, x0, y0, x1, y1) / area - mean_a * mean_a;
+            double variance_b = __SB3_DEV_WINDOW(ssim->b->squares, stride, x0, y0, x1, y1) / area - mean_b * mean_b;
+            double covariance = __SB3_DEV_WINDOW(ssim->products, stride, x0, y0, x1, y1) / area - mean_a * mean_b;
+            sum += (2 * mean_a * mean_b + __SB3_DEV_SSIM_C1) * (2 * covariance + __SB3_DEV_SSIM_C2)
+                / ((mean_a * mean_a + mean_b * mean_b + __SB3_DEV_SSIM_C1) * (variance_a + variance_b + __SB3_DEV_SSIM_C2));
+        }
+    }
+    ssim->sums[i] = sum;
+}
+
+double SB3_DEV_ssim(SB3_DEV_image_t* a, SB3_DEV_image_t* b, unsigned int radius)
+{
+    if(!__SB3_DEV_compare_check(a, b, "SSIM"))
+        return NAN;
+    __SB3_DEV_ssim_t ssim = {
+        .w = a->w,
+        .h = a->h,
+        .radius = radius ? radius : 3,
+        .a = __SB3_DEV_integral(a, 1),
+        .b = __SB3_DEV_integral(b, 1),
+        .products = __SB3_DEV_integral_products(a, b),
+        .band = 64,
+    };
+    int bands = (a->h + ssim.band - 1) / ssim.band;
+    ssim.sums = __SB3_DEV_malloc(bands * sizeof(double));
+    __SB3_DEV_parallel_for(bands, 0, __SB3_DEV_ssim_band, &ssim);
+    double sum = 0;
+    for(int i = 0; i < bands; i++)
+        sum += ssim.sums[i];
+    __SB3_DEV_free(ssim.sums);
+    __SB3_DEV_free(ssim.products);
+    __SB3_DEV_FreeIntegral(ssim.a);
+    __SB3_DEV_FreeIntegral(ssim.b);
+    SB3_DEV_SetError(SB3_DEV_SUCCESS_EXIT);
+    return a->w && a->h ? sum / ((size_t)a->w * a->h) : 1;
+}
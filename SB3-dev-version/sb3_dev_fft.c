@@ -0,0 +1,230 @@
+/*
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 AyAztuB
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ *
+ * AUTHOR
+ *
+ * AyAztuB (ayaztub@gmail.com) from https://github.com/AyAztuB/SB3-Project
+ *
+ */
+
+
+
+#include "sb3_dev_internal.h"
+#include <complex.h>
+#include <math.h>
+#include <stdlib.h>
+
+/* FFT */
+
+// radix-2 transforms of size n = 2^log
+typedef struct {
+    int n, log;
+    double complex* twiddles; // exp(-2 i pi k / n), k < n / 2
+    int* reverse; // bit reversed indices
+} __SB3_DEV_fft_t;
+
+void __SB3_DEV_fft_init(__SB3_DEV_fft_t* fft, int log)
+{
+    fft->log = log;
+    fft->n = 1 << log;
+    fft->twiddles = __SB3_DEV_malloc(fft->n / 2 * sizeof(double complex));
+    fft->reverse = __SB3_DEV_malloc(fft->n * sizeof(int));
+    for(int k = 0; k < fft->n / 2; k++)
+        fft->twiddles[k] = cexp(-2 * M_PI * I * k / fft->n);
+    for(int k = 0; k < fft->n; k++)
+    {
+        int r = 0;
+        for(int b = 0; b < log; b++)
+            r |= ((k >> b) & 1) << (log - 1 - b);
+        fft->reverse[k] = r;
+    }
+}
+
+void __SB3_DEV_fft_release(__SB3_DEV_fft_t* fft)
+{
+    __SB3_DEV_free(fft->twiddles);
+    __SB3_DEV_free(fft->reverse);
+}
+
+// in place, unscaled inverse (conjugated twiddles)
+void __SB3_DEV_fft(const __SB3_DEV_fft_t* fft, double complex* data, char inverse)
+{
+    int n = fft->n;
+    for(int k = 0; k < n; k++)
+    {
+        int r = fft->reverse[k];
+        if(k < r)
+        {
+            double complex t = data[k];
+            data[k] = data[r];
+            data[r] = t;
+        }
+    }
+    for(int half = 1, step = n / 2; half < n; half *= 2, step /= 2)
+        for(int k = 0; k < n; k += 2 * half)
+            for(int j = 0; j < half; j++)
+            {
+                double complex w = inverse ? conj(fft->twiddles[j * step]) : fft->twiddles[j * step];
+                double complex t = w * data[k + j + half];
+                data[k + j + half] = data[k + j] - t;
+                data[k + j] += t;
+            }
+}
+
+static void __SB3_DEV_transpose(double complex* data, int n)
+{
+    for(int y = 0; y < n; y++)
+        for(int x = y + 1; x < n; x++)
+        {
+            double complex t = data[(size_t)y * n + x];
+            data[(size_t)y * n + x] = data[(size_t)x * n + y];
+            data[(size_t)x * n + y] = t;
+        }
+}
+
+// n * n transform: rows, transpose, rows
+// the forward spectrum is left transposed, which is what the inverse expects to give back the image in rows order
+void __SB3_DEV_fft2d(const __SB3_DEV_fft_t* fft, double complex* data, char inverse)
+{
+    for(int y = 0; y < fft->n; y++)
+        __SB3_DEV_fft(fft, data + (size_t)y * fft->n, inverse);
+    __SB3_DEV_transpose(data, fft->n);
+    for(int y = 0; y < fft->n; y++)
+        __SB3_DEV_fft(fft, data + (size_t)y * fft->n, inverse);
+}
+
+/* CONVOLUTION */
+
+// overlap-save tiles: the transform of an n * n window of the clamped image gives its block * block
+// (block = n - 2 * radius) outputs exactly, each task writes its own outputs (no overlap-add to merge)
+// two planes (tile, channel) per transform: one real, one imaginary (the kernel is real)
+typedef struct {
+    SB3_DEV_image_t* image;
+    int* res;
+    int ps, radius, block, tiles_x, planes;
+    __SB3_DEV_fft_t fft;
+    const double complex* spectrum; // conjugated kernel transform, scaled by 1 / n^2
+} __SB3_DEV_fft_convolution_t;
+
+// the direct sum is truncated: a value within rounding noise of an integer is that integer
+static inline int __SB3_DEV_fft_value(double v)
+{
+    double r = nearbyint(v);
+    return (int)(fabs(v - r) < 1e-6 ? r : v);
+}
+
+void __SB3_DEV_fft_convolution_tiles(void* context, int i)
+{
+    __SB3_DEV_fft_convolution_t* conv = context;
+    SB3_DEV_image_t* image = conv->image;
+    int n = conv->fft.n, ps = conv->ps;
+    int plane[2] = { 2 * i, 2 * i + 1 < conv->planes ? 2 * i + 1 : -1 };
+    double complex* data = __SB3_DEV_malloc((size_t)n * n * sizeof(double complex));
+    for(int y = 0; y < n; y++)
+        for(int x = 0; x < n; x++)
+            data[(size_t)y * n + x] = 0;
+    for(int k = 0; k < 2 && plane[k] >= 0; k++)
+    {
+        int tile = plane[k] / ps, c = plane[k] % ps;
+        int x0 = tile % conv->tiles_x * conv->block - conv->radius, y0 = tile / conv->tiles_x * conv->block - conv->radius;
+        for(int y = 0; y < n; y++)
+        {
+            int sy = y0 + y < 0 ? 0 : y0 + y >= image->h ? image->h - 1 : y0 + y;
+            const uint8_t* row = __SB3_DEV_row(image, sy) + c;
+            double complex* dst = data + (size_t)y * n;
+            for(int x = 0; x < n; x++)
+            {
+                int sx = x0 + x < 0 ? 0 : x0 + x >= image->w ? image->w - 1 : x0 + x;
+                dst[x] += k ? I * row[sx * ps] : row[sx * ps];
+            }
+        }
+    }
+    __SB3_DEV_fft2d(&conv->fft, data, 0);
+    for(size_t k = 0; k < (size_t)n * n; k++)
+        data[k] *= conv->spectrum[k];
+    __SB3_DEV_fft2d(&conv->fft, data, 1);
+    for(int k = 0; k < 2 && plane[k] >= 0; k++)
+    {
+        int tile = plane[k] / ps, c = plane[k] % ps;
+        int x0 = tile % conv->tiles_x * conv->block, y0 = tile / conv->tiles_x * conv->block;
+        for(int y = 0; y < conv->block && y0 + y < image->h; y++)
+            for(int x = 0; x < conv->block && x0 + x < image->w; x++)
+            {
+                double complex v = data[(size_t)y * n + x];
+                conv->res[((size_t)(y0 + y) * image->w + x0 + x) * ps + c] = __SB3_DEV_fft_value(k ? cimag(v) : creal(v));
+            }
+    }
+    __SB3_DEV_free(data);
+}
+
+void __SB3_DEV_fft_convolution(SB3_DEV_image_t* image, SB3_DEV_kernel_t* kernel, int* res)
+{
+    // same taps as the direct sum: the (2 * radius + 1)^2 top left weights
+    int radius = (kernel->dim - 1) / 2, size = image->w > image->h ? image->w : image->h;
+    // transform size: least work per output, windows up to 512 unless the kernel needs more or the image less
+    int log = 0;
+    double cost = 0;
+    for(int l = 1; l < 30; l++)
+    {
+        int n = 1 << l, block = n - 2 * radius;
+        if(block < 1)
+            continue;
+        if(log && n > 512)
+            break;
+        double c = (double)n * n * l / ((double)block * block);
+        if(!log || c < cost)
+        {
+            log = l;
+            cost = c;
+        }
+        if(block >= size)
+            break;
+    }
+    __SB3_DEV_fft_convolution_t conv = {
+        .image = image,
+        .res = res,
+        .ps = __SB3_DEV_pixel_size(image->format),
+        .radius = radius,
+    };
+    __SB3_DEV_fft_init(&conv.fft, log);
+    int n = conv.fft.n;
+    conv.block = n - 2 * radius;
+    conv.tiles_x = (image->w + conv.block - 1) / conv.block;
+    conv.planes = conv.tiles_x * ((image->h + conv.block - 1) / conv.block) * conv.ps;
+
+    // correlation (the kernel is not flipped): product by the conjugated transform
+    double complex* spectrum = __SB3_DEV_calloc((size_t)n * n, sizeof(double complex));
+    for(int y = 0; y <= 2 * radius; y++)
+        for(int x = 0; x <= 2 * radius; x++)
+            spectrum[(size_t)y * n + x] = kernel->kernel[y * kernel->dim + x];
+    __SB3_DEV_fft2d(&conv.fft, spectrum, 0);
+    for(size_t k = 0; k < (size_t)n * n; k++)
+        spectrum[k] = conj(spectrum[k]) / ((double)n * n);
+    conv.spectrum = spectrum;
+
+    __SB3_DEV_parallel_for((conv.planes + 1) / 2, 0, __SB3_DEV_fft_convolution_tiles, &conv);
+    __SB3_DEV_free(spectrum);
+    __SB3_DEV_fft_release(&conv.fft);
+}
@@ -0,0 +1,473 @@
+/*
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 AyAztuB
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ *
+ * AUTHOR
+ *
+ * AyAztuB (ayaztub@gmail.com) from https://github.com/AyAztuB/SB3-Project
+ *
+ */
+
+
+
+#include "sb3_dev_internal.h"
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+
+/* KERNEL CACHE */
+
+// one entry per (radius, sigma), never changed once published
+// entries live until SB3_DEV_ClearKernelCache: they use plain malloc, not the allocator that may change meanwhile
+typedef struct __SB3_DEV_gaussian_s {
+    unsigned int radius;
+    double sigma;
+    double* weights;
+    int32_t* quantized;
+    _Atomic(SB3_DEV_kernel_t*) kernel; // 2d kernel, built on its first request
+    struct __SB3_DEV_gaussian_s* next;
+} __SB3_DEV_gaussian_t;
+
+// lookups only read the list, insertions are serialized by the lock
+static _Atomic(__SB3_DEV_gaussian_t*) __SB3_DEV_gaussians = NULL;
+static pthread_mutex_t __SB3_DEV_gaussians_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static __SB3_DEV_gaussian_t* __SB3_DEV_gaussian_find(__SB3_DEV_gaussian_t* entry, unsigned int radius, double sigma)
+{
+    for(; entry; entry = entry->next)
+        if(entry->radius == radius && entry->sigma == sigma)
+            return entry;
+    return NULL;
+}
+
+static __SB3_DEV_gaussian_t* __SB3_DEV_gaussian_new(unsigned int radius, double sigma)
+{
+    int size = 2 * radius + 1;
+    __SB3_DEV_gaussian_t* entry = malloc(sizeof(*entry));
+    entry->radius = radius;
+    entry->sigma = sigma;
+    entry->weights = malloc(size * sizeof(double));
+    entry->quantized = malloc(size * sizeof(int32_t));
+    atomic_init(&entry->kernel, NULL);
+
+    double sum = 0;
+    for(int i = 0; i < size; i++)
+    {
+        // sigma 0 (radius 0): identity
+        double a = sigma ? (i - (double)radius) / sigma : i == (int)radius ? 0 : INFINITY;
+        entry->weights[i] = exp(-0.5 * a * a);
+        sum += entry->weights[i];
+    }
+    int32_t total = 0;
+    for(int i = 0; i < size; i++)
+    {
+        entry->weights[i] /= sum;
+        entry->quantized[i] = lround(entry->weights[i] * (1 << SB3_DEV_KERNEL_SHIFT));
+        total += entry->quantized[i];
+    }
+    // the rounding error goes to the center: the fixed point weights sum to exactly 1
+    entry->quantized[radius] += (1 << SB3_DEV_KERNEL_SHIFT) - total;
+    return entry;
+}
+
+__SB3_DEV_gaussian_t* __SB3_DEV_gaussian(unsigned int radius, double sigma)
+{
+    if(sigma <= 0)
+        sigma = radius / 2.;
+    __SB3_DEV_gaussian_t* entry = __SB3_DEV_gaussian_find(atomic_load_explicit(&__SB3_DEV_gaussians, memory_order_acquire), radius, sigma);
+    if(entry)
+        return entry;
+    pthread_mutex_lock(&__SB3_DEV_gaussians_lock);
+    __SB3_DEV_gaussian_t* head = atomic_load_explicit(&__SB3_DEV_gaussians, memory_order_relaxed);
+    entry = __SB3_DEV_gaussian_find(head, radius, sigma);
+    if(!entry)
+    {
+        entry = __SB3_DEV_gaussian_new(radius, sigma);
+        entry->next = head;
+        atomic_store_explicit(&__SB3_DEV_gaussians, entry, memory_order_release);
+    }
+    pthread_mutex_unlock(&__SB3_DEV_gaussians_lock);
+    return entry;
+}
+
+const double* SB3_DEV_cached_gaussian_weights(unsigned int kernel_radius, double sigma)
+{
+    return __SB3_DEV_gaussian(kernel_radius, sigma)->weights;
+}
+
+const int32_t* SB3_DEV_cached_gaussian_quantized(unsigned int kernel_radius, double sigma)
+{
+    return __SB3_DEV_gaussian(kernel_radius, sigma)->quantized;
+}
+
+SB3_DEV_kernel_t* SB3_DEV_cached_gaussian_kernel(unsigned int kernel_radius, double sigma)
+{
+    __SB3_DEV_gaussian_t* entry = __SB3_DEV_gaussian(kernel_radius, sigma);
+    SB3_DEV_kernel_t* kernel = atomic_load_explicit(&entry->kernel, memory_order_acquire);
+    if(kernel)
+        return kernel;
+    pthread_mutex_lock(&__SB3_DEV_gaussians_lock);
+    kernel = atomic_load_explicit(&entry->kernel, memory_order_relaxed);
+    if(!kernel)
+    {
+        // product of the normalized 1d kernel by itself
+        int size = 2 * kernel_radius + 1;
+        kernel = malloc(sizeof(*kernel));
+        kernel->dim = size;
+        kernel->kernel = malloc((size_t)size * size * sizeof(double));
+        for(int row = 0; row < size; row++)
+            for(int col = 0; col < size; col++)
+                kernel->kernel[row * size + col] = entry->weights[row] * entry->weights[col];
+        atomic_store_explicit(&entry->kernel, kernel, memory_order_release);
+    }
+    pthread_mutex_unlock(&__SB3_DEV_gaussians_lock);
+    return kernel;
+}
+
+void SB3_DEV_ClearKernelCache(void)
+{
+    pthread_mutex_lock(&__SB3_DEV_gaussians_lock);
+    __SB3_DEV_gaussian_t* entry = atomic_exchange(&__SB3_DEV_gaussians, NULL);
+    pthread_mutex_unlock(&__SB3_DEV_gaussians_lock);
+    while(entry)
+    {
+        __SB3_DEV_gaussian_t* next = entry->next;
+        SB3_DEV_kernel_t* kernel = atomic_load(&entry->kernel);
+        if(kernel)
+        {
+            free(kernel->kernel);
+            free(kernel);
+        }
+        free(entry->weights);
+        free(entry->quantized);
+        free(entry);
+        entry = next;
+    }
+}
+
+/* SEPARABLE BLUR */
+
+size_t __SB3_DEV_gaussian_work_size(int width, int radius, int pixel_size)
+{
+    return ((size_t)width + 2 * radius + width) * pixel_size;
+}
+
+void __SB3_DEV_gaussian_row(SB3_DEV_image_t* image, const int32_t* weights, int radius, int y, uint32_t* work, uint8_t* out)
+{
+    int ps = __SB3_DEV_pixel_size(image->format);
+    int n = image->w * ps;
+    // vertical pass, 8 fractional bits kept (at most 255 << 8: the horizontal sums fit in 32 bits)
+    uint32_t* column = work + (size_t)radius * ps;
+    memset(column, 0, n * sizeof(uint32_t));
+    for(int k = -radius; k <= radius; k++)
+    {
+        int row = y + k < 0 ? 0 : y + k >= image->h ? image->h - 1 : y + k;
+        const uint8_t* in = __SB3_DEV_row(image, row);
+        uint32_t weight = weights[k + radius];
+        for(int j = 0; j < n; j++)
+            column[j] += weight * in[j];
+    }
+    for(int j = 0; j < n; j++)
+        column[j] = (column[j] + (1 << (SB3_DEV_KERNEL_SHIFT - 9))) >> (SB3_DEV_KERNEL_SHIFT - 8);
+    // replicated borders
+    for(int x = 0; x < radius; x++)
+    {
+        memcpy(work + (size_t)x * ps, column, ps * sizeof(uint32_t));
+        memcpy(column + n + (size_t)x * ps, column + n - ps, ps * sizeof(uint32_t));
+    }
+    // horizontal pass
+    uint32_t* acc = column + n + (size_t)radius * ps;
+    memset(acc, 0, n * sizeof(uint32_t));
+    for(int k = 0; k <= 2 * radius; k++)
+    {
+        const uint32_t* in = work + (size_t)k * ps;
+        uint32_t weight = weights[k];
+        for(int j = 0; j < n; j++)
+            acc[j] += weight * in[j];
+    }
+    for(int j = 0; j < n; j++)
+        out[j] = (acc[j] + (1u << (SB3_DEV_KERNEL_SHIFT + 7))) >> (SB3_DEV_KERNEL_SHIFT + 8);
+}
+
+typedef struct {
+    SB3_DEV_image_t* image;
+    const int32_t* weights;
+    int radius;
+    const int16_t* sharpen; // unsharp mask: change of a value for each difference to its blurred value (+ 255), NULL to blur
+    uint8_t* pixels; // contiguous output
+    int band;
+} __SB3_DEV_gaussian_blur_t;
+
+void __SB3_DEV_gaussian_band(void* context, int i)
+{
+    __SB3_DEV_gaussian_blur_t* blur = context;
+    SB3_DEV_image_t* image = blur->image;
+    size_t row_size = (size_t)image->w * __SB3_DEV_pixel_size(image->format);
+    uint32_t* work = __SB3_DEV_malloc(__SB3_DEV_gaussian_work_size(image->w, blur->radius, __SB3_DEV_pixel_size(image->format)) * sizeof(uint32_t));
+    uint8_t* blurred = blur->sharpen ? __SB3_DEV_malloc(row_size) : NULL;
+    int end = (i + 1) * blur->band < image->h ? (i + 1) * blur->band : image->h;
+    for(int y = i * blur->band; y < end; y++)
+    {
+        uint8_t* out = blur->pixels + y * row_size;
+        if(!blur->sharpen)
+        {
+            __SB3_DEV_gaussian_row(image, blur->weights, blur->radius, y, work, out);
+            continue;
+        }
+        // the blurred row is still in cache when it is subtracted
+        __SB3_DEV_gaussian_row(image, blur->weights, blur->radius, y, work, blurred);
+        const uint8_t* in = __SB3_DEV_row(image, y);
+        for(size_t j = 0; j < row_size; j++)
+        {
+            int v = in[j] + blur->sharpen[in[j] - blurred[j] + 255];
+            out[j] = v < 0 ? 0 : v > 255 ? 255 : v;
+        }
+    }
+    __SB3_DEV_free(blurred);
+    __SB3_DEV_free(work);
+}
+
+void __SB3_DEV_gaussian_blur(SB3_DEV_image_t* image, unsigned int kernel_radius, double sigma, const int16_t* sharpen, uint8_t* pixels)
+{
+    __SB3_DEV_gaussian_blur_t blur = {
+        .image = image,
+        .weights = __SB3_DEV_gaussian(kernel_radius, sigma)->quantized,
+        .radius = kernel_radius,
+        .sharpen = sharpen,
+        .pixels = pixels,
+        .band = 64,
+    };
+    __SB3_DEV_parallel_for((image->h + blur.band - 1) / blur.band, 0, __SB3_DEV_gaussian_band, &blur);
+}
+
+SB3_DEV_image_t* SB3_DEV_gaussian_blur_sigma(SB3_DEV_image_t* image, unsigned int kernel_radius, double sigma)
+{
+    SB3_DEV_image_t* res = SB3_DEV_NewImage(image->w, image->h, image->format);
+    __SB3_DEV_gaussian_blur(image, kernel_radius, sigma, NULL, res->pixels);
+    return res;
+}
+
+void SB3_DEV_apply_gaussian_blur_sigma(SB3_DEV_image_t* image, unsigned int kernel_radius, double sigma)
+{
+    // every source row is read by 2 * radius + 1 output rows: the result goes to new pixels
+    uint8_t* pixels = __SB3_DEV_pixels_alloc((size_t)image->w * image->h * __SB3_DEV_pixel_size(image->format), 0);
+    __SB3_DEV_gaussian_blur(image, kernel_radius, sigma, NULL, pixels);
+    __SB3_DEV_set_pixels(image, image->format, pixels);
+}
+
+SB3_DEV_image_t* SB3_DEV_gaussian_blur(SB3_DEV_image_t* image, unsigned int kernel_radius)
+{
+    return SB3_DEV_gaussian_blur_sigma(image, kernel_radius, 0);
+}
+
+void SB3_DEV_apply_gaussian_blur(SB3_DEV_image_t* image, unsigned int kernel_radius)
+{
+    SB3_DEV_apply_gaussian_blur_sigma(image, kernel_radius, 0);
+}
+
+/* UNSHARP MASK */
+
+// value + amount * (value - blurred) where |value - blurred| > threshold
+void __SB3_DEV_sharpen_lut(double amount, int threshold, int16_t* lut)
+{
+    for(int d = -255; d <= 255; d++)
+    {
+        double change = (d > threshold || -d > threshold) ? amount * d : 0;
+        lut[d + 255] = change < -512 ? -512 : change > 512 ? 512 : lround(change);
+    }
+}
+
+SB3_DEV_image_t* SB3_DEV_unsharp_mask(SB3_DEV_image_t* image, unsigned int kernel_radius, double amount, int threshold)
+{
+    int16_t lut[511];
+    __SB3_DEV_sharpen_lut(amount, threshold, lut);
+    SB3_DEV_image_t* res = SB3_DEV_NewImage(image->w, image->h, image->format);
+    __SB3_DEV_gaussian_blur(image, kernel_radius, 0, lut, res->pixels);
+    return res;
+}
+
+void SB3_DEV_apply_unsharp_mask(SB3_DEV_image_t* image, unsigned int kernel_radius, double amount, int threshold)
+{
+    int16_t lut[511];
+    __SB3_DEV_sharpen_lut(amount, threshold, lut);
+    uint8_t* pixels = __SB3_DEV_pixels_alloc((size_t)image->w * image->h * __SB3_DEV_pixel_size(image->format), 0);
+    __SB3_DEV_gaussian_blur(image, kernel_radius, 0, lut, pixels);
+    __SB3_DEV_set_pixels(image, image->format, pixels);
+}
+
+/* BOX APPROXIMATION */
+
+// successive box filters: their sum of variances is the variance of the gaussian, each pass costs the same
+// whatever its width (running sums), values are kept with 8 fractional bits between the passes
+typedef struct {
+    int w, h, n; // n: values per row (w * pixel size)
+    int ps;
+    int passes;
+    int radius[8];
+    uint64_t scale[8]; // 2^24 / box width
+    uint16_t* planes[2]; // values of the image, then of the vertical passes
+    int band;
+} __SB3_DEV_box_blur_t;
+
+#define __SB3_DEV_BOX_SHIFT 24
+
+// box widths of Kovesi (2010): the passes use the two odd widths around the ideal one
+void __SB3_DEV_box_radii(double sigma, int passes, int* radius)
+{
+    double ideal = sqrt(12 * sigma * sigma / passes + 1);
+    int lower = floor(ideal);
+    if(lower % 2 == 0)
+        lower--;
+    int upper = lower + 2;
+    int lower_count = lround((12 * sigma * sigma - passes * lower * lower - 4 * passes * lower - 3 * passes) / (-4. * lower - 4));
+    for(int i = 0; i < passes; i++)
+        radius[i] = ((i < lower_count ? lower : upper) - 1) / 2;
+}
+
+static inline uint16_t __SB3_DEV_box_value(uint32_t sum, uint64_t scale)
+{
+    return (sum * scale + (1ull << (__SB3_DEV_BOX_SHIFT - 1))) >> __SB3_DEV_BOX_SHIFT;
+}
+
+// horizontal passes of rows [i * band, (i + 1) * band), in place in planes[0]
+void __SB3_DEV_box_rows(void* context, int i)
+{
+    __SB3_DEV_box_blur_t* box = context;
+    int end = (i + 1) * box->band < box->h ? (i + 1) * box->band : box->h;
+    uint16_t* copy = __SB3_DEV_malloc(box->n * sizeof(uint16_t));
+    for(int y = i * box->band; y < end; y++)
+    {
+        uint16_t* row = box->planes[0] + (size_t)y * box->n;
+        for(int p = 0; p < box->passes; p++)
+        {
+            int r = box->radius[p], last = box->w - 1;
+            if(!r)
+                continue;
+            memcpy(copy, row, box->n * sizeof(uint16_t));
+            for(int c = 0; c < box->ps; c++)
+            {
+                const uint16_t* in = copy + c;
+                uint16_t* out = row + c;
+                int ps = box->ps;
+                uint32_t sum = (r + 1) * in[0];
+                for(int k = 1; k <= r; k++)
+                    sum += in[(k < last ? k : last) * ps];
+                for(int x = 0; x < box->w; x++)
+                {
+                    out[x * ps] = __SB3_DEV_box_value(sum, box->scale[p]);
+                    int add = x + r + 1 < last ? x + r + 1 : last, sub = x - r > 0 ? x - r : 0;
+                    sum += in[add * ps] - in[sub * ps];
+                }
+            }
+        }
+    }
+    __SB3_DEV_free(copy);
+}
+
+// vertical passes of the values [i * band, (i + 1) * band) of every row, pass p goes from planes[p % 2] to the other one
+void __SB3_DEV_box_columns(void* context, int i)
+{
+    __SB3_DEV_box_blur_t* box = context;
+    int j0 = i * box->band, j1 = j0 + box->band < box->n ? j0 + box->band : box->n, count = j1 - j0;
+    uint32_t* sums = __SB3_DEV_malloc(count * sizeof(uint32_t));
+    int last = box->h - 1;
+    for(int p = 0; p < box->passes; p++)
+    {
+        int r = box->radius[p];
+        const uint16_t* in = box->planes[p % 2] + j0;
+        uint16_t* out = box->planes[(p + 1) % 2] + j0;
+        for(int j = 0; j < count; j++)
+            sums[j] = (r + 1) * in[j];
+        for(int k = 1; k <= r; k++)
+        {
+            const uint16_t* row = in + (size_t)(k < last ? k : last) * box->n;
+            for(int j = 0; j < count; j++)
+                sums[j] += row[j];
+        }
+        for(int y = 0; y <= last; y++)
+        {
+            uint16_t* dst = out + (size_t)y * box->n;
+            for(int j = 0; j < count; j++)
+                dst[j] = __SB3_DEV_box_value(sums[j], box->scale[p]);
+            const uint16_t* add = in + (size_t)(y + r + 1 < last ? y + r + 1 : last) * box->n;
+            const uint16_t* sub = in + (size_t)(y - r > 0 ? y - r : 0) * box->n;
+            for(int j = 0; j < count; j++)
+                sums[j] += add[j] - sub[j];
+        }
+    }
+    __SB3_DEV_free(sums);
+}
+
+void __SB3_DEV_box_gaussian_blur(SB3_DEV_image_t* image, double sigma, int passes, uint8_t* pixels)
+{
+    if(passes <= 0)
+        passes = 3;
+    if(passes > 8)
+        passes = 8;
+    int ps = __SB3_DEV_pixel_size(image->format);
+    __SB3_DEV_box_blur_t box = {
+        .w = image->w,
+        .h = image->h,
+        .n = image->w * ps,
+        .ps = ps,
+        .passes = passes,
+    };
+    __SB3_DEV_box_radii(sigma > 0 ? sigma : 0, passes, box.radius);
+    for(int p = 0; p < passes; p++)
+        box.scale[p] = ((1ull << __SB3_DEV_BOX_SHIFT) + box.radius[p]) / (2 * box.radius[p] + 1);
+    size_t count = (size_t)box.n * box.h;
+    box.planes[0] = __SB3_DEV_malloc(count * sizeof(uint16_t));
+    box.planes[1] = __SB3_DEV_malloc(count * sizeof(uint16_t));
+    for(int y = 0; y < box.h; y++)
+    {
+        const uint8_t* row = __SB3_DEV_row(image, y);
+        uint16_t* plane = box.planes[0] + (size_t)y * box.n;
+        for(int j = 0; j < box.n; j++)
+            plane[j] = row[j] << 8;
+    }
+    box.band = 64;
+    __SB3_DEV_parallel_for((box.h + box.band - 1) / box.band, 0, __SB3_DEV_box_rows, &box);
+    box.band = 1024;
+    __SB3_DEV_parallel_for((box.n + box.band - 1) / box.band, 0, __SB3_DEV_box_columns, &box);
+    const uint16_t* result = box.planes[passes % 2];
+    for(size_t j = 0; j < count; j++)
+        pixels[j] = (result[j] + 128) >> 8;
+    __SB3_DEV_free(box.planes[0]);
+    __SB3_DEV_free(box.planes[1]);
+}
+
+SB3_DEV_image_t* SB3_DEV_box_gaussian_blur(SB3_DEV_image_t* image, double sigma, int passes)
+{
+    SB3_DEV_image_t* res = SB3_DEV_NewImage(image->w, image->h, image->format);
+    __SB3_DEV_box_gaussian_blur(image, sigma, passes, res->pixels);
+    return res;
+}
+
+void SB3_DEV_apply_box_gaussian_blur(SB3_DEV_image_t* image, double sigma, int passes)
+{
+    uint8_t* pixels = __SB3_DEV_pixels_alloc((size_t)image->w * image->h * __SB3_DEV_pixel_size(image->format), 0);
+    __SB3_DEV_box_gaussian_blur(image, sigma, passes, pixels);
+    __SB3_DEV_set_pixels(image, image->format, pixels);
+}
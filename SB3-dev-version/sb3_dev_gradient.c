@@ -0,0 +1,174 @@
+/*
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 AyAztuB
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ *
+ * AUTHOR
+ *
+ * AyAztuB (ayaztub@gmail.com) from https://github.com/AyAztuB/SB3-Project
+ *
+ */
+
+
+#include "sb3_dev_internal.h"
+#include <err.h>
+#include <math.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// luminance row y (clamped) with one replicated pixel on each side
+void __SB3_DEV_padded_gray_row(SB3_DEV_image_t* image, int y, uint8_t* padded, uint8_t* buffer)
+{
+    if(y < 0) y = 0;
+    else if(y >= image->h) y = image->h - 1;
+    const uint8_t* gray = __SB3_DEV_gray_row(image, y, buffer);
+    memcpy(padded + 1, gray, image->w);
+    padded[0] = gray[0];
+    padded[image->w + 1] = gray[image->w - 1];
+}
+
+// 0, 45, 90 or 135 degrees (tan(22.5) ~ 0.414, tan(67.5) ~ 2.414)
+uint8_t __SB3_DEV_gradient_direction(int gx, int gy)
+{
+    int ax = gx < 0 ? -gx : gx, ay = gy < 0 ? -gy : gy;
+    if(ay * 1000 <= ax * 414)
+        return 0;
+    if(ay * 1000 >= ax * 2414)
+        return 90;
+    return (gx ^ gy) < 0 ? 135 : 45;
+}
+
+// gx, gy and magnitude of row y (bot is row y + 1, the one above as displayed): weights (side, center) are (1, 2) for sobel, (3, 10) for scharr
+void __SB3_DEV_gradient_row(const uint8_t* top, const uint8_t* mid, const uint8_t* bot, int w,
+        int side, int center, float scale, int16_t* gx, int16_t* gy, uint8_t* magnitude)
+{
+    int x = 0;
+#ifdef __SSE2__
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i vside = _mm_set1_epi16(side), vcenter = _mm_set1_epi16(center);
+    const __m128 vscale = _mm_set1_ps(scale);
+    #define __SB3_DEV_LOAD16(p) _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(p)), zero)
+    for(; x + 8 <= w; x += 8)
+    {
+        // padded rows: pixel x is at index x + 1
+        __m128i tl = __SB3_DEV_LOAD16(top + x), tc = __SB3_DEV_LOAD16(top + x + 1), tr = __SB3_DEV_LOAD16(top + x + 2);
+        __m128i ml = __SB3_DEV_LOAD16(mid + x), mr = __SB3_DEV_LOAD16(mid + x + 2);
+        __m128i bl = __SB3_DEV_LOAD16(bot + x), bc = __SB3_DEV_LOAD16(bot + x + 1), br = __SB3_DEV_LOAD16(bot + x + 2);
+
+        __m128i vx = _mm_add_epi16(
+            _mm_mullo_epi16(vside, _mm_add_epi16(_mm_sub_epi16(tr, tl), _mm_sub_epi16(br, bl))),
+            _mm_mullo_epi16(vcenter, _mm_sub_epi16(mr, ml)));
+        __m128i vy = _mm_add_epi16(
+            _mm_mullo_epi16(vside, _mm_add_epi16(_mm_sub_epi16(bl, tl), _mm_sub_epi16(br, tr))),
+            _mm_mullo_epi16(vcenter, _mm_sub_epi16(bc, tc)));
+        _mm_storeu_si128((__m128i*)(gx + x), vx);
+        _mm_storeu_si128((__m128i*)(gy + x), vy);
+
+        // (gx, gy) pairs => gx^2 + gy^2 in 32 bits
+        __m128i lo = _mm_unpacklo_epi16(vx, vy), hi = _mm_unpackhi_epi16(vx, vy);
+        __m128 mlo = _mm_mul_ps(_mm_sqrt_ps(_mm_cvtepi32_ps(_mm_madd_epi16(lo, lo))), vscale);
+        __m128 mhi = _mm_mul_ps(_mm_sqrt_ps(_mm_cvtepi32_ps(_mm_madd_epi16(hi, hi))), vscale);
+        __m128i m16 = _mm_packs_epi32(_mm_cvtps_epi32(mlo), _mm_cvtps_epi32(mhi));
+        _mm_storel_epi64((__m128i*)(magnitude + x), _mm_packus_epi16(m16, m16));
+    }
+    #undef __SB3_DEV_LOAD16
+#endif
+    for(; x < w; x++)
+    {
+        int vx = side * ((top[x + 2] - top[x]) + (bot[x + 2] - bot[x])) + center * (mid[x + 2] - mid[x]);
+        int vy = side * ((bot[x] - top[x]) + (bot[x + 2] - top[x + 2])) + center * (bot[x + 1] - top[x + 1]);
+        gx[x] = vx;
+        gy[x] = vy;
+        float m = nearbyintf(sqrtf((float)(vx * vx + vy * vy)) * scale);
+        magnitude[x] = m > 255 ? 255 : m;
+    }
+}
+
+SB3_DEV_image_t* SB3_DEV_gradient(SB3_DEV_image_t* image, SB3_DEV_gradient_operator_t op,
+        int16_t* gx, int16_t* gy, SB3_DEV_image_t** direction)
+{
+    if(!image)
+    {
+        #ifdef SB3_DEV_CRASH_WHEN_ERROR
+            errx(EXIT_FAILURE, "GRADIENT: NULL image");
+        #else
+            SB3_DEV_SetError(SB3_DEV_NULL_IMAGE_ERROR);
+            return NULL;
+        #endif
+    }
+    if(op != SB3_DEV_SOBEL_OPERATOR && op != SB3_DEV_SCHARR_OPERATOR)
+    {
+        #ifdef SB3_DEV_CRASH_WHEN_ERROR
+            errx(EXIT_FAILURE, "GRADIENT: unknown gradient operator (%d)", op);
+        #else
+            SB3_DEV_SetError(SB3_DEV_BAD_FORMAT_ERROR);
+            return NULL;
+        #endif
+    }
+
+    int side = 1, center = 2;
+    float scale = 1;
+    if(op == SB3_DEV_SCHARR_OPERATOR)
+    { side = 3; center = 10; scale = 0.25; }
+
+    int w = image->w;
+    SB3_DEV_image_t* magnitude = SB3_DEV_NewImage(w, image->h, SB3_DEV_MONO_COLOR_FORMAT);
+    if(direction)
+        *direction = SB3_DEV_NewImage(w, image->h, SB3_DEV_MONO_COLOR_FORMAT);
+
+    // 3 rotating padded luminance rows: the source is read once
+    uint8_t* rows = __SB3_DEV_malloc(3 * (w + 2) + w);
+    uint8_t* buffer = rows + 3 * (w + 2);
+    uint8_t* top = rows, *mid = rows + (w + 2), *bot = rows + 2 * (w + 2);
+    int16_t* scratch = __SB3_DEV_malloc(2 * w * sizeof(int16_t));
+    __SB3_DEV_padded_gray_row(image, -1, top, buffer);
+    __SB3_DEV_padded_gray_row(image, 0, mid, buffer);
+
+    for(int y = 0; y < image->h; y++)
+    {
+        __SB3_DEV_padded_gray_row(image, y + 1, bot, buffer);
+        int16_t* row_gx = gx ? gx + (size_t)y * w : scratch;
+        int16_t* row_gy = gy ? gy + (size_t)y * w : scratch + w;
+        __SB3_DEV_gradient_row(top, mid, bot, w, side, center, scale, row_gx, row_gy,
+            __SB3_DEV_row(magnitude, y));
+        if(direction)
+        {
+            uint8_t* dir = __SB3_DEV_row(*direction, y);
+            for(int x = 0; x < w; x++)
+                dir[x] = __SB3_DEV_gradient_direction(row_gx[x], row_gy[x]);
+        }
+        uint8_t* tmp = top;
+        top = mid; mid = bot; bot = tmp;
+    }
+    __SB3_DEV_free(scratch);
+    __SB3_DEV_free(rows);
+    SB3_DEV_SetError(SB3_DEV_SUCCESS_EXIT);
+    return magnitude;
+}
+
+SB3_DEV_image_t* SB3_DEV_sobel(SB3_DEV_image_t* image)
+{
+    return SB3_DEV_gradient(image, SB3_DEV_SOBEL_OPERATOR, NULL, NULL, NULL);
+}
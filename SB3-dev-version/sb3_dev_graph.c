@@ -0,0 +1,503 @@
+/*
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 AyAztuB
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ *
+ * AUTHOR
+ *
+ * AyAztuB (ayaztub@gmail.com) from https://github.com/AyAztuB/SB3-Project
+ *
+ */
+
+
+#include "sb3_dev_internal.h"
+#include <err.h>
+#include <math.h>
+#include <string.h>
+
+#define __SB3_DEV_TILE_SIZE 64
+#define __SB3_DEV_TILE_BUCKETS 4096
+
+/* NODES */
+
+typedef enum {
+    __SB3_DEV_SOURCE_NODE,
+    __SB3_DEV_CROP_NODE,
+    __SB3_DEV_RESIZE_NODE,
+    __SB3_DEV_CONVOLUTION_NODE,
+    __SB3_DEV_GRAYSCALE_NODE,
+} __SB3_DEV_node_type_t;
+
+struct SB3_DEV_node_s {
+    __SB3_DEV_node_type_t type;
+    int id, w, h;
+    SB3_DEV_image_format_t format;
+    SB3_DEV_graph_t* graph;
+    SB3_DEV_node_t* input;
+    SB3_DEV_image_t* image;      // source
+    int x, y;                    // crop
+    unsigned int dim;            // convolution
+    double* kernel;              // convolution
+    uint8_t lut[256];            // grayscale
+};
+
+/* TILE CACHE */
+
+// tiles of computed nodes, the least recently used unpinned tiles are dropped past the budget
+typedef struct __SB3_DEV_tile_s {
+    int node, tx, ty, pins;
+    size_t size;
+    uint8_t* data;
+    struct __SB3_DEV_tile_s* next_in_bucket;
+    struct __SB3_DEV_tile_s* newer;
+    struct __SB3_DEV_tile_s* older;
+} __SB3_DEV_tile_t;
+
+struct SB3_DEV_graph_s {
+    int count, capacity;
+    SB3_DEV_node_t** nodes;
+    size_t budget, used;
+    __SB3_DEV_tile_t* buckets[__SB3_DEV_TILE_BUCKETS];
+    __SB3_DEV_tile_t* newest;
+    __SB3_DEV_tile_t* oldest;
+};
+
+SB3_DEV_graph_t* SB3_DEV_NewGraph(size_t cache_size)
+{
+    SB3_DEV_graph_t* graph = __SB3_DEV_calloc(1, sizeof(*graph));
+    graph->capacity = 8;
+    graph->nodes = __SB3_DEV_malloc(graph->capacity * sizeof(SB3_DEV_node_t*));
+    graph->budget = cache_size;
+    return graph;
+}
+
+void __SB3_DEV_tile_unlink(SB3_DEV_graph_t* graph, __SB3_DEV_tile_t* tile)
+{
+    if(tile->newer) tile->newer->older = tile->older;
+    else graph->newest = tile->older;
+    if(tile->older) tile->older->newer = tile->newer;
+    else graph->oldest = tile->newer;
+    tile->newer = tile->older = NULL;
+}
+
+void __SB3_DEV_tile_push(SB3_DEV_graph_t* graph, __SB3_DEV_tile_t* tile)
+{
+    tile->older = graph->newest;
+    tile->newer = NULL;
+    if(graph->newest) graph->newest->newer = tile;
+    else graph->oldest = tile;
+    graph->newest = tile;
+}
+
+static inline int __SB3_DEV_tile_hash(int node, int tx, int ty)
+{
+    return ((unsigned int)node * 73856093u ^ (unsigned int)tx * 19349663u ^ (unsigned int)ty * 83492791u) % __SB3_DEV_TILE_BUCKETS;
+}
+
+void __SB3_DEV_tile_evict(SB3_DEV_graph_t* graph)
+{
+    __SB3_DEV_tile_t* tile = graph->oldest;
+    while(tile && graph->used > graph->budget)
+    {
+        __SB3_DEV_tile_t* newer = tile->newer;
+        if(!tile->pins)
+        {
+            __SB3_DEV_tile_t** link = graph->buckets + __SB3_DEV_tile_hash(tile->node, tile->tx, tile->ty);
+            while(*link != tile)
+                link = &(*link)->next_in_bucket;
+            *link = tile->next_in_bucket;
+            __SB3_DEV_tile_unlink(graph, tile);
+            graph->used -= tile->size;
+            __SB3_DEV_free(tile->data);
+            __SB3_DEV_free(tile);
+        }
+        tile = newer;
+    }
+}
+
+void SB3_DEV_FreeGraph(SB3_DEV_graph_t* graph)
+{
+    graph->budget = 0;
+    __SB3_DEV_tile_evict(graph);
+    for(int i = 0; i < graph->count; i++)
+    {
+        __SB3_DEV_free(graph->nodes[i]->kernel);
+        __SB3_DEV_free(graph->nodes[i]);
+    }
+    __SB3_DEV_free(graph->nodes);
+    __SB3_DEV_free(graph);
+}
+
+SB3_DEV_node_t* __SB3_DEV_graph_add(SB3_DEV_graph_t* graph, SB3_DEV_node_t node)
+{
+    if(graph->count == graph->capacity)
+    {
+        graph->capacity *= 2;
+        graph->nodes = __SB3_DEV_realloc(graph->nodes, graph->capacity * sizeof(SB3_DEV_node_t*));
+    }
+    SB3_DEV_node_t* res = __SB3_DEV_malloc(sizeof(*res));
+    *res = node;
+    res->graph = graph;
+    res->id = graph->count;
+    graph->nodes[graph->count++] = res;
+    SB3_DEV_SetError(SB3_DEV_SUCCESS_EXIT);
+    return res;
+}
+
+/* EVALUATION */
+
+void __SB3_DEV_node_tile(SB3_DEV_node_t* node, int x0, int y0, int w, int h, uint8_t* dst);
+
+// tile (tx, ty) of a computed node, computed if it isn't cached (unpin it after use)
+__SB3_DEV_tile_t* __SB3_DEV_tile_get(SB3_DEV_node_t* node, int tx, int ty)
+{
+    SB3_DEV_graph_t* graph = node->graph;
+    __SB3_DEV_tile_t** bucket = graph->buckets + __SB3_DEV_tile_hash(node->id, tx, ty);
+    for(__SB3_DEV_tile_t* tile = *bucket; tile; tile = tile->next_in_bucket)
+        if(tile->node == node->id && tile->tx == tx && tile->ty == ty)
+        {
+            __SB3_DEV_tile_unlink(graph, tile);
+            __SB3_DEV_tile_push(graph, tile);
+            tile->pins++;
+            return tile;
+        }
+
+    int x0 = tx * __SB3_DEV_TILE_SIZE, y0 = ty * __SB3_DEV_TILE_SIZE;
+    int w = node->w - x0 < __SB3_DEV_TILE_SIZE ? node->w - x0 : __SB3_DEV_TILE_SIZE;
+    int h = node->h - y0 < __SB3_DEV_TILE_SIZE ? node->h - y0 : __SB3_DEV_TILE_SIZE;
+    __SB3_DEV_tile_t* tile = __SB3_DEV_calloc(1, sizeof(*tile));
+    tile->node = node->id;
+    tile->tx = tx;
+    tile->ty = ty;
+    tile->pins = 1;
+    tile->size = (size_t)w * h * __SB3_DEV_pixel_size(node->format);
+    tile->data = __SB3_DEV_malloc(tile->size);
+    __SB3_DEV_node_tile(node, x0, y0, w, h, tile->data);
+
+    tile->next_in_bucket = *bucket;
+    *bucket = tile;
+    __SB3_DEV_tile_push(graph, tile);
+    graph->used += tile->size;
+    __SB3_DEV_tile_evict(graph);
+    return tile;
+}
+
+// region [x, x + w[ * [y, y + h[ (inside the node) in out (rows of stride pixels)
+void __SB3_DEV_node_read(SB3_DEV_node_t* node, int x, int y, int w, int h, uint8_t* out, int stride)
+{
+    int ps = __SB3_DEV_pixel_size(node->format), t = __SB3_DEV_TILE_SIZE;
+    switch(node->type)
+    {
+        case __SB3_DEV_SOURCE_NODE:
+            for(int yy = 0; yy < h; yy++)
+                memcpy(out + (size_t)yy * stride * ps, __SB3_DEV_row(node->image, y + yy) + (size_t)x * ps, (size_t)w * ps);
+            break;
+        case __SB3_DEV_CROP_NODE:
+            __SB3_DEV_node_read(node->input, x + node->x, y + node->y, w, h, out, stride);
+            break;
+        default:
+            for(int ty = y / t; ty <= (y + h - 1) / t; ty++)
+                for(int tx = x / t; tx <= (x + w - 1) / t; tx++)
+                {
+                    __SB3_DEV_tile_t* tile = __SB3_DEV_tile_get(node, tx, ty);
+                    int tw = node->w - tx * t < t ? node->w - tx * t : t;
+                    int x0 = tx * t > x ? tx * t : x, x1 = tx * t + tw < x + w ? tx * t + tw : x + w;
+                    int y0 = ty * t > y ? ty * t : y, y1 = (ty + 1) * t < y + h ? (ty + 1) * t : y + h;
+                    for(int yy = y0; yy < y1; yy++)
+                        memcpy(out + ((size_t)(yy - y) * stride + (x0 - x)) * ps,
+                            tile->data + ((size_t)(yy - ty * t) * tw + (x0 - tx * t)) * ps, (size_t)(x1 - x0) * ps);
+                    tile->pins--;
+                }
+            break;
+    }
+}
+
+static inline int __SB3_DEV_clamp(int v, int min, int max)
+{
+    return v < min ? min : v > max ? max : v;
+}
+
+// region [x, x + w[ * [y, y + h[ of node in dst (w * h pixels), borders are replicated outside of the node
+void __SB3_DEV_node_fetch(SB3_DEV_node_t* node, int x, int y, int w, int h, uint8_t* dst)
+{
+    int ps = __SB3_DEV_pixel_size(node->format);
+    // nearest non-empty part of the node
+    int ix0 = __SB3_DEV_clamp(x, 0, node->w - 1), ix1 = __SB3_DEV_clamp(x + w, ix0 + 1, node->w);
+    int iy0 = __SB3_DEV_clamp(y, 0, node->h - 1), iy1 = __SB3_DEV_clamp(y + h, iy0 + 1, node->h);
+    if(ix0 >= x && ix1 <= x + w && iy0 >= y && iy1 <= y + h)
+    {
+        __SB3_DEV_node_read(node, ix0, iy0, ix1 - ix0, iy1 - iy0, dst + ((size_t)(iy0 - y) * w + (ix0 - x)) * ps, w);
+        for(int yy = iy0; yy < iy1; yy++)
+        {
+            uint8_t* row = dst + (size_t)(yy - y) * w * ps;
+            for(int xx = x; xx < ix0; xx++)
+                memcpy(row + (size_t)(xx - x) * ps, row + (size_t)(ix0 - x) * ps, ps);
+            for(int xx = ix1; xx < x + w; xx++)
+                memcpy(row + (size_t)(xx - x) * ps, row + (size_t)(ix1 - 1 - x) * ps, ps);
+        }
+        for(int yy = y; yy < y + h; yy++)
+        {
+            int src = __SB3_DEV_clamp(yy, iy0, iy1 - 1);
+            if(src != yy)
+                memcpy(dst + (size_t)(yy - y) * w * ps, dst + (size_t)(src - y) * w * ps, (size_t)w * ps);
+        }
+        return;
+    }
+    // region fully outside of the node
+    int iw = ix1 - ix0, ih = iy1 - iy0;
+    uint8_t* in = __SB3_DEV_malloc((size_t)iw * ih * ps);
+    __SB3_DEV_node_read(node, ix0, iy0, iw, ih, in, iw);
+    for(int yy = 0; yy < h; yy++)
+        for(int xx = 0; xx < w; xx++)
+            memcpy(dst + ((size_t)yy * w + xx) * ps, in + ((size_t)(__SB3_DEV_clamp(y + yy, iy0, iy1 - 1) - iy0) * iw +
+                (__SB3_DEV_clamp(x + xx, ix0, ix1 - 1) - ix0)) * ps, ps);
+    __SB3_DEV_free(in);
+}
+
+static inline uint8_t __SB3_DEV_saturate(double v)
+{
+    return v <= 0 ? 0 : v >= 255 ? 255 : (uint8_t)v;
+}
+
+// compute the tile [x0, x0 + w[ * [y0, y0 + h[ of a computed node
+void __SB3_DEV_node_tile(SB3_DEV_node_t* node, int x0, int y0, int w, int h, uint8_t* dst)
+{
+    SB3_DEV_node_t* input = node->input;
+    int ps = __SB3_DEV_pixel_size(input->format);
+    switch(node->type)
+    {
+        case __SB3_DEV_GRAYSCALE_NODE:
+        {
+            uint8_t* in = __SB3_DEV_malloc((size_t)w * h * 3);
+            __SB3_DEV_node_fetch(input, x0, y0, w, h, in);
+            __SB3_DEV_rgb_to_gray(in, dst, w * h, node->lut);
+            __SB3_DEV_free(in);
+            break;
+        }
+        case __SB3_DEV_CONVOLUTION_NODE:
+        {
+            int r = (node->dim - 1) / 2, iw = w + 2 * r;
+            uint8_t* in = __SB3_DEV_malloc((size_t)iw * (h + 2 * r) * ps);
+            __SB3_DEV_node_fetch(input, x0 - r, y0 - r, iw, h + 2 * r, in);
+            for(int y = 0; y < h; y++)
+                for(int x = 0; x < w; x++)
+                    for(int c = 0; c < ps; c++)
+                    {
+                        // same taps as __SB3_DEV_convolution
+                        double v = 0;
+                        for(int n = 0; n <= 2 * r; n++)
+                            for(int m = 0; m <= 2 * r; m++)
+                                v += node->kernel[n * node->dim + m] * in[((size_t)(y + n) * iw + x + m) * ps + c];
+                        dst[((size_t)y * w + x) * ps + c] = __SB3_DEV_saturate(v);
+                    }
+            __SB3_DEV_free(in);
+            break;
+        }
+        case __SB3_DEV_RESIZE_NODE:
+        {
+            // bilinear, pixel centers aligned
+            double sx = (double)input->w / node->w, sy = (double)input->h / node->h;
+            int ix0 = (int)floor((x0 + 0.5) * sx - 0.5), iy0 = (int)floor((y0 + 0.5) * sy - 0.5);
+            int ix1 = (int)floor((x0 + w - 0.5) * sx - 0.5) + 1, iy1 = (int)floor((y0 + h - 0.5) * sy - 0.5) + 1;
+            int iw = ix1 - ix0 + 1, ih = iy1 - iy0 + 1;
+            uint8_t* in = __SB3_DEV_malloc((size_t)iw * ih * ps);
+            __SB3_DEV_node_fetch(input, ix0, iy0, iw, ih, in);
+            for(int y = 0; y < h; y++)
+            {
+                double fy = (y0 + y + 0.5) * sy - 0.5;
+                int py = (int)floor(fy);
+                double dy = fy - py;
+                for(int x = 0; x < w; x++)
+                {
+                    double fx = (x0 + x + 0.5) * sx - 0.5;
+                    int px = (int)floor(fx);
+                    double dx = fx - px;
+                    const uint8_t* p00 = in + ((size_t)(py - iy0) * iw + (px - ix0)) * ps;
+                    const uint8_t* p10 = p00 + ps;
+                    const uint8_t* p01 = p00 + (size_t)iw * ps;
+                    const uint8_t* p11 = p01 + ps;
+                    for(int c = 0; c < ps; c++)
+                        dst[((size_t)y * w + x) * ps + c] = __SB3_DEV_saturate(0.5 +
+                            (1 - dy) * ((1 - dx) * p00[c] + dx * p10[c]) + dy * ((1 - dx) * p01[c] + dx * p11[c]));
+                }
+            }
+            __SB3_DEV_free(in);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+/* API */
+
+char __SB3_DEV_node_check(SB3_DEV_node_t* node)
+{
+    if(!node)
+    {
+        #ifdef SB3_DEV_CRASH_WHEN_ERROR
+            errx(EXIT_FAILURE, "GRAPH: NULL node");
+        #else
+            SB3_DEV_SetError(SB3_DEV_NULL_IMAGE_ERROR);
+            return 0;
+        #endif
+    }
+    return 1;
+}
+
+char __SB3_DEV_region_check(SB3_DEV_node_t* node, int x, int y, int w, int h)
+{
+    if(x < 0 || y < 0 || w <= 0 || h <= 0 || x + w > node->w || y + h > node->h)
+    {
+        #ifdef SB3_DEV_CRASH_WHEN_ERROR
+            errx(EXIT_FAILURE, "GRAPH: region (%d, %d, %d, %d) outside of the %dx%d image", x, y, w, h, node->w, node->h);
+        #else
+            SB3_DEV_SetError(SB3_DEV_OUT_OF_BOUNDS_ERROR);
+            return 0;
+        #endif
+    }
+    return 1;
+}
+
+SB3_DEV_node_t* SB3_DEV_graph_source(SB3_DEV_graph_t* graph, SB3_DEV_image_t* image)
+{
+    if(!image)
+    {
+        #ifdef SB3_DEV_CRASH_WHEN_ERROR
+            errx(EXIT_FAILURE, "GRAPH: NULL image");
+        #else
+            SB3_DEV_SetError(SB3_DEV_NULL_IMAGE_ERROR);
+            return NULL;
+        #endif
+    }
+    return __SB3_DEV_graph_add(graph, (SB3_DEV_node_t) {
+        .type = __SB3_DEV_SOURCE_NODE,
+        .w = image->w,
+        .h = image->h,
+        .format = image->format,
+        .image = image,
+    });
+}
+
+SB3_DEV_node_t* SB3_DEV_graph_crop(SB3_DEV_node_t* input, int x, int y, int width, int height)
+{
+    if(!__SB3_DEV_node_check(input) || !__SB3_DEV_region_check(input, x, y, width, height))
+        return NULL;
+    return __SB3_DEV_graph_add(input->graph, (SB3_DEV_node_t) {
+        .type = __SB3_DEV_CROP_NODE,
+        .w = width,
+        .h = height,
+        .format = input->format,
+        .input = input,
+        .x = x,
+        .y = y,
+    });
+}
+
+SB3_DEV_node_t* SB3_DEV_graph_resize(SB3_DEV_node_t* input, int width, int height)
+{
+    if(!__SB3_DEV_node_check(input))
+        return NULL;
+    if(width <= 0 || height <= 0)
+    {
+        #ifdef SB3_DEV_CRASH_WHEN_ERROR
+            errx(EXIT_FAILURE, "GRAPH: invalid resize dimensions (%dx%d)", width, height);
+        #else
+            SB3_DEV_SetError(SB3_DEV_OUT_OF_BOUNDS_ERROR);
+            return NULL;
+        #endif
+    }
+    return __SB3_DEV_graph_add(input->graph, (SB3_DEV_node_t) {
+        .type = __SB3_DEV_RESIZE_NODE,
+        .w = width,
+        .h = height,
+        .format = input->format == SB3_DEV_BINARY_COLOR_FORMAT ? SB3_DEV_MONO_COLOR_FORMAT : input->format,
+        .input = input,
+    });
+}
+
+SB3_DEV_node_t* SB3_DEV_graph_convolution(SB3_DEV_node_t* input, SB3_DEV_kernel_t* kernel)
+{
+    if(!__SB3_DEV_node_check(input))
+        return NULL;
+    // the kernel is copied: it can be freed after this call
+    double* weights = __SB3_DEV_malloc(kernel->dim * kernel->dim * sizeof(double));
+    memcpy(weights, kernel->kernel, kernel->dim * kernel->dim * sizeof(double));
+    return __SB3_DEV_graph_add(input->graph, (SB3_DEV_node_t) {
+        .type = __SB3_DEV_CONVOLUTION_NODE,
+        .w = input->w,
+        .h = input->h,
+        .format = input->format == SB3_DEV_BINARY_COLOR_FORMAT ? SB3_DEV_MONO_COLOR_FORMAT : input->format,
+        .input = input,
+        .dim = kernel->dim,
+        .kernel = weights,
+    });
+}
+
+SB3_DEV_node_t* SB3_DEV_graph_grayscale(SB3_DEV_node_t* input, double boost)
+{
+    if(!__SB3_DEV_node_check(input))
+        return NULL;
+    if(input->format != SB3_DEV_RGB_FORMAT)
+    {
+        #ifdef SB3_DEV_CRASH_WHEN_ERROR
+            errx(EXIT_FAILURE, "GRAPH: invalid image format for grayscale (expected rgb image)");
+        #else
+            SB3_DEV_SetError(SB3_DEV_BAD_FORMAT_ERROR);
+            return NULL;
+        #endif
+    }
+    SB3_DEV_node_t node = {
+        .type = __SB3_DEV_GRAYSCALE_NODE,
+        .w = input->w,
+        .h = input->h,
+        .format = SB3_DEV_MONO_COLOR_FORMAT,
+        .input = input,
+    };
+    for(int v = 0; v < 256; v++)
+        node.lut[v] = boost ? __SB3_DEV_grayscale_boost(v, boost) : v;
+    return __SB3_DEV_graph_add(input->graph, node);
+}
+
+void SB3_DEV_graph_size(SB3_DEV_node_t* node, int* width, int* height)
+{
+    *width = node->w;
+    *height = node->h;
+}
+
+SB3_DEV_image_t* SB3_DEV_graph_render(SB3_DEV_node_t* node, int x, int y, int width, int height)
+{
+    if(!__SB3_DEV_node_check(node) || !__SB3_DEV_region_check(node, x, y, width, height))
+        return NULL;
+    SB3_DEV_image_t* res = SB3_DEV_NewImage(width, height, node->format);
+    __SB3_DEV_node_fetch(node, x, y, width, height, res->pixels);
+    SB3_DEV_SetError(SB3_DEV_SUCCESS_EXIT);
+    return res;
+}
+
+SB3_DEV_image_t* SB3_DEV_graph_to_image(SB3_DEV_node_t* node)
+{
+    if(!__SB3_DEV_node_check(node))
+        return NULL;
+    return SB3_DEV_graph_render(node, 0, 0, node->w, node->h);
+}
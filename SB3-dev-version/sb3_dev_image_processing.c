@@ -29,24 +29,30 @@
  *
  */
 
-#include "sb3_dev.h"
+#include "sb3_dev_internal.h"
 #include <err.h>
-#include <math.h>
-
-void SB3_DEV_SetError(SB3_DEV_errors_t error);
 
 void SB3_DEV_FreeKernel(SB3_DEV_kernel_t* kernel)
 {
-    free(kernel->kernel);
-    free(kernel);
+    __SB3_DEV_free(kernel->kernel);
+    __SB3_DEV_free(kernel);
 }
 
-int* SB3_DEV_convolution(SB3_DEV_image_t* image, SB3_DEV_kernel_t* kernel)
+void SB3_DEV_Free(void* ptr)
 {
+    __SB3_DEV_free(ptr);
+}
+
+// w * h * pixel size values in res
+void __SB3_DEV_convolution(SB3_DEV_image_t* image, SB3_DEV_kernel_t* kernel, int* res)
+{
+    if(kernel->dim >= SB3_DEV_FFT_CONVOLUTION_DIM)
+    {
+        __SB3_DEV_fft_convolution(image, kernel, res);
+        return;
+    }
     char is_rgb = image->format == SB3_DEV_RGB_FORMAT;
     int max_coordonate = (kernel->dim - 1) / 2;
-    int size_of_pixels = is_rgb ? 3 : 1;
-    int* res = malloc(image->h * image->w * sizeof(*res) * size_of_pixels);
 
     for(int i = 0; i < image->h; i++)
     {
@@ -92,38 +98,50 @@ int* SB3_DEV_convolution(SB3_DEV_image_t* image, SB3_DEV_kernel_t* kernel)
                 res[i * image->w + j] = (int)nr;
         }
     }
+}
 
+// the result is given to the caller (free it with SB3_DEV_Free)
+int* SB3_DEV_convolution(SB3_DEV_image_t* image, SB3_DEV_kernel_t* kernel)
+{
+    int* res = __SB3_DEV_malloc((size_t)image->h * image->w * sizeof(*res) * __SB3_DEV_pixel_size(image->format));
+    __SB3_DEV_convolution(image, kernel, res);
     return res;
 }
 
-void SB3_DEV_apply_convolution(SB3_DEV_image_t* image, SB3_DEV_kernel_t* kernel)
+// convolution values stored modulo 256 in dst (contiguous, dst may be image)
+void __SB3_DEV_convolution_store(SB3_DEV_image_t* image, SB3_DEV_kernel_t* kernel, SB3_DEV_image_t* dst)
 {
-    int* c = SB3_DEV_convolution(image, kernel);
-    for(int i = 0; i < image->w * image->h; i++)
-    {
-        if(image->format == SB3_DEV_RGB_FORMAT)
-        {
-            SB3_DEV_RGBColor_t* color = SB3_DEV_NewRGB(c[i*3], c[i*3+1], c[i*3+2]);
-            SB3_DEV_SetPixel(image, (void*)color, i);
-        }
-        else
-            SB3_DEV_SetPixel(image, (void*)SB3_DEV_NewMonoColor(c[i]), i);
-    }
-    free(c);
+    size_t count = (size_t)image->w * image->h * __SB3_DEV_pixel_size(image->format);
+    int* c = __SB3_DEV_malloc(count * sizeof(int));
+    __SB3_DEV_convolution(image, kernel, c);
+    __SB3_DEV_writable(dst, 0);
+    uint8_t* pixels = dst->pixels;
+    for(size_t i = 0; i < count; i++)
+        pixels[i] = c[i];
+    __SB3_DEV_free(c);
 }
 
-uint8_t __SB3_DEV_grayscale_boost(uint8_t color, double num)
+void SB3_DEV_apply_convolution(SB3_DEV_image_t* image, SB3_DEV_kernel_t* kernel)
 {
-    if(color <= 255/2)
-        return (uint8_t) ((255./2.) * pow((double)2*color/255, num));
-    return 255 - __SB3_DEV_grayscale_boost(255 - color, num);
+    __SB3_DEV_convolution_store(image, kernel, image);
 }
 
-SB3_DEV_monoColor_t* __SB3_DEV_pixel_to_grayscale(SB3_DEV_RGBColor_t* color, double boost)
+const uint8_t* __SB3_DEV_gray_row(SB3_DEV_image_t* image, int y, uint8_t* buffer)
 {
-    uint8_t average = (uint8_t)(0.3 * (double)color->r + 0.59 * (double)color->g + 0.11 * (double)color->b);
-    if(boost) average = __SB3_DEV_grayscale_boost(average, boost);
-    return SB3_DEV_NewMonoColor(average);
+    const uint8_t* row = __SB3_DEV_row(image, y);
+    if(image->format == SB3_DEV_INDEXED_FORMAT)
+    {
+        uint8_t lut[256];
+        for(int i = 0; i < 256; i++)
+            lut[i] = __SB3_DEV_luma(image->palette[i].r, image->palette[i].g, image->palette[i].b);
+        for(int x = 0; x < image->w; x++)
+            buffer[x] = lut[row[x]];
+        return buffer;
+    }
+    if(image->format != SB3_DEV_RGB_FORMAT)
+        return row;
+    __SB3_DEV_rgb_to_gray(row, buffer, image->w, NULL);
+    return buffer;
 }
 
 SB3_DEV_image_t* SB3_DEV_grayscale(SB3_DEV_image_t* image, double boost)
@@ -139,12 +157,10 @@ SB3_DEV_image_t* SB3_DEV_grayscale(SB3_DEV_image_t* image, double boost)
     }
 
     SB3_DEV_image_t* res = SB3_DEV_NewImage(image->w, image->h, SB3_DEV_MONO_COLOR_FORMAT);
-
-    for(int i = 0; i < image->w * image->h; i++)
-    {
-        SB3_DEV_SetPixel(res, (void*)__SB3_DEV_pixel_to_grayscale(
-            (SB3_DEV_RGBColor_t*)SB3_DEV_GetPixel(image, i), boost), i);
-    }
+    uint8_t lut[256];
+    const uint8_t* curve = __SB3_DEV_boost_lut(boost, lut);
+    for(int y = 0; y < image->h; y++)
+        __SB3_DEV_rgb_to_gray(__SB3_DEV_row(image, y), __SB3_DEV_row(res, y), image->w, curve);
 
     return res;
 }
@@ -161,101 +177,30 @@ SB3_DEV_errors_t SB3_DEV_image_to_grayscale(SB3_DEV_image_t* image, double boost
         #endif
     }
 
-    image->format = SB3_DEV_MONO_COLOR_FORMAT;
-    image->mono_pixels = malloc(image->w * image->h * sizeof(SB3_DEV_monoColor_t*));
-    for(int i = 0; i < image->w * image->h; i++)
-    {
-        image->mono_pixels[i] = __SB3_DEV_pixel_to_grayscale(image->rgb_pixels[i], boost);
-        free(image->rgb_pixels[i]);
-    }
-    free(image->rgb_pixels);
-    image->rgb_pixels = NULL;
+    uint8_t* pixels = __SB3_DEV_pixels_alloc((size_t)image->w * image->h, 0);
+    uint8_t lut[256];
+    const uint8_t* curve = __SB3_DEV_boost_lut(boost, lut);
+    for(int y = 0; y < image->h; y++)
+        __SB3_DEV_rgb_to_gray(__SB3_DEV_row(image, y), pixels + (size_t)y * image->w, image->w, curve);
+    __SB3_DEV_set_pixels(image, SB3_DEV_MONO_COLOR_FORMAT, pixels);
 
     return SB3_DEV_SUCCESS_EXIT;
 }
 
-double __SB3_DEV_gaussian_value(double x, double mu, double sigma)
-{
-    double a = (x - mu) / sigma;
-    return exp(-0.5 * a * a);
-}
-
+// the caller owns the result: a copy of the cached kernel
 SB3_DEV_kernel_t* SB3_DEV_gaussian_kernel(unsigned int kernel_radius)
 {
-    double sigma = kernel_radius / 2.;
-    int size = 2 * kernel_radius + 1;
-    double* m = malloc(size * size * sizeof(double));
-    double sum = 0;
-
-    for(int row = 0; row < size; row++)
-    {
-        for(int col = 0; col < size; col++)
-        {
-            double x = __SB3_DEV_gaussian_value(row, kernel_radius, sigma) *
-                __SB3_DEV_gaussian_value(col, kernel_radius, sigma);
-            *(m + row * size + col) = x;
-            sum += x;
-        }
-    }
-    for(int row = 0; row < size; row++)
-    {
-        for(int col = 0; col < size; col++)
-        {
-            *(m + row * size + col) /= sum;
-        }
-    }
-    SB3_DEV_kernel_t* res = malloc(sizeof(*res));
+    SB3_DEV_kernel_t* cached = SB3_DEV_cached_gaussian_kernel(kernel_radius, 0);
+    size_t size = (size_t)cached->dim * cached->dim * sizeof(double);
+    SB3_DEV_kernel_t* res = __SB3_DEV_malloc(sizeof(*res));
     *res = (SB3_DEV_kernel_t) {
-        .dim = size,
-        .kernel = m,
+        .dim = cached->dim,
+        .kernel = __SB3_DEV_malloc(size),
     };
-
+    memcpy(res->kernel, cached->kernel, size);
     return res;
 }
 
-SB3_DEV_image_t* SB3_DEV_gaussian_blur(SB3_DEV_image_t* image, unsigned int kernel_radius)
-{
-    SB3_DEV_kernel_t* kernel = SB3_DEV_gaussian_kernel(kernel_radius);
-    SB3_DEV_image_t* res = SB3_DEV_NewImage(image->w, image->h, image->format);
-    int* c = SB3_DEV_convolution(image, kernel);
-    char is_rgb = image->format == SB3_DEV_RGB_FORMAT;
-    for(int i = 0; i < image->w * image->h; i++)
-    {
-        if(is_rgb)
-        {
-            SB3_DEV_RGBColor_t* color = SB3_DEV_NewRGB(c[i*3]%256, c[i*3+1]%256, c[i*3+2]%256);
-            SB3_DEV_SetPixel(res, (void*)color, i);
-        }
-        else SB3_DEV_SetPixel(res, (void*)SB3_DEV_NewMonoColor(c[i]%256), i);
-    }
-    free(c);
-    SB3_DEV_FreeKernel(kernel);
-    return res;
-}
-
-void SB3_DEV_apply_gaussian_blur(SB3_DEV_image_t* image, unsigned int kernel_radius)
-{
-    // BASICALLY :
-    // SB3_DEV_image_t* res = SB3_DEV_gaussian_blur(image, kernel_radius);
-    // for(int i=0;i<image->w*image->h;i++)
-    //     SB3_DEV_SetPixel(image, SB3_DEV_GetPixel(res, i), i);
-    // SB3_DEV_FreeImage(res);
-    SB3_DEV_kernel_t* kernel = SB3_DEV_gaussian_kernel(kernel_radius);
-    int* c = SB3_DEV_convolution(image, kernel);
-    char is_rgb = image->format == SB3_DEV_RGB_FORMAT;
-    for(int i = 0; i < image->w * image->h; i++)
-    {
-        if(is_rgb)
-        {
-            SB3_DEV_RGBColor_t* color = SB3_DEV_NewRGB(c[i*3]%256, c[i*3+1]%256, c[i*3+2]%256);
-            SB3_DEV_SetPixel(image, (void*)color, i);
-        }
-        else SB3_DEV_SetPixel(image, (void*)SB3_DEV_NewMonoColor(c[i]%256), i);
-    }
-    free(c);
-    SB3_DEV_FreeKernel(kernel);
-}
-
 
 
 
@@ -0,0 +1,245 @@
+/*
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 AyAztuB
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ *
+ * AUTHOR
+ *
+ * AyAztuB (ayaztub@gmail.com) from https://github.com/AyAztuB/SB3-Project
+ *
+ */
+
+
+
+#ifndef __SB3_DEV_INTERNAL_H__
+#define __SB3_DEV_INTERNAL_H__
+
+// library private helpers (not installed)
+
+#include "sb3_dev.h"
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+
+void SB3_DEV_SetError(SB3_DEV_errors_t error);
+
+// every allocation goes through the allocator set by SB3_DEV_SetAllocator (free with __SB3_DEV_free)
+#define __SB3_DEV_PIXELS_ALIGNMENT 64
+void* __SB3_DEV_malloc(size_t size);
+void* __SB3_DEV_calloc(size_t count, size_t size);
+void* __SB3_DEV_realloc(void* ptr, size_t size);
+// pixel blocks, __SB3_DEV_PIXELS_ALIGNMENT aligned (aligned_alloc_fn when given)
+void* __SB3_DEV_pixels_alloc(size_t size, char zero);
+void __SB3_DEV_free(void* ptr);
+// scope of the calling thread, handed to the workers it starts
+SB3_DEV_allocator_scope_t* __SB3_DEV_allocator_scope(void);
+// error code of the last call of the calling thread
+SB3_DEV_errors_t __SB3_DEV_LastError(void);
+
+// bytes per pixel in the contiguous storage
+static inline int __SB3_DEV_pixel_size(SB3_DEV_image_format_t format)
+{
+    return format == SB3_DEV_RGB_FORMAT ? 3 : 1;
+}
+
+static inline uint8_t* __SB3_DEV_row(SB3_DEV_image_t* image, int y)
+{
+    return (uint8_t*)image->pixels + (size_t)y * image->stride;
+}
+
+struct SB3_DEV_buffer_s {
+    atomic_int references;
+    void* data;
+};
+
+// replace the storage of image by pixels (w * h pixels of the given format) and rebuild the pointer arrays
+void __SB3_DEV_set_pixels(SB3_DEV_image_t* image, SB3_DEV_image_format_t format, void* pixels);
+void __SB3_DEV_buffer_release(SB3_DEV_buffer_t* buffer);
+// before an in place change: image owns its w * h contiguous pixels after it (copied when keep is set)
+void __SB3_DEV_writable(SB3_DEV_image_t* image, char keep);
+// 0.3 r + 0.59 g + 0.11 b in 8 bits fixed point
+#define __SB3_DEV_LUMA_R 77
+#define __SB3_DEV_LUMA_G 151
+#define __SB3_DEV_LUMA_B 28
+
+static inline uint8_t __SB3_DEV_luma(uint8_t r, uint8_t g, uint8_t b)
+{
+    return (__SB3_DEV_LUMA_R * r + __SB3_DEV_LUMA_G * g + __SB3_DEV_LUMA_B * b) >> 8;
+}
+
+// conversion kernels over count pixels (SSSE3 when the cpu has it)
+// r, g, b <-> b, g, r (src == dst allowed)
+void __SB3_DEV_swap_rb(const uint8_t* src, uint8_t* dst, int count);
+// luma, then lut (may be NULL) applied
+void __SB3_DEV_rgb_to_gray(const uint8_t* rgb, uint8_t* gray, int count, const uint8_t* lut);
+void __SB3_DEV_gray_to_rgb(const uint8_t* gray, uint8_t* rgb, int count);
+// contrast curve of the grayscale boost
+uint8_t __SB3_DEV_grayscale_boost(uint8_t color, double num);
+// fill lut with the boost curve, NULL (identity) for boost 0
+const uint8_t* __SB3_DEV_boost_lut(double boost, uint8_t* lut);
+// luminance of row y: the row itself for mono and binary images, else computed in buffer (image->w bytes)
+const uint8_t* __SB3_DEV_gray_row(SB3_DEV_image_t* image, int y, uint8_t* buffer);
+
+// summed-area tables of the luminance ((w + 1) * (h + 1), first row and column are 0)
+// 32 bits sums wrap but window differences stay exact while 255 * w * h < 2^32, larger images use wide_sum
+typedef struct {
+    int w, h;
+    uint32_t* sum; // NULL when wide_sum is used
+    uint64_t* wide_sum;
+    uint64_t* squares; // NULL if not requested
+} __SB3_DEV_integral_t;
+
+__SB3_DEV_integral_t* __SB3_DEV_integral(SB3_DEV_image_t* image, char with_squares);
+// same table of the products of the luminances of two images of the same size (free it with __SB3_DEV_free)
+uint64_t* __SB3_DEV_integral_products(SB3_DEV_image_t* a, SB3_DEV_image_t* b);
+void __SB3_DEV_FreeIntegral(__SB3_DEV_integral_t* integral);
+// sum of a table over the window [x0, x1[ * [y0, y1[
+#define __SB3_DEV_WINDOW(table, stride, x0, y0, x1, y1) \
+    ((table)[(size_t)(y1) * (stride) + (x1)] - (table)[(size_t)(y0) * (stride) + (x1)] - \
+     (table)[(size_t)(y1) * (stride) + (x0)] + (table)[(size_t)(y0) * (stride) + (x0)])
+
+static inline uint64_t __SB3_DEV_integral_sum(const __SB3_DEV_integral_t* integral, int x0, int y0, int x1, int y1)
+{
+    int stride = integral->w + 1;
+    if(integral->sum)
+        return (uint32_t)__SB3_DEV_WINDOW(integral->sum, stride, x0, y0, x1, y1);
+    return __SB3_DEV_WINDOW(integral->wide_sum, stride, x0, y0, x1, y1);
+}
+
+
+// byte source of the bmp decoder: a FILE, a memory buffer, or a file descriptor / an io read through buffer (buffer != NULL)
+typedef struct {
+    FILE* file;
+    const uint8_t* data;
+    size_t size, pos;
+    int fd;
+    const SB3_DEV_io_t* io; // used instead of fd when set
+    uint8_t* buffer;
+    size_t capacity;
+} __SB3_DEV_reader_t;
+
+// next byte of a file descriptor / io reader whose buffer is consumed
+uint8_t __SB3_DEV_refill(__SB3_DEV_reader_t* reader);
+// drop the next size bytes (seeking when the source can)
+void __SB3_DEV_skip(__SB3_DEV_reader_t* reader, size_t size);
+
+// next size bytes (EOF bytes past the end)
+void __SB3_DEV_read(__SB3_DEV_reader_t* reader, uint8_t* dst, size_t size);
+
+static inline uint8_t __SB3_DEV_getc(__SB3_DEV_reader_t* reader)
+{
+    if(reader->pos < reader->size)
+        return reader->data[reader->pos++];
+    if(reader->file)
+        return fgetc(reader->file);
+    if(reader->buffer)
+        return __SB3_DEV_refill(reader);
+    return EOF;
+}
+
+// byte sink of the bmp encoder: a FILE, an io or a growing memory buffer (file == NULL, data owned by the caller)
+typedef struct {
+    FILE* file;
+    const SB3_DEV_io_t* io;
+    char failed; // an io write failed or the buffer couldn't grow
+    uint8_t* data;
+    size_t size, capacity;
+} __SB3_DEV_writer_t;
+
+void __SB3_DEV_reserve(__SB3_DEV_writer_t* writer, size_t capacity);
+void __SB3_DEV_io_write(__SB3_DEV_writer_t* writer, const uint8_t* data, size_t size);
+
+static inline void __SB3_DEV_write(__SB3_DEV_writer_t* writer, const uint8_t* data, size_t size)
+{
+    if(writer->file)
+    {
+        fwrite(data, 1, size, writer->file);
+        return;
+    }
+    if(writer->io)
+    {
+        __SB3_DEV_io_write(writer, data, size);
+        return;
+    }
+    if(writer->size + size > writer->capacity)
+        __SB3_DEV_reserve(writer, writer->size + size > writer->capacity * 2 ? writer->size + size : writer->capacity * 2);
+    if(writer->failed)
+        return;
+    memcpy(writer->data + writer->size, data, size);
+    writer->size += size;
+}
+
+// sizes of the bmp file written for an image
+typedef struct {
+    int padding, bits_per_pixels, color_table_size;
+    int file_size; // as stored in the header
+    int pixel_array_offset;
+    int row_size; // bytes of a scanline (padding included)
+    size_t total_size; // bytes actually written
+    char top_down; // scanlines stored from the top row (negative height)
+} __SB3_DEV_BMP_layout_t;
+
+// file header + BITMAPINFOHEADER
+#define __SB3_DEV_BMP_HEADERS_SIZE 54
+// 256 BGRA entries
+#define __SB3_DEV_BMP_COLOR_TABLE_SIZE 1024
+// pixels of a scanline decoded at once from a stack buffer (multiple of 8)
+#define __SB3_DEV_BMP_CHUNK 1024
+
+char __SB3_DEV_BMP_extension(const char* path);
+// scanlines of a file (height is negative for top-down files)
+static inline int __SB3_DEV_BMP_rows(const SB3_DEV_BMP_info_t* info)
+{
+    return info->height < 0 ? -info->height : info->height;
+}
+// end of the headers and color table of a parsed file (colors_used set), the pixels start there or later at pixel_array_offset
+static inline uint64_t __SB3_DEV_BMP_headers_end(const SB3_DEV_BMP_info_t* info)
+{
+    return __SB3_DEV_BMP_HEADERS_SIZE - 40 + (uint64_t)info->info_header_size
+        + (info->bits_per_pixels < 16 ? (uint64_t)info->colors_used * 4 : 0);
+}
+// validate the headers and extract their metadata (caller names the api function in the errors)
+SB3_DEV_errors_t __SB3_DEV_BMP_parse(const uint8_t* headers, size_t size, SB3_DEV_BMP_info_t* info, const char* caller);
+void __SB3_DEV_BMP_layout(SB3_DEV_image_t* image, __SB3_DEV_BMP_layout_t* layout);
+// file header, info header and color table (layout->pixel_array_offset bytes)
+void __SB3_DEV_BMP_header(SB3_DEV_image_t* image, const __SB3_DEV_BMP_layout_t* layout, uint8_t* out);
+// scanline y of image (layout->row_size bytes)
+SB3_DEV_errors_t __SB3_DEV_BMP_encode_row(SB3_DEV_image_t* image, int y, const __SB3_DEV_BMP_layout_t* layout, uint8_t* out);
+SB3_DEV_image_t* __SB3_DEV_BMP_decode(__SB3_DEV_reader_t* reader, SB3_DEV_image_format_t format);
+// decode in two steps: headers and color table (__SB3_DEV_BMP_COLOR_TABLE_SIZE bytes), then the pixels in the contiguous storage
+// (bottom row first whatever the row order of the file)
+SB3_DEV_errors_t __SB3_DEV_BMP_decode_header(__SB3_DEV_reader_t* reader, SB3_DEV_image_format_t format, SB3_DEV_BMP_info_t* info, uint8_t* color_table);
+SB3_DEV_errors_t __SB3_DEV_BMP_decode_pixels(__SB3_DEV_reader_t* reader, SB3_DEV_image_format_t format, const SB3_DEV_BMP_info_t* info, const uint8_t* color_table, uint8_t* pixels);
+// file scanlines [first, last) only, reader positioned on scanline first
+SB3_DEV_errors_t __SB3_DEV_BMP_decode_rows(__SB3_DEV_reader_t* reader, SB3_DEV_image_format_t format, const SB3_DEV_BMP_info_t* info, const uint8_t* color_table, uint8_t* pixels, int first, int last);
+SB3_DEV_errors_t __SB3_DEV_BMP_encode(__SB3_DEV_writer_t* writer, SB3_DEV_image_t* image, char top_down);
+
+// convolution through tiled transforms (w * h * pixel size values in res, as the direct sum gives them)
+void __SB3_DEV_fft_convolution(SB3_DEV_image_t* image, SB3_DEV_kernel_t* kernel, int* res);
+
+// worker count for a threads argument (<= 0: one per online cpu)
+int __SB3_DEV_thread_count(int threads);
+// run task(context, i) for i in [0, count) on up to threads workers (the caller is one of them)
+void __SB3_DEV_parallel_for(int count, int threads, void (*task)(void* context, int i), void* context);
+
+#endif // __SB3_DEV_INTERNAL_H__
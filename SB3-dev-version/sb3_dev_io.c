@@ -0,0 +1,277 @@
+/*
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 AyAztuB
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ *
+ * AUTHOR
+ *
+ * AyAztuB (ayaztub@gmail.com) from https://github.com/AyAztuB/SB3-Project
+ *
+ */
+
+
+
+#include "sb3_dev_internal.h"
+#include <err.h>
+#include <errno.h>
+#include <stdint.h>
+#include <unistd.h>
+
+
+void __SB3_DEV_io_write(__SB3_DEV_writer_t* writer, const uint8_t* data, size_t size)
+{
+    while(size && !writer->failed)
+    {
+        long n = writer->io->write(writer->io->handle, data, size);
+        if(n <= 0)
+            writer->failed = 1;
+        else
+        {
+            data += n;
+            size -= n;
+        }
+    }
+}
+
+long __SB3_DEV_memory_read(void* handle, void* data, size_t size)
+{
+    SB3_DEV_memory_t* memory = handle;
+    size_t n = memory->position < memory->size ? memory->size - memory->position : 0;
+    if(n > size)
+        n = size;
+    if(!n)
+        return 0;
+    memcpy(data, (uint8_t*)memory->data + memory->position, n);
+    memory->position += n;
+    return n;
+}
+
+long __SB3_DEV_memory_write(void* handle, const void* data, size_t size)
+{
+    SB3_DEV_memory_t* memory = handle;
+    size_t n = memory->position < memory->capacity ? memory->capacity - memory->position : 0;
+    if(n > size)
+        n = size;
+    if(!n)
+        return 0;
+    memcpy((uint8_t*)memory->data + memory->position, data, n);
+    memory->position += n;
+    if(memory->position > memory->size)
+        memory->size = memory->position;
+    return n;
+}
+
+long __SB3_DEV_memory_seek(void* handle, long offset, int whence)
+{
+    SB3_DEV_memory_t* memory = handle;
+    long base = whence == SEEK_SET ? 0 : whence == SEEK_CUR ? (long)memory->position : (long)memory->size;
+    if(base + offset < 0)
+        return -1;
+    memory->position = base + offset;
+    return memory->position;
+}
+
+SB3_DEV_io_t SB3_DEV_io_memory(SB3_DEV_memory_t* memory)
+{
+    return (SB3_DEV_io_t) {
+        .read = __SB3_DEV_memory_read,
+        .write = __SB3_DEV_memory_write,
+        .seek = __SB3_DEV_memory_seek,
+        .handle = memory,
+    };
+}
+
+long __SB3_DEV_fd_read(void* handle, void* data, size_t size)
+{
+    ssize_t n;
+    do
+        n = read((int)(intptr_t)handle, data, size);
+    while(n < 0 && errno == EINTR);
+    return n;
+}
+
+long __SB3_DEV_fd_write(void* handle, const void* data, size_t size)
+{
+    ssize_t n;
+    do
+        n = write((int)(intptr_t)handle, data, size);
+    while(n < 0 && errno == EINTR);
+    return n;
+}
+
+long __SB3_DEV_fd_seek(void* handle, long offset, int whence)
+{
+    return lseek((int)(intptr_t)handle, offset, whence);
+}
+
+SB3_DEV_io_t SB3_DEV_io_fd(int fd)
+{
+    return (SB3_DEV_io_t) {
+        .read = __SB3_DEV_fd_read,
+        .write = __SB3_DEV_fd_write,
+        .seek = __SB3_DEV_fd_seek,
+        .handle = (void*)(intptr_t)fd,
+    };
+}
+
+long __SB3_DEV_stream_read(void* handle, void* data, size_t size)
+{
+    size_t n = fread(data, 1, size, handle);
+    return n || !ferror((FILE*)handle) ? (long)n : -1;
+}
+
+long __SB3_DEV_stream_write(void* handle, const void* data, size_t size)
+{
+    size_t n = fwrite(data, 1, size, handle);
+    return n ? (long)n : -1;
+}
+
+long __SB3_DEV_stream_seek(void* handle, long offset, int whence)
+{
+    if(fseek(handle, offset, whence))
+        return -1;
+    return ftell(handle);
+}
+
+SB3_DEV_io_t SB3_DEV_io_stream(FILE* stream)
+{
+    return (SB3_DEV_io_t) {
+        .read = __SB3_DEV_stream_read,
+        .write = __SB3_DEV_stream_write,
+        .seek = __SB3_DEV_stream_seek,
+        .handle = stream,
+    };
+}
+
+SB3_DEV_image_t* SB3_DEV_BMP_decode_io(const SB3_DEV_io_t* io, SB3_DEV_image_format_t format)
+{
+    if(!io || !io->read)
+    {
+        #ifdef SB3_DEV_CRASH_WHEN_ERROR
+            errx(EXIT_FAILURE, "DECODE_IO: NULL io or read callback");
+        #else
+            SB3_DEV_SetError(SB3_DEV_NULL_BUFFER_ERROR);
+            return NULL;
+        #endif
+    }
+    uint8_t buffer[1 << 16];
+    __SB3_DEV_reader_t reader = { .io = io, .buffer = buffer, .capacity = sizeof(buffer) };
+    return __SB3_DEV_BMP_decode(&reader, format);
+}
+
+SB3_DEV_errors_t SB3_DEV_BMP_encode_io(const SB3_DEV_io_t* io, SB3_DEV_image_t* image)
+{
+    if(!image)
+    {
+        #ifdef SB3_DEV_CRASH_WHEN_ERROR
+            errx(EXIT_FAILURE, "ENCODE_IO: NULL image cannot be saved");
+        #else
+            SB3_DEV_SetError(SB3_DEV_NULL_IMAGE_ERROR);
+            return SB3_DEV_NULL_IMAGE_ERROR;
+        #endif
+    }
+    if(!io || !io->write)
+    {
+        #ifdef SB3_DEV_CRASH_WHEN_ERROR
+            errx(EXIT_FAILURE, "ENCODE_IO: NULL io or write callback");
+        #else
+            SB3_DEV_SetError(SB3_DEV_NULL_BUFFER_ERROR);
+            return SB3_DEV_NULL_BUFFER_ERROR;
+        #endif
+    }
+    __SB3_DEV_writer_t writer = { .io = io };
+    SB3_DEV_errors_t error = __SB3_DEV_BMP_encode(&writer, image, 0);
+    if(error == SB3_DEV_SUCCESS_EXIT && writer.failed)
+    {
+        #ifdef SB3_DEV_CRASH_WHEN_ERROR
+            errx(EXIT_FAILURE, "ENCODE_IO: write callback failed");
+        #else
+            SB3_DEV_SetError(SB3_DEV_IO_ERROR);
+            return SB3_DEV_IO_ERROR;
+        #endif
+    }
+    return error;
+}
+
+SB3_DEV_image_t* SB3_DEV_BMP_decode_memory(const void* data, size_t size, SB3_DEV_image_format_t format)
+{
+    if(!data)
+    {
+        #ifdef SB3_DEV_CRASH_WHEN_ERROR
+            errx(EXIT_FAILURE, "DECODE_MEMORY: NULL buffer");
+        #else
+            SB3_DEV_SetError(SB3_DEV_NULL_BUFFER_ERROR);
+            return NULL;
+        #endif
+    }
+    // decoded in place: no copy of the file
+    __SB3_DEV_reader_t reader = { .data = data, .size = size };
+    return __SB3_DEV_BMP_decode(&reader, format);
+}
+
+size_t SB3_DEV_BMP_encoded_size(SB3_DEV_image_t* image)
+{
+    if(!image)
+        return 0;
+    __SB3_DEV_BMP_layout_t layout;
+    __SB3_DEV_BMP_layout(image, &layout);
+    return layout.total_size;
+}
+
+SB3_DEV_errors_t SB3_DEV_BMP_encode_memory(SB3_DEV_image_t* image, void* data, size_t capacity, size_t* size)
+{
+    if(!image)
+    {
+        #ifdef SB3_DEV_CRASH_WHEN_ERROR
+            errx(EXIT_FAILURE, "ENCODE_MEMORY: NULL image cannot be saved");
+        #else
+            SB3_DEV_SetError(SB3_DEV_NULL_IMAGE_ERROR);
+            return SB3_DEV_NULL_IMAGE_ERROR;
+        #endif
+    }
+    if(!data)
+    {
+        #ifdef SB3_DEV_CRASH_WHEN_ERROR
+            errx(EXIT_FAILURE, "ENCODE_MEMORY: NULL buffer");
+        #else
+            SB3_DEV_SetError(SB3_DEV_NULL_BUFFER_ERROR);
+            return SB3_DEV_NULL_BUFFER_ERROR;
+        #endif
+    }
+    size_t needed = SB3_DEV_BMP_encoded_size(image);
+    if(capacity < needed)
+    {
+        #ifdef SB3_DEV_CRASH_WHEN_ERROR
+            errx(EXIT_FAILURE, "ENCODE_MEMORY: Buffer too small (%zu bytes, %zu needed)", capacity, needed);
+        #else
+            SB3_DEV_SetError(SB3_DEV_BUFFER_TOO_SMALL_ERROR);
+            return SB3_DEV_BUFFER_TOO_SMALL_ERROR;
+        #endif
+    }
+    // the caller buffer is big enough: the writer never grows it
+    __SB3_DEV_writer_t writer = { .data = data, .capacity = capacity };
+    SB3_DEV_errors_t error = __SB3_DEV_BMP_encode(&writer, image, 0);
+    if(size)
+        *size = writer.size;
+    return error;
+}
@@ -0,0 +1,327 @@
+/*
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 AyAztuB
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ *
+ * AUTHOR
+ *
+ * AyAztuB (ayaztub@gmail.com) from https://github.com/AyAztuB/SB3-Project
+ *
+ */
+
+
+#include "sb3_dev_internal.h"
+#include <err.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/* INPUT ROWS */
+
+// rows y - r - 1 to y + r of the image (clamped) with r replicated pixels on each side
+// the filter reads only these copies, so the output can be the image itself
+typedef struct {
+    SB3_DEV_image_t* image;
+    int radius, size, capacity, next;
+    uint8_t* rows;
+} __SB3_DEV_median_rows_t;
+
+uint8_t* __SB3_DEV_median_row(__SB3_DEV_median_rows_t* rows, int y)
+{
+    int slot = ((y % rows->capacity) + rows->capacity) % rows->capacity;
+    return rows->rows + (size_t)slot * rows->size;
+}
+
+void __SB3_DEV_median_load(__SB3_DEV_median_rows_t* rows, int until)
+{
+    SB3_DEV_image_t* image = rows->image;
+    int ps = __SB3_DEV_pixel_size(image->format), r = rows->radius;
+    for(; rows->next <= until; rows->next++)
+    {
+        int y = rows->next < 0 ? 0 : rows->next >= image->h ? image->h - 1 : rows->next;
+        uint8_t* dst = __SB3_DEV_median_row(rows, rows->next);
+        const uint8_t* src = __SB3_DEV_row(image, y);
+        memcpy(dst + r * ps, src, (size_t)image->w * ps);
+        for(int i = 0; i < r; i++)
+        {
+            memcpy(dst + i * ps, src, ps);
+            memcpy(dst + (r + image->w + i) * ps, src + (image->w - 1) * ps, ps);
+        }
+    }
+}
+
+/* SORTING NETWORKS (radius 1 and 2) */
+
+// median of 9 in 19 compare-exchanges
+static const uint8_t __SB3_DEV_median9_network[19][2] = {
+    {1, 2}, {4, 5}, {7, 8}, {0, 1}, {3, 4}, {6, 7}, {1, 2}, {4, 5}, {7, 8}, {0, 3},
+    {5, 8}, {4, 7}, {3, 6}, {1, 4}, {2, 5}, {4, 7}, {4, 2}, {6, 4}, {4, 2},
+};
+
+// batcher odd-even merge sort of n elements, returns the number of compare-exchanges
+int __SB3_DEV_batcher_network(int n, uint8_t network[][2])
+{
+    int count = 0;
+    for(int p = 1; p < n; p <<= 1)
+        for(int k = p; k >= 1; k >>= 1)
+            for(int j = k % p; j + k < n; j += 2 * k)
+                for(int i = 0; i < k && i + j + k < n; i++)
+                    if((i + j) / (2 * p) == (i + j + k) / (2 * p))
+                    {
+                        network[count][0] = i + j;
+                        network[count][1] = i + j + k;
+                        count++;
+                    }
+    return count;
+}
+
+void __SB3_DEV_median_network_row(__SB3_DEV_median_rows_t* rows, int y, uint8_t* out,
+        const uint8_t network[][2], int count)
+{
+    int ps = __SB3_DEV_pixel_size(rows->image->format), r = rows->radius, d = 2 * r + 1;
+    int n = d * d, bytes = rows->image->w * ps;
+    const uint8_t* src[25];
+    for(int j = 0; j < d; j++)
+        for(int i = 0; i < d; i++)
+            src[j * d + i] = __SB3_DEV_median_row(rows, y - r + j) + i * ps;
+
+    // every byte is an independent lane: the neighbours of a channel are ps bytes away
+    int x = 0;
+#ifdef __SSE2__
+    __m128i v[25];
+    for(; x + 16 <= bytes; x += 16)
+    {
+        for(int k = 0; k < n; k++)
+            v[k] = _mm_loadu_si128((const __m128i*)(src[k] + x));
+        for(int k = 0; k < count; k++)
+        {
+            __m128i a = v[network[k][0]], b = v[network[k][1]];
+            v[network[k][0]] = _mm_min_epu8(a, b);
+            v[network[k][1]] = _mm_max_epu8(a, b);
+        }
+        _mm_storeu_si128((__m128i*)(out + x), v[n / 2]);
+    }
+#endif
+    uint8_t s[25];
+    for(; x < bytes; x++)
+    {
+        for(int k = 0; k < n; k++)
+            s[k] = src[k][x];
+        for(int k = 0; k < count; k++)
+        {
+            uint8_t a = s[network[k][0]], b = s[network[k][1]];
+            s[network[k][0]] = a < b ? a : b;
+            s[network[k][1]] = a < b ? b : a;
+        }
+        out[x] = s[n / 2];
+    }
+}
+
+/* HISTOGRAMS (Perreault & Hebert, O(1) per pixel) */
+
+// column histograms (per channel) are 16 coarse bins + 256 fine bins
+// the kernel keeps coarse bins up to date and refreshes a fine bucket only when the median falls in it
+typedef struct {
+    int radius, w, ps;
+    uint16_t* column_coarse; // [w * ps][16]
+    uint16_t* column_fine;   // [w * ps][256]
+    uint32_t coarse[16];
+    uint32_t fine[16][16];
+    int last_update[16];     // kernel position where each fine bucket was valid
+} __SB3_DEV_median_histogram_t;
+
+void __SB3_DEV_median_column_update(__SB3_DEV_median_histogram_t* h, const uint8_t* row, int add)
+{
+    for(int j = 0; j < h->w * h->ps; j++)
+    {
+        h->column_coarse[j * 16 + (row[j] >> 4)] += add;
+        h->column_fine[j * 256 + row[j]] += add;
+    }
+}
+
+static inline int __SB3_DEV_median_clamp(int x, int w)
+{
+    return x < 0 ? 0 : x >= w ? w - 1 : x;
+}
+
+void __SB3_DEV_median_fine_update(__SB3_DEV_median_histogram_t* h, int c, int bucket, int x)
+{
+    uint32_t* fine = h->fine[bucket];
+    int r = h->radius, last = h->last_update[bucket];
+    if(x - last > 2 * r + 1)
+    {
+        memset(fine, 0, 16 * sizeof(uint32_t));
+        for(int dx = -r; dx <= r; dx++)
+        {
+            const uint16_t* col = h->column_fine + (__SB3_DEV_median_clamp(x + dx, h->w) * h->ps + c) * 256 + bucket * 16;
+            for(int i = 0; i < 16; i++)
+                fine[i] += col[i];
+        }
+    }
+    else
+    {
+        for(int t = last + 1; t <= x; t++)
+        {
+            const uint16_t* in = h->column_fine + (__SB3_DEV_median_clamp(t + r, h->w) * h->ps + c) * 256 + bucket * 16;
+            const uint16_t* out = h->column_fine + (__SB3_DEV_median_clamp(t - r - 1, h->w) * h->ps + c) * 256 + bucket * 16;
+            for(int i = 0; i < 16; i++)
+                fine[i] += in[i] - out[i];
+        }
+    }
+    h->last_update[bucket] = x;
+}
+
+void __SB3_DEV_median_histogram_row(__SB3_DEV_median_histogram_t* h, uint8_t* out)
+{
+    int r = h->radius, ps = h->ps;
+    uint32_t target = ((2 * r + 1) * (2 * r + 1)) / 2 + 1;
+    for(int c = 0; c < ps; c++)
+    {
+        memset(h->coarse, 0, sizeof(h->coarse));
+        for(int dx = -r; dx <= r; dx++)
+        {
+            const uint16_t* col = h->column_coarse + (__SB3_DEV_median_clamp(dx, h->w) * ps + c) * 16;
+            for(int i = 0; i < 16; i++)
+                h->coarse[i] += col[i];
+        }
+        for(int b = 0; b < 16; b++)
+            h->last_update[b] = -4 * r - 4;
+
+        for(int x = 0; x < h->w; x++)
+        {
+            if(x)
+            {
+                const uint16_t* in = h->column_coarse + (__SB3_DEV_median_clamp(x + r, h->w) * ps + c) * 16;
+                const uint16_t* old = h->column_coarse + (__SB3_DEV_median_clamp(x - r - 1, h->w) * ps + c) * 16;
+                for(int i = 0; i < 16; i++)
+                    h->coarse[i] += in[i] - old[i];
+            }
+            uint32_t sum = 0;
+            int b = 0;
+            while(sum + h->coarse[b] < target)
+                sum += h->coarse[b++];
+            __SB3_DEV_median_fine_update(h, c, b, x);
+            int i = 0;
+            while(sum + h->fine[b][i] < target)
+                sum += h->fine[b][i++];
+            out[x * ps + c] = b * 16 + i;
+        }
+    }
+}
+
+/* FILTER */
+
+void __SB3_DEV_median_filter(SB3_DEV_image_t* image, uint8_t* output, unsigned int kernel_radius)
+{
+    int ps = __SB3_DEV_pixel_size(image->format), r = kernel_radius;
+    size_t row_bytes = (size_t)image->w * ps;
+    if(r == 0)
+    {
+        for(int y = 0; output != image->pixels && y < image->h; y++)
+            memcpy(output + y * row_bytes, __SB3_DEV_row(image, y), row_bytes);
+        return;
+    }
+    __SB3_DEV_median_rows_t rows = {
+        .image = image,
+        .radius = r,
+        .size = (image->w + 2 * r) * ps,
+        .capacity = 2 * r + 2,
+        .next = -r - 1,
+    };
+    rows.rows = __SB3_DEV_malloc((size_t)rows.size * rows.capacity);
+
+    if(r <= 2)
+    {
+        uint8_t network[256][2];
+        int count = 19;
+        if(r == 1)
+            memcpy(network, __SB3_DEV_median9_network, sizeof(__SB3_DEV_median9_network));
+        else
+            count = __SB3_DEV_batcher_network(25, network);
+        for(int y = 0; y < image->h; y++)
+        {
+            __SB3_DEV_median_load(&rows, y + r);
+            __SB3_DEV_median_network_row(&rows, y, output + y * row_bytes, (const uint8_t(*)[2])network, count);
+        }
+    }
+    else
+    {
+        __SB3_DEV_median_histogram_t h = {
+            .radius = r,
+            .w = image->w,
+            .ps = ps,
+            .column_coarse = __SB3_DEV_calloc(row_bytes * 16, sizeof(uint16_t)),
+            .column_fine = __SB3_DEV_calloc(row_bytes * 256, sizeof(uint16_t)),
+        };
+        __SB3_DEV_median_load(&rows, r);
+        for(int y = -r; y <= r; y++)
+            __SB3_DEV_median_column_update(&h, __SB3_DEV_median_row(&rows, y) + r * ps, 1);
+        for(int y = 0; y < image->h; y++)
+        {
+            if(y)
+            {
+                __SB3_DEV_median_load(&rows, y + r);
+                __SB3_DEV_median_column_update(&h, __SB3_DEV_median_row(&rows, y - r - 1) + r * ps, -1);
+                __SB3_DEV_median_column_update(&h, __SB3_DEV_median_row(&rows, y + r) + r * ps, 1);
+            }
+            __SB3_DEV_median_histogram_row(&h, output + y * row_bytes);
+        }
+        __SB3_DEV_free(h.column_coarse);
+        __SB3_DEV_free(h.column_fine);
+    }
+    __SB3_DEV_free(rows.rows);
+}
+
+SB3_DEV_image_t* SB3_DEV_median_filter(SB3_DEV_image_t* image, unsigned int kernel_radius)
+{
+    if(!image)
+    {
+        #ifdef SB3_DEV_CRASH_WHEN_ERROR
+            errx(EXIT_FAILURE, "MEDIAN_FILTER: NULL image");
+        #else
+            SB3_DEV_SetError(SB3_DEV_NULL_IMAGE_ERROR);
+            return NULL;
+        #endif
+    }
+    SB3_DEV_image_t* res = SB3_DEV_NewImage(image->w, image->h, image->format);
+    __SB3_DEV_median_filter(image, res->pixels, kernel_radius);
+    SB3_DEV_SetError(SB3_DEV_SUCCESS_EXIT);
+    return res;
+}
+
+void SB3_DEV_apply_median_filter(SB3_DEV_image_t* image, unsigned int kernel_radius)
+{
+    if(!image)
+    {
+        #ifdef SB3_DEV_CRASH_WHEN_ERROR
+            errx(EXIT_FAILURE, "MEDIAN_FILTER: NULL image");
+        #else
+            SB3_DEV_SetError(SB3_DEV_NULL_IMAGE_ERROR);
+            return;
+        #endif
+    }
+    __SB3_DEV_writable(image, 1);
+    __SB3_DEV_median_filter(image, image->pixels, kernel_radius);
+    SB3_DEV_SetError(SB3_DEV_SUCCESS_EXIT);
+}
@@ -0,0 +1,317 @@
+/*
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 AyAztuB
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ *
+ * AUTHOR
+ *
+ * AyAztuB (ayaztub@gmail.com) from https://github.com/AyAztuB/SB3-Project
+ *
+ */
+
+
+#include "sb3_dev_internal.h"
+#include <err.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/* PACKED BITMAP */
+
+// bit x % 64 of word x / 64 is pixel x (1 = white), each row is padded to a whole word
+typedef struct {
+    int w, h, words;
+    uint64_t* bits;
+} __SB3_DEV_bitmap_t;
+
+__SB3_DEV_bitmap_t __SB3_DEV_pack(SB3_DEV_image_t* image)
+{
+    __SB3_DEV_bitmap_t bm = {
+        .w = image->w,
+        .h = image->h,
+        .words = (image->w + 63) / 64,
+    };
+    bm.bits = __SB3_DEV_calloc((size_t)bm.words * bm.h, sizeof(uint64_t));
+    for(int y = 0; y < bm.h; y++)
+    {
+        const uint8_t* src = __SB3_DEV_row(image, y);
+        uint64_t* dst = bm.bits + (size_t)y * bm.words;
+        int x = 0;
+#ifdef __SSE2__
+        // 255 has its high bit set: movemask gives 16 pixels at once
+        for(; x + 16 <= bm.w; x += 16)
+            dst[x / 64] |= (uint64_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)(src + x))) << (x % 64);
+#endif
+        for(; x < bm.w; x++)
+            dst[x / 64] |= (uint64_t)(src[x] >> 7) << (x % 64);
+    }
+    return bm;
+}
+
+void __SB3_DEV_unpack(__SB3_DEV_bitmap_t* bm, SB3_DEV_image_t* image)
+{
+    for(int y = 0; y < bm->h; y++)
+    {
+        const uint64_t* src = bm->bits + (size_t)y * bm->words;
+        uint8_t* dst = __SB3_DEV_row(image, y);
+        for(int x = 0; x < bm->w; x++)
+            dst[x] = -(uint8_t)((src[x / 64] >> (x % 64)) & 1);
+    }
+}
+
+// bits after the last pixel of each row take the border value
+void __SB3_DEV_bitmap_pad(__SB3_DEV_bitmap_t* bm, uint64_t fill)
+{
+    if(bm->w % 64 == 0)
+        return;
+    uint64_t mask = ~(uint64_t)0 << (bm->w % 64);
+    for(int y = 0; y < bm->h; y++)
+    {
+        uint64_t* last = bm->bits + (size_t)y * bm->words + bm->words - 1;
+        *last = (*last & ~mask) | (fill & mask);
+    }
+}
+
+// dst(x) = src(x + s), pixels outside of src are fill
+void __SB3_DEV_shift_row(const uint64_t* src, int src_words, uint64_t* dst, int dst_words, int s, uint64_t fill)
+{
+    int q = (s < 0 ? -s : s) / 64, b = (s < 0 ? -s : s) % 64;
+    for(int k = 0; k < dst_words; k++)
+    {
+        if(s >= 0)
+        {
+            uint64_t lo = k + q < src_words ? src[k + q] : fill;
+            uint64_t hi = k + q + 1 < src_words ? src[k + q + 1] : fill;
+            dst[k] = b ? (lo >> b) | (hi << (64 - b)) : lo;
+        }
+        else
+        {
+            uint64_t hi = k - q >= 0 && k - q < src_words ? src[k - q] : fill;
+            uint64_t lo = k - q - 1 >= 0 && k - q - 1 < src_words ? src[k - q - 1] : fill;
+            dst[k] = b ? (hi << b) | (lo >> (64 - b)) : hi;
+        }
+    }
+}
+
+static inline void __SB3_DEV_combine(uint64_t* dst, const uint64_t* src, int words, char dilate)
+{
+    if(dilate)
+        for(int k = 0; k < words; k++)
+            dst[k] |= src[k];
+    else
+        for(int k = 0; k < words; k++)
+            dst[k] &= src[k];
+}
+
+/* HORIZONTAL AND VERTICAL PASSES */
+
+// window of 2r+1 pixels by doubling: runs of k pixels combine into runs of 2k (O(log r) word operations)
+void __SB3_DEV_horizontal(__SB3_DEV_bitmap_t* bm, int r, char dilate)
+{
+    if(r == 0)
+        return;
+    uint64_t fill = dilate ? 0 : ~(uint64_t)0;
+    int words = bm->words, length = 2 * r + 1;
+    // working rows start r pixels before the image row: the window of pixel x starts at x
+    int ext = (bm->w + 2 * r + 63) / 64;
+    uint64_t* run = __SB3_DEV_malloc(2 * ext * sizeof(uint64_t));
+    uint64_t* tmp = run + ext;
+    __SB3_DEV_bitmap_pad(bm, fill);
+    for(int y = 0; y < bm->h; y++)
+    {
+        uint64_t* row = bm->bits + (size_t)y * words;
+        __SB3_DEV_shift_row(row, words, run, ext, -r, fill);
+        int k = 1;
+        for(; 2 * k <= length; k *= 2)
+        {
+            __SB3_DEV_shift_row(run, ext, tmp, ext, k, fill);
+            __SB3_DEV_combine(run, tmp, ext, dilate);
+        }
+        if(k < length)
+        {
+            // the two runs of k pixels overlap to cover the whole window
+            __SB3_DEV_shift_row(run, ext, tmp, ext, length - k, fill);
+            __SB3_DEV_combine(run, tmp, ext, dilate);
+        }
+        memcpy(row, run, words * sizeof(uint64_t));
+    }
+    __SB3_DEV_free(run);
+}
+
+// van Herk / Gil-Werman on whole words: 3 word operations per word whatever r is
+void __SB3_DEV_vertical(__SB3_DEV_bitmap_t* bm, int r, char dilate)
+{
+    if(r == 0)
+        return;
+    uint64_t fill = dilate ? 0 : ~(uint64_t)0;
+    int words = bm->words, p = 2 * r + 1, n = bm->h + 2 * r;
+    // padded row t is image row t - r, cut in blocks of p rows
+    uint64_t* prefix = __SB3_DEV_malloc((size_t)n * words * sizeof(uint64_t));
+    uint64_t* suffix = __SB3_DEV_malloc((size_t)n * words * sizeof(uint64_t));
+    #define __SB3_DEV_PADDED(t, k) ((t) - r >= 0 && (t) - r < bm->h ? bm->bits[(size_t)((t) - r) * words + (k)] : fill)
+    for(int t = 0; t < n; t++)
+    {
+        uint64_t* g = prefix + (size_t)t * words;
+        for(int k = 0; k < words; k++)
+            g[k] = __SB3_DEV_PADDED(t, k);
+        if(t % p)
+            __SB3_DEV_combine(g, g - words, words, dilate);
+    }
+    for(int t = n - 1; t >= 0; t--)
+    {
+        uint64_t* h = suffix + (size_t)t * words;
+        for(int k = 0; k < words; k++)
+            h[k] = __SB3_DEV_PADDED(t, k);
+        if(t % p != p - 1 && t + 1 < n)
+            __SB3_DEV_combine(h, h + words, words, dilate);
+    }
+    #undef __SB3_DEV_PADDED
+    for(int y = 0; y < bm->h; y++)
+    {
+        uint64_t* row = bm->bits + (size_t)y * words;
+        memcpy(row, suffix + (size_t)y * words, words * sizeof(uint64_t));
+        __SB3_DEV_combine(row, prefix + (size_t)(y + 2 * r) * words, words, dilate);
+    }
+    __SB3_DEV_free(prefix);
+    __SB3_DEV_free(suffix);
+}
+
+void __SB3_DEV_morphology(__SB3_DEV_bitmap_t* bm, SB3_DEV_structuring_element_t element,
+        int rx, int ry, char dilate)
+{
+    if(element == SB3_DEV_RECT_ELEMENT)
+    {
+        // separable: a rectangle is a vertical segment followed by a horizontal one
+        __SB3_DEV_vertical(bm, ry, dilate);
+        __SB3_DEV_horizontal(bm, rx, dilate);
+        return;
+    }
+    // a cross is the union of its 2 arms: combine both passes on the same input
+    size_t size = (size_t)bm->words * bm->h;
+    __SB3_DEV_bitmap_t arm = *bm;
+    arm.bits = __SB3_DEV_malloc(size * sizeof(uint64_t));
+    memcpy(arm.bits, bm->bits, size * sizeof(uint64_t));
+    __SB3_DEV_vertical(&arm, ry, dilate);
+    __SB3_DEV_horizontal(bm, rx, dilate);
+    for(int y = 0; y < bm->h; y++)
+        __SB3_DEV_combine(bm->bits + (size_t)y * bm->words, arm.bits + (size_t)y * bm->words, bm->words, dilate);
+    __SB3_DEV_free(arm.bits);
+}
+
+/* API */
+
+// operations: 0 erode, 1 dilate, 2 open, 3 close
+SB3_DEV_errors_t __SB3_DEV_binary_morphology(SB3_DEV_image_t* image, SB3_DEV_image_t* res,
+        SB3_DEV_structuring_element_t element, unsigned int radius_x, unsigned int radius_y, int operation)
+{
+    if(!image)
+    {
+        #ifdef SB3_DEV_CRASH_WHEN_ERROR
+            errx(EXIT_FAILURE, "MORPHOLOGY: NULL image");
+        #else
+            SB3_DEV_SetError(SB3_DEV_NULL_IMAGE_ERROR);
+            return SB3_DEV_NULL_IMAGE_ERROR;
+        #endif
+    }
+    if(image->format != SB3_DEV_BINARY_COLOR_FORMAT)
+    {
+        #ifdef SB3_DEV_CRASH_WHEN_ERROR
+            errx(EXIT_FAILURE, "MORPHOLOGY: invalid image format (expected binary image)");
+        #else
+            SB3_DEV_SetError(SB3_DEV_BAD_FORMAT_ERROR);
+            return SB3_DEV_BAD_FORMAT_ERROR;
+        #endif
+    }
+    __SB3_DEV_bitmap_t bm = __SB3_DEV_pack(image);
+    char first = operation == 1 || operation == 3;
+    __SB3_DEV_morphology(&bm, element, radius_x, radius_y, first);
+    if(operation >= 2)
+        __SB3_DEV_morphology(&bm, element, radius_x, radius_y, !first);
+    __SB3_DEV_writable(res, 0);
+    __SB3_DEV_unpack(&bm, res);
+    __SB3_DEV_free(bm.bits);
+    SB3_DEV_SetError(SB3_DEV_SUCCESS_EXIT);
+    return SB3_DEV_SUCCESS_EXIT;
+}
+
+SB3_DEV_image_t* __SB3_DEV_new_binary_morphology(SB3_DEV_image_t* image,
+        SB3_DEV_structuring_element_t element, unsigned int radius_x, unsigned int radius_y, int operation)
+{
+    SB3_DEV_image_t* res = image ? SB3_DEV_NewImage(image->w, image->h, SB3_DEV_BINARY_COLOR_FORMAT) : NULL;
+    if(__SB3_DEV_binary_morphology(image, res, element, radius_x, radius_y, operation) != SB3_DEV_SUCCESS_EXIT)
+    {
+        if(res)
+            SB3_DEV_FreeImage(res);
+        return NULL;
+    }
+    return res;
+}
+
+SB3_DEV_image_t* SB3_DEV_erode(SB3_DEV_image_t* image, SB3_DEV_structuring_element_t element,
+        unsigned int radius_x, unsigned int radius_y)
+{
+    return __SB3_DEV_new_binary_morphology(image, element, radius_x, radius_y, 0);
+}
+
+SB3_DEV_errors_t SB3_DEV_apply_erode(SB3_DEV_image_t* image, SB3_DEV_structuring_element_t element,
+        unsigned int radius_x, unsigned int radius_y)
+{
+    return __SB3_DEV_binary_morphology(image, image, element, radius_x, radius_y, 0);
+}
+
+SB3_DEV_image_t* SB3_DEV_dilate(SB3_DEV_image_t* image, SB3_DEV_structuring_element_t element,
+        unsigned int radius_x, unsigned int radius_y)
+{
+    return __SB3_DEV_new_binary_morphology(image, element, radius_x, radius_y, 1);
+}
+
+SB3_DEV_errors_t SB3_DEV_apply_dilate(SB3_DEV_image_t* image, SB3_DEV_structuring_element_t element,
+        unsigned int radius_x, unsigned int radius_y)
+{
+    return __SB3_DEV_binary_morphology(image, image, element, radius_x, radius_y, 1);
+}
+
+SB3_DEV_image_t* SB3_DEV_open(SB3_DEV_image_t* image, SB3_DEV_structuring_element_t element,
+        unsigned int radius_x, unsigned int radius_y)
+{
+    return __SB3_DEV_new_binary_morphology(image, element, radius_x, radius_y, 2);
+}
+
+SB3_DEV_errors_t SB3_DEV_apply_open(SB3_DEV_image_t* image, SB3_DEV_structuring_element_t element,
+        unsigned int radius_x, unsigned int radius_y)
+{
+    return __SB3_DEV_binary_morphology(image, image, element, radius_x, radius_y, 2);
+}
+
+SB3_DEV_image_t* SB3_DEV_close(SB3_DEV_image_t* image, SB3_DEV_structuring_element_t element,
+        unsigned int radius_x, unsigned int radius_y)
+{
+    return __SB3_DEV_new_binary_morphology(image, element, radius_x, radius_y, 3);
+}
+
+SB3_DEV_errors_t SB3_DEV_apply_close(SB3_DEV_image_t* image, SB3_DEV_structuring_element_t element,
+        unsigned int radius_x, unsigned int radius_y)
+{
+    return __SB3_DEV_binary_morphology(image, image, element, radius_x, radius_y, 3);
+}
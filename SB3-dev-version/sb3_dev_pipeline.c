@@ -0,0 +1,398 @@
+/*
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 AyAztuB
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ *
+ * AUTHOR
+ *
+ * AyAztuB (ayaztub@gmail.com) from https://github.com/AyAztuB/SB3-Project
+ *
+ */
+
+
+#include "sb3_dev_internal.h"
+#include <err.h>
+#include <string.h>
+
+/* STAGES */
+
+typedef enum {
+    __SB3_DEV_GRAYSCALE_STAGE,
+    __SB3_DEV_GAUSSIAN_BLUR_STAGE,
+    __SB3_DEV_CONVOLUTION_STAGE,
+    __SB3_DEV_THRESHOLD_STAGE,
+    __SB3_DEV_MEAN_THRESHOLD_STAGE,
+} __SB3_DEV_stage_type_t;
+
+// rows are pulled from the last stage: each stage computes its rows on demand in a ring
+// holding only the rows its consumer still needs (the last stage writes in the output image)
+typedef struct {
+    __SB3_DEV_stage_type_t type;
+    int radius;                   // rows needed above and below in the input
+    double boost;                 // grayscale
+    uint8_t level;                // threshold
+    int offset;                   // mean threshold
+    unsigned int dim;             // convolution
+    double* weights;              // convolution (dim * dim) or gaussian (2 * radius + 1)
+    // set by SB3_DEV_pipeline_run
+    SB3_DEV_image_format_t format;
+    uint8_t lut[256];
+    uint8_t* ring;
+    int capacity, next;
+    float* work;
+    uint32_t* sums;
+} __SB3_DEV_stage_t;
+
+struct SB3_DEV_pipeline_s {
+    int count, capacity;
+    __SB3_DEV_stage_t* stages;
+    SB3_DEV_image_t* source;
+};
+
+SB3_DEV_pipeline_t* SB3_DEV_NewPipeline(void)
+{
+    SB3_DEV_pipeline_t* pipeline = __SB3_DEV_malloc(sizeof(*pipeline));
+    *pipeline = (SB3_DEV_pipeline_t) {
+        .count = 0,
+        .capacity = 4,
+        .stages = __SB3_DEV_malloc(4 * sizeof(__SB3_DEV_stage_t)),
+        .source = NULL,
+    };
+    return pipeline;
+}
+
+void SB3_DEV_FreePipeline(SB3_DEV_pipeline_t* pipeline)
+{
+    for(int i = 0; i < pipeline->count; i++)
+        __SB3_DEV_free(pipeline->stages[i].weights);
+    __SB3_DEV_free(pipeline->stages);
+    __SB3_DEV_free(pipeline);
+}
+
+SB3_DEV_errors_t __SB3_DEV_pipeline_add(SB3_DEV_pipeline_t* pipeline, __SB3_DEV_stage_t stage)
+{
+    if(!pipeline)
+    {
+        __SB3_DEV_free(stage.weights);
+        #ifdef SB3_DEV_CRASH_WHEN_ERROR
+            errx(EXIT_FAILURE, "PIPELINE: NULL pipeline");
+        #else
+            SB3_DEV_SetError(SB3_DEV_NULL_PIPELINE_ERROR);
+            return SB3_DEV_NULL_PIPELINE_ERROR;
+        #endif
+    }
+    if(pipeline->count == pipeline->capacity)
+    {
+        pipeline->capacity *= 2;
+        pipeline->stages = __SB3_DEV_realloc(pipeline->stages, pipeline->capacity * sizeof(__SB3_DEV_stage_t));
+    }
+    pipeline->stages[pipeline->count++] = stage;
+    return SB3_DEV_SUCCESS_EXIT;
+}
+
+SB3_DEV_errors_t SB3_DEV_pipeline_grayscale(SB3_DEV_pipeline_t* pipeline, double boost)
+{
+    return __SB3_DEV_pipeline_add(pipeline, (__SB3_DEV_stage_t) {
+        .type = __SB3_DEV_GRAYSCALE_STAGE,
+        .boost = boost,
+    });
+}
+
+SB3_DEV_errors_t SB3_DEV_pipeline_gaussian_blur(SB3_DEV_pipeline_t* pipeline, unsigned int kernel_radius)
+{
+    // the 2d kernel of SB3_DEV_gaussian_kernel is the product of this one by itself
+    size_t size = (2 * kernel_radius + 1) * sizeof(double);
+    double* weights = __SB3_DEV_malloc(size);
+    memcpy(weights, SB3_DEV_cached_gaussian_weights(kernel_radius, 0), size);
+    return __SB3_DEV_pipeline_add(pipeline, (__SB3_DEV_stage_t) {
+        .type = __SB3_DEV_GAUSSIAN_BLUR_STAGE,
+        .radius = kernel_radius,
+        .weights = weights,
+    });
+}
+
+SB3_DEV_errors_t SB3_DEV_pipeline_convolution(SB3_DEV_pipeline_t* pipeline, SB3_DEV_kernel_t* kernel)
+{
+    // the kernel is copied: it can be freed after this call
+    double* weights = __SB3_DEV_malloc(kernel->dim * kernel->dim * sizeof(double));
+    memcpy(weights, kernel->kernel, kernel->dim * kernel->dim * sizeof(double));
+    return __SB3_DEV_pipeline_add(pipeline, (__SB3_DEV_stage_t) {
+        .type = __SB3_DEV_CONVOLUTION_STAGE,
+        .radius = (kernel->dim - 1) / 2,
+        .dim = kernel->dim,
+        .weights = weights,
+    });
+}
+
+SB3_DEV_errors_t SB3_DEV_pipeline_threshold(SB3_DEV_pipeline_t* pipeline, uint8_t level)
+{
+    return __SB3_DEV_pipeline_add(pipeline, (__SB3_DEV_stage_t) {
+        .type = __SB3_DEV_THRESHOLD_STAGE,
+        .level = level,
+    });
+}
+
+SB3_DEV_errors_t SB3_DEV_pipeline_mean_threshold(SB3_DEV_pipeline_t* pipeline, unsigned int radius, int offset)
+{
+    return __SB3_DEV_pipeline_add(pipeline, (__SB3_DEV_stage_t) {
+        .type = __SB3_DEV_MEAN_THRESHOLD_STAGE,
+        .radius = radius,
+        .offset = offset,
+    });
+}
+
+/* EXECUTION */
+
+static inline int __SB3_DEV_clamp(int v, int max)
+{
+    return v < 0 ? 0 : v >= max ? max - 1 : v;
+}
+
+static inline uint8_t __SB3_DEV_saturate(double v)
+{
+    return v <= 0 ? 0 : v >= 255 ? 255 : (uint8_t)v;
+}
+
+SB3_DEV_image_format_t __SB3_DEV_stage_input_format(SB3_DEV_pipeline_t* pipeline, int index)
+{
+    return index ? pipeline->stages[index - 1].format : pipeline->source->format;
+}
+
+void __SB3_DEV_stage_compute(SB3_DEV_pipeline_t* pipeline, int index, int y, uint8_t* out);
+
+// row y of stage index (-1 is the source image)
+const uint8_t* __SB3_DEV_stage_row(SB3_DEV_pipeline_t* pipeline, int index, int y)
+{
+    if(index < 0)
+        return __SB3_DEV_row(pipeline->source, y);
+    __SB3_DEV_stage_t* stage = pipeline->stages + index;
+    int size = pipeline->source->w * __SB3_DEV_pixel_size(stage->format);
+    for(; stage->next <= y; stage->next++)
+        __SB3_DEV_stage_compute(pipeline, index, stage->next,
+            stage->ring + (size_t)(stage->next % stage->capacity) * size);
+    return stage->ring + (size_t)(y % stage->capacity) * size;
+}
+
+void __SB3_DEV_stage_compute(SB3_DEV_pipeline_t* pipeline, int index, int y, uint8_t* out)
+{
+    __SB3_DEV_stage_t* stage = pipeline->stages + index;
+    int w = pipeline->source->w, h = pipeline->source->h, r = stage->radius;
+    SB3_DEV_image_format_t input_format = __SB3_DEV_stage_input_format(pipeline, index);
+    int ps = __SB3_DEV_pixel_size(input_format);
+
+    switch(stage->type)
+    {
+        case __SB3_DEV_GRAYSCALE_STAGE:
+        {
+            const uint8_t* in = __SB3_DEV_stage_row(pipeline, index - 1, y);
+            __SB3_DEV_rgb_to_gray(in, out, w, stage->lut);
+            break;
+        }
+        case __SB3_DEV_THRESHOLD_STAGE:
+        {
+            const uint8_t* in = __SB3_DEV_stage_row(pipeline, index - 1, y);
+            if(ps == 3)
+            {
+                __SB3_DEV_rgb_to_gray(in, out, w, NULL);
+                in = out;
+            }
+            for(int x = 0; x < w; x++)
+                out[x] = -(in[x] > stage->level);
+            break;
+        }
+        case __SB3_DEV_GAUSSIAN_BLUR_STAGE:
+        {
+            // vertical pass in floats, then horizontal pass from the float row
+            float* acc = stage->work;
+            memset(acc, 0, (size_t)w * ps * sizeof(float));
+            for(int k = -r; k <= r; k++)
+            {
+                const uint8_t* in = __SB3_DEV_stage_row(pipeline, index - 1, __SB3_DEV_clamp(y + k, h));
+                float weight = stage->weights[k + r];
+                for(int j = 0; j < w * ps; j++)
+                    acc[j] += weight * in[j];
+            }
+            for(int x = 0; x < w; x++)
+                for(int c = 0; c < ps; c++)
+                {
+                    double v = 0;
+                    for(int k = -r; k <= r; k++)
+                        v += stage->weights[k + r] * acc[__SB3_DEV_clamp(x + k, w) * ps + c];
+                    out[x * ps + c] = __SB3_DEV_saturate(v + 0.5);
+                }
+            break;
+        }
+        case __SB3_DEV_CONVOLUTION_STAGE:
+        {
+            // same taps as __SB3_DEV_convolution: the (2 * r + 1)^2 top left weights (even dims drop the last row and column)
+            const uint8_t* rows[2 * r + 1];
+            for(int k = -r; k <= r; k++)
+                rows[k + r] = __SB3_DEV_stage_row(pipeline, index - 1, __SB3_DEV_clamp(y + k, h));
+            for(int x = 0; x < w; x++)
+                for(int c = 0; c < ps; c++)
+                {
+                    double v = 0;
+                    for(int n = 0; n <= 2 * r; n++)
+                        for(int m = -r; m <= r; m++)
+                            v += stage->weights[n * stage->dim + m + r] * rows[n][__SB3_DEV_clamp(x + m, w) * ps + c];
+                    out[x * ps + c] = __SB3_DEV_saturate(v);
+                }
+            break;
+        }
+        case __SB3_DEV_MEAN_THRESHOLD_STAGE:
+        {
+            // column sums of the window rows (clipped to the image like SB3_DEV_mean_threshold)
+            uint32_t* sums = stage->sums;
+            int y0 = y - r < 0 ? 0 : y - r, y1 = y + r >= h ? h - 1 : y + r;
+            if(y == 0)
+            {
+                memset(sums, 0, w * sizeof(uint32_t));
+                for(int k = 0; k <= y1; k++)
+                {
+                    const uint8_t* in = __SB3_DEV_stage_row(pipeline, index - 1, k);
+                    for(int x = 0; x < w; x++)
+                        sums[x] += ps == 3 ? __SB3_DEV_luma(in[3 * x], in[3 * x + 1], in[3 * x + 2]) : in[x];
+                }
+            }
+            else
+            {
+                if(y + r < h)
+                {
+                    const uint8_t* in = __SB3_DEV_stage_row(pipeline, index - 1, y + r);
+                    for(int x = 0; x < w; x++)
+                        sums[x] += ps == 3 ? __SB3_DEV_luma(in[3 * x], in[3 * x + 1], in[3 * x + 2]) : in[x];
+                }
+                if(y - r - 1 >= 0)
+                {
+                    const uint8_t* in = __SB3_DEV_stage_row(pipeline, index - 1, y - r - 1);
+                    for(int x = 0; x < w; x++)
+                        sums[x] -= ps == 3 ? __SB3_DEV_luma(in[3 * x], in[3 * x + 1], in[3 * x + 2]) : in[x];
+                }
+            }
+            const uint8_t* in = __SB3_DEV_stage_row(pipeline, index - 1, y);
+            int64_t sum = 0;
+            for(int x = 0; x < r && x < w; x++)
+                sum += sums[x];
+            for(int x = 0; x < w; x++)
+            {
+                if(x + r < w)
+                    sum += sums[x + r];
+                if(x - r - 1 >= 0)
+                    sum -= sums[x - r - 1];
+                int x0 = x - r < 0 ? 0 : x - r, x1 = x + r >= w ? w - 1 : x + r;
+                int64_t area = (int64_t)(x1 - x0 + 1) * (y1 - y0 + 1);
+                int gray = ps == 3 ? __SB3_DEV_luma(in[3 * x], in[3 * x + 1], in[3 * x + 2]) : in[x];
+                out[x] = -(gray * area > sum - stage->offset * area);
+            }
+            break;
+        }
+    }
+}
+
+SB3_DEV_image_t* SB3_DEV_pipeline_run(SB3_DEV_pipeline_t* pipeline, SB3_DEV_image_t* image)
+{
+    if(!pipeline)
+    {
+        #ifdef SB3_DEV_CRASH_WHEN_ERROR
+            errx(EXIT_FAILURE, "PIPELINE: NULL pipeline");
+        #else
+            SB3_DEV_SetError(SB3_DEV_NULL_PIPELINE_ERROR);
+            return NULL;
+        #endif
+    }
+    if(!image)
+    {
+        #ifdef SB3_DEV_CRASH_WHEN_ERROR
+            errx(EXIT_FAILURE, "PIPELINE: NULL image");
+        #else
+            SB3_DEV_SetError(SB3_DEV_NULL_IMAGE_ERROR);
+            return NULL;
+        #endif
+    }
+
+    // formats along the chain
+    SB3_DEV_image_format_t format = image->format;
+    for(int i = 0; i < pipeline->count; i++)
+    {
+        __SB3_DEV_stage_t* stage = pipeline->stages + i;
+        if(stage->type == __SB3_DEV_GRAYSCALE_STAGE && format != SB3_DEV_RGB_FORMAT)
+        {
+            #ifdef SB3_DEV_CRASH_WHEN_ERROR
+                errx(EXIT_FAILURE, "PIPELINE: invalid image format for grayscale stage %d (expected rgb image)", i);
+            #else
+                SB3_DEV_SetError(SB3_DEV_BAD_FORMAT_ERROR);
+                return NULL;
+            #endif
+        }
+        if(stage->type == __SB3_DEV_GRAYSCALE_STAGE)
+            format = SB3_DEV_MONO_COLOR_FORMAT;
+        else if(stage->type == __SB3_DEV_THRESHOLD_STAGE || stage->type == __SB3_DEV_MEAN_THRESHOLD_STAGE)
+            format = SB3_DEV_BINARY_COLOR_FORMAT;
+        else if(format == SB3_DEV_BINARY_COLOR_FORMAT)
+            format = SB3_DEV_MONO_COLOR_FORMAT;
+        stage->format = format;
+    }
+
+    // rings sized by what the next stage reads
+    pipeline->source = image;
+    for(int i = 0; i < pipeline->count; i++)
+    {
+        __SB3_DEV_stage_t* stage = pipeline->stages + i;
+        int ps = __SB3_DEV_pixel_size(stage->format), in_ps = __SB3_DEV_pixel_size(__SB3_DEV_stage_input_format(pipeline, i));
+        stage->next = 0;
+        stage->capacity = 0;
+        stage->ring = NULL;
+        if(i + 1 < pipeline->count)
+        {
+            __SB3_DEV_stage_t* consumer = stage + 1;
+            stage->capacity = 2 * consumer->radius + 1 + (consumer->type == __SB3_DEV_MEAN_THRESHOLD_STAGE);
+            if(stage->capacity > image->h + 1)
+                stage->capacity = image->h + 1;
+            stage->ring = __SB3_DEV_malloc((size_t)stage->capacity * image->w * ps);
+        }
+        stage->work = stage->type == __SB3_DEV_GAUSSIAN_BLUR_STAGE ? __SB3_DEV_malloc((size_t)image->w * in_ps * sizeof(float)) : NULL;
+        stage->sums = stage->type == __SB3_DEV_MEAN_THRESHOLD_STAGE ? __SB3_DEV_malloc(image->w * sizeof(uint32_t)) : NULL;
+        if(stage->type == __SB3_DEV_GRAYSCALE_STAGE)
+            for(int v = 0; v < 256; v++)
+                stage->lut[v] = stage->boost ? __SB3_DEV_grayscale_boost(v, stage->boost) : v;
+    }
+
+    SB3_DEV_image_t* res = SB3_DEV_NewImage(image->w, image->h, format);
+    for(int y = 0; y < image->h; y++)
+    {
+        if(pipeline->count)
+            __SB3_DEV_stage_compute(pipeline, pipeline->count - 1, y, __SB3_DEV_row(res, y));
+        else
+            memcpy(__SB3_DEV_row(res, y), __SB3_DEV_row(image, y), (size_t)image->w * __SB3_DEV_pixel_size(format));
+    }
+
+    for(int i = 0; i < pipeline->count; i++)
+    {
+        __SB3_DEV_free(pipeline->stages[i].ring);
+        __SB3_DEV_free(pipeline->stages[i].work);
+        __SB3_DEV_free(pipeline->stages[i].sums);
+    }
+    pipeline->source = NULL;
+    SB3_DEV_SetError(SB3_DEV_SUCCESS_EXIT);
+    return res;
+}
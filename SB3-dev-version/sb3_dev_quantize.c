@@ -0,0 +1,290 @@
+/*
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 AyAztuB
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ *
+ * AUTHOR
+ *
+ * AyAztuB (ayaztub@gmail.com) from https://github.com/AyAztuB/SB3-Project
+ *
+ */
+
+
+
+#include "sb3_dev_internal.h"
+#include <err.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// colors are binned on 5 bits per channel for the median cut
+#define __SB3_DEV_BIN(r, g, b) ((((r) >> 3) << 10) | (((g) >> 3) << 5) | ((b) >> 3))
+#define __SB3_DEV_BINS 32768
+// direct-mapped cache of nearest palette entries (exact 24 bits colors)
+#define __SB3_DEV_CACHE_SIZE 4096
+
+typedef struct {
+    uint32_t count;
+    uint64_t r, g, b; // sums of the exact colors of the bin
+} __SB3_DEV_bin_t;
+
+typedef struct {
+    int start, end; // bins of the box in the sorted list
+    uint64_t count;
+} __SB3_DEV_box_t;
+
+// stable counting sort of list[start, end) on the 5 bits of channel
+void __SB3_DEV_sort_bins(uint16_t* list, int start, int end, int channel, uint16_t* tmp)
+{
+    int shift = 10 - 5 * channel, offsets[33] = { 0 };
+    for(int i = start; i < end; i++)
+        offsets[((list[i] >> shift) & 31) + 1]++;
+    for(int v = 0; v < 32; v++)
+        offsets[v + 1] += offsets[v];
+    for(int i = start; i < end; i++)
+        tmp[offsets[(list[i] >> shift) & 31]++] = list[i];
+    memcpy(list + start, tmp, (end - start) * sizeof(uint16_t));
+}
+
+// channel (0 r, 1 g, 2 b) with the widest range in the box, -1 if the box is a single bin
+int __SB3_DEV_box_channel(const uint16_t* list, const __SB3_DEV_box_t* box)
+{
+    int min[3] = { 31, 31, 31 }, max[3] = { 0, 0, 0 };
+    for(int i = box->start; i < box->end; i++)
+        for(int c = 0; c < 3; c++)
+        {
+            int v = (list[i] >> (10 - 5 * c)) & 31;
+            min[c] = v < min[c] ? v : min[c];
+            max[c] = v > max[c] ? v : max[c];
+        }
+    int best = -1, range = 0;
+    for(int c = 0; c < 3; c++)
+        if(max[c] - min[c] > range)
+        {
+            range = max[c] - min[c];
+            best = c;
+        }
+    return best;
+}
+
+// median cut over the binned histogram, return the palette size
+int __SB3_DEV_median_cut(const __SB3_DEV_bin_t* bins, int colors, SB3_DEV_RGBColor_t* palette)
+{
+    uint16_t* list = __SB3_DEV_malloc(2 * __SB3_DEV_BINS * sizeof(uint16_t));
+    int used = 0;
+    uint64_t total = 0;
+    for(int i = 0; i < __SB3_DEV_BINS; i++)
+        if(bins[i].count)
+        {
+            list[used++] = i;
+            total += bins[i].count;
+        }
+    __SB3_DEV_box_t boxes[256];
+    int count = 0;
+    if(used)
+        boxes[count++] = (__SB3_DEV_box_t) { .start = 0, .end = used, .count = total };
+    while(count < colors)
+    {
+        // most populated box that can still be split
+        int best = -1, channel = -1;
+        for(int i = 0; i < count; i++)
+        {
+            if(boxes[i].end - boxes[i].start < 2 || (best >= 0 && boxes[i].count <= boxes[best].count))
+                continue;
+            int c = __SB3_DEV_box_channel(list, &boxes[i]);
+            if(c >= 0)
+            {
+                best = i;
+                channel = c;
+            }
+        }
+        if(best < 0)
+            break;
+        __SB3_DEV_box_t* box = &boxes[best];
+        __SB3_DEV_sort_bins(list, box->start, box->end, channel, list + __SB3_DEV_BINS);
+        // split at the population median (both halves keep at least one bin)
+        uint64_t half = 0;
+        int split = box->start;
+        while(split < box->end - 1 && (half == 0 || 2 * (half + bins[list[split]].count) <= box->count))
+            half += bins[list[split++]].count;
+        boxes[count++] = (__SB3_DEV_box_t) { .start = split, .end = box->end, .count = box->count - half };
+        box->end = split;
+        box->count = half;
+    }
+    for(int i = 0; i < count; i++)
+    {
+        uint64_t r = 0, g = 0, b = 0, n = 0;
+        for(int j = boxes[i].start; j < boxes[i].end; j++)
+        {
+            const __SB3_DEV_bin_t* bin = &bins[list[j]];
+            r += bin->r;
+            g += bin->g;
+            b += bin->b;
+            n += bin->count;
+        }
+        palette[i] = (SB3_DEV_RGBColor_t) {
+            .r = (r + n / 2) / n,
+            .g = (g + n / 2) / n,
+            .b = (b + n / 2) / n,
+        };
+    }
+    __SB3_DEV_free(list);
+    return count;
+}
+
+// palette as padded int16 arrays for the nearest color search
+typedef struct {
+    int size;
+    int16_t r[256], g[256], b[256];
+} __SB3_DEV_search_t;
+
+int __SB3_DEV_nearest(const __SB3_DEV_search_t* search, int r, int g, int b)
+{
+    int best = 0;
+    uint32_t distance = UINT32_MAX;
+    int i = 0;
+#ifdef __SSE2__
+    // 8 entries per step: (dr, dg) and (db, 0) pairs squared and summed by madd
+    const __m128i vr = _mm_set1_epi16(r), vg = _mm_set1_epi16(g), vb = _mm_set1_epi16(b), zero = _mm_setzero_si128();
+    __m128i best_distance = _mm_set1_epi32(INT32_MAX), best_index = _mm_setzero_si128();
+    __m128i index_lo = _mm_setr_epi32(0, 1, 2, 3), index_hi = _mm_setr_epi32(4, 5, 6, 7), step = _mm_set1_epi32(8);
+    for(; i + 8 <= search->size; i += 8)
+    {
+        __m128i dr = _mm_sub_epi16(_mm_loadu_si128((const __m128i*)(search->r + i)), vr);
+        __m128i dg = _mm_sub_epi16(_mm_loadu_si128((const __m128i*)(search->g + i)), vg);
+        __m128i db = _mm_sub_epi16(_mm_loadu_si128((const __m128i*)(search->b + i)), vb);
+        __m128i lo = _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(dr, dg), _mm_unpacklo_epi16(dr, dg)),
+                                   _mm_madd_epi16(_mm_unpacklo_epi16(db, zero), _mm_unpacklo_epi16(db, zero)));
+        __m128i hi = _mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(dr, dg), _mm_unpackhi_epi16(dr, dg)),
+                                   _mm_madd_epi16(_mm_unpackhi_epi16(db, zero), _mm_unpackhi_epi16(db, zero)));
+        // distances are < 2^18: signed compares are enough
+        __m128i closer = _mm_cmplt_epi32(lo, best_distance);
+        best_distance = _mm_or_si128(_mm_and_si128(closer, lo), _mm_andnot_si128(closer, best_distance));
+        best_index = _mm_or_si128(_mm_and_si128(closer, index_lo), _mm_andnot_si128(closer, best_index));
+        closer = _mm_cmplt_epi32(hi, best_distance);
+        best_distance = _mm_or_si128(_mm_and_si128(closer, hi), _mm_andnot_si128(closer, best_distance));
+        best_index = _mm_or_si128(_mm_and_si128(closer, index_hi), _mm_andnot_si128(closer, best_index));
+        index_lo = _mm_add_epi32(index_lo, step);
+        index_hi = _mm_add_epi32(index_hi, step);
+    }
+    int32_t distances[4], indexes[4];
+    _mm_storeu_si128((__m128i*)distances, best_distance);
+    _mm_storeu_si128((__m128i*)indexes, best_index);
+    for(int k = 0; k < 4 && i; k++)
+        if((uint32_t)distances[k] < distance || ((uint32_t)distances[k] == distance && indexes[k] < best))
+        {
+            distance = distances[k];
+            best = indexes[k];
+        }
+#endif
+    for(; i < search->size; i++)
+    {
+        int dr = search->r[i] - r, dg = search->g[i] - g, db = search->b[i] - b;
+        uint32_t d = dr * dr + dg * dg + db * db;
+        if(d < distance)
+        {
+            distance = d;
+            best = i;
+        }
+    }
+    return best;
+}
+
+SB3_DEV_image_t* SB3_DEV_quantize(SB3_DEV_image_t* image, int colors)
+{
+    if(!image)
+    {
+        #ifdef SB3_DEV_CRASH_WHEN_ERROR
+            errx(EXIT_FAILURE, "QUANTIZE: NULL image");
+        #else
+            SB3_DEV_SetError(SB3_DEV_NULL_IMAGE_ERROR);
+            return NULL;
+        #endif
+    }
+    if(colors < 2 || colors > 256)
+    {
+        #ifdef SB3_DEV_CRASH_WHEN_ERROR
+            errx(EXIT_FAILURE, "QUANTIZE: palette size must be between 2 and 256 (received %d)", colors);
+        #else
+            SB3_DEV_SetError(SB3_DEV_BAD_FORMAT_ERROR);
+            return NULL;
+        #endif
+    }
+
+    // histogram of the binned colors, rows expanded to rgb whatever the format
+    __SB3_DEV_bin_t* bins = __SB3_DEV_calloc(__SB3_DEV_BINS, sizeof(__SB3_DEV_bin_t));
+    uint8_t* rgb = __SB3_DEV_malloc((size_t)image->w * 3);
+    for(int y = 0; y < image->h; y++)
+    {
+        SB3_DEV_expand_row(image, y, rgb);
+        for(int x = 0; x < image->w; x++)
+        {
+            uint8_t r = rgb[3*x], g = rgb[3*x+1], b = rgb[3*x+2];
+            __SB3_DEV_bin_t* bin = &bins[__SB3_DEV_BIN(r, g, b)];
+            bin->count++;
+            bin->r += r;
+            bin->g += g;
+            bin->b += b;
+        }
+    }
+
+    SB3_DEV_image_t* res = SB3_DEV_NewImage(image->w, image->h, SB3_DEV_INDEXED_FORMAT);
+    res->palette_size = __SB3_DEV_median_cut(bins, colors, res->palette);
+    if(!res->palette_size)
+        res->palette_size = 1; // empty image
+    __SB3_DEV_free(bins);
+
+    __SB3_DEV_search_t search = { .size = res->palette_size };
+    for(int i = 0; i < search.size; i++)
+    {
+        search.r[i] = res->palette[i].r;
+        search.g[i] = res->palette[i].g;
+        search.b[i] = res->palette[i].b;
+    }
+    // cache entries: 0x1rrggbb (0: empty) -> index
+    uint32_t* keys = __SB3_DEV_calloc(__SB3_DEV_CACHE_SIZE, sizeof(uint32_t));
+    uint8_t* values = __SB3_DEV_malloc(__SB3_DEV_CACHE_SIZE);
+    for(int y = 0; y < image->h; y++)
+    {
+        SB3_DEV_expand_row(image, y, rgb);
+        uint8_t* out = __SB3_DEV_row(res, y);
+        for(int x = 0; x < image->w; x++)
+        {
+            uint8_t r = rgb[3*x], g = rgb[3*x+1], b = rgb[3*x+2];
+            uint32_t key = 0x1000000 | (r << 16) | (g << 8) | b;
+            uint32_t slot = ((key * 2654435761u) >> 20) & (__SB3_DEV_CACHE_SIZE - 1);
+            if(keys[slot] != key)
+            {
+                keys[slot] = key;
+                values[slot] = __SB3_DEV_nearest(&search, r, g, b);
+            }
+            out[x] = values[slot];
+        }
+    }
+    __SB3_DEV_free(keys);
+    __SB3_DEV_free(values);
+    __SB3_DEV_free(rgb);
+    SB3_DEV_SetError(SB3_DEV_SUCCESS_EXIT);
+    return res;
+}
@@ -0,0 +1,83 @@
+/*
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 AyAztuB
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ *
+ * AUTHOR
+ *
+ * AyAztuB (ayaztub@gmail.com) from https://github.com/AyAztuB/SB3-Project
+ *
+ */
+
+
+
+#include "sb3_dev_internal.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+
+int __SB3_DEV_thread_count(int threads)
+{
+    if(threads > 0)
+        return threads;
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return cpus > 0 ? cpus : 1;
+}
+
+typedef struct {
+    atomic_int next;
+    int count;
+    void (*task)(void* context, int i);
+    void* context;
+    SB3_DEV_allocator_scope_t* scope; // of the caller, the workers allocate for it
+} __SB3_DEV_parallel_t;
+
+static void* __SB3_DEV_parallel_worker(void* arg)
+{
+    __SB3_DEV_parallel_t* parallel = arg;
+    SB3_DEV_allocator_scope_t* previous = SB3_DEV_SetAllocatorScope(parallel->scope);
+    int i;
+    while((i = atomic_fetch_add(&parallel->next, 1)) < parallel->count)
+        parallel->task(parallel->context, i);
+    SB3_DEV_SetAllocatorScope(previous);
+    return NULL;
+}
+
+void __SB3_DEV_parallel_for(int count, int threads, void (*task)(void* context, int i), void* context)
+{
+    if(count <= 0)
+        return;
+    threads = __SB3_DEV_thread_count(threads);
+    if(threads > count)
+        threads = count;
+    __SB3_DEV_parallel_t parallel = { .count = count, .task = task, .context = context, .scope = __SB3_DEV_allocator_scope() };
+    atomic_init(&parallel.next, 0);
+    pthread_t workers[threads];
+    int started = 0;
+    for(; started < threads - 1; started++)
+        if(pthread_create(&workers[started], NULL, __SB3_DEV_parallel_worker, &parallel))
+            break;
+    __SB3_DEV_parallel_worker(&parallel);
+    for(int t = 0; t < started; t++)
+        pthread_join(workers[t], NULL);
+}
@@ -0,0 +1,336 @@
+/*
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 AyAztuB
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ *
+ * AUTHOR
+ *
+ * AyAztuB (ayaztub@gmail.com) from https://github.com/AyAztuB/SB3-Project
+ *
+ */
+
+
+#include "sb3_dev_internal.h"
+#include <err.h>
+#include <math.h>
+
+/* SUMMED-AREA TABLE */
+
+__SB3_DEV_integral_t* __SB3_DEV_integral(SB3_DEV_image_t* image, char with_squares)
+{
+    int stride = image->w + 1;
+    size_t size = (size_t)stride * (image->h + 1);
+    char wide = 255 * (uint64_t)image->w * image->h > UINT32_MAX;
+    __SB3_DEV_integral_t* res = __SB3_DEV_malloc(sizeof(*res));
+    *res = (__SB3_DEV_integral_t) {
+        .w = image->w,
+        .h = image->h,
+        .sum = wide ? NULL : __SB3_DEV_calloc(size, sizeof(uint32_t)),
+        .wide_sum = wide ? __SB3_DEV_calloc(size, sizeof(uint64_t)) : NULL,
+        .squares = with_squares ? __SB3_DEV_calloc(size, sizeof(uint64_t)) : NULL,
+    };
+    uint8_t* buffer = __SB3_DEV_malloc(image->w);
+
+    for(int y = 0; y < image->h; y++)
+    {
+        const uint8_t* gray = __SB3_DEV_gray_row(image, y, buffer);
+        if(wide)
+        {
+            uint64_t* above = res->wide_sum + (size_t)y * stride + 1;
+            uint64_t* sum = above + stride;
+            uint64_t row_sum = 0;
+            for(int x = 0; x < image->w; x++)
+            {
+                row_sum += gray[x];
+                sum[x] = above[x] + row_sum;
+            }
+        }
+        else
+        {
+            uint32_t* above = res->sum + (size_t)y * stride + 1;
+            uint32_t* sum = above + stride;
+            uint32_t row_sum = 0;
+            for(int x = 0; x < image->w; x++)
+            {
+                row_sum += gray[x];
+                sum[x] = above[x] + row_sum;
+            }
+        }
+        if(with_squares)
+        {
+            uint64_t* above_sq = res->squares + (size_t)y * stride + 1;
+            uint64_t* squares = above_sq + stride;
+            uint64_t row_squares = 0;
+            for(int x = 0; x < image->w; x++)
+            {
+                row_squares += gray[x] * gray[x];
+                squares[x] = above_sq[x] + row_squares;
+            }
+        }
+    }
+    __SB3_DEV_free(buffer);
+    return res;
+}
+
+uint64_t* __SB3_DEV_integral_products(SB3_DEV_image_t* a, SB3_DEV_image_t* b)
+{
+    int stride = a->w + 1;
+    uint64_t* res = __SB3_DEV_calloc((size_t)stride * (a->h + 1), sizeof(uint64_t));
+    uint8_t* buffer = __SB3_DEV_malloc(2 * (size_t)a->w);
+
+    for(int y = 0; y < a->h; y++)
+    {
+        const uint8_t* gray_a = __SB3_DEV_gray_row(a, y, buffer);
+        const uint8_t* gray_b = __SB3_DEV_gray_row(b, y, buffer + a->w);
+        uint64_t* above = res + (size_t)y * stride + 1;
+        uint64_t* sum = above + stride;
+        uint64_t row_sum = 0;
+        for(int x = 0; x < a->w; x++)
+        {
+            row_sum += gray_a[x] * gray_b[x];
+            sum[x] = above[x] + row_sum;
+        }
+    }
+    __SB3_DEV_free(buffer);
+    return res;
+}
+
+void __SB3_DEV_FreeIntegral(__SB3_DEV_integral_t* integral)
+{
+    __SB3_DEV_free(integral->sum);
+    __SB3_DEV_free(integral->wide_sum);
+    __SB3_DEV_free(integral->squares);
+    __SB3_DEV_free(integral);
+}
+
+/* OUTPUT */
+
+// binary pixels are written in a new image (res != NULL), in the image storage or in a new block for rgb images
+uint8_t* __SB3_DEV_binary_output(SB3_DEV_image_t* image, SB3_DEV_image_t** res)
+{
+    if(res)
+    {
+        *res = SB3_DEV_NewImage(image->w, image->h, SB3_DEV_BINARY_COLOR_FORMAT);
+        return (*res)->pixels;
+    }
+    if(image->format != SB3_DEV_RGB_FORMAT)
+    {
+        __SB3_DEV_writable(image, 1);
+        return image->pixels;
+    }
+    return __SB3_DEV_pixels_alloc((size_t)image->w * image->h, 0);
+}
+
+void __SB3_DEV_binary_output_done(SB3_DEV_image_t* image, uint8_t* output, char in_place)
+{
+    if(!in_place)
+        return;
+    if(image->format == SB3_DEV_RGB_FORMAT)
+        __SB3_DEV_set_pixels(image, SB3_DEV_BINARY_COLOR_FORMAT, output);
+    else
+        image->format = SB3_DEV_BINARY_COLOR_FORMAT;
+}
+
+char __SB3_DEV_threshold_check(SB3_DEV_image_t* image)
+{
+    if(!image)
+    {
+        #ifdef SB3_DEV_CRASH_WHEN_ERROR
+            errx(EXIT_FAILURE, "THRESHOLD: NULL image cannot be binarized");
+        #else
+            SB3_DEV_SetError(SB3_DEV_NULL_IMAGE_ERROR);
+            return 0;
+        #endif
+    }
+    return 1;
+}
+
+/* GLOBAL THRESHOLD */
+
+void __SB3_DEV_threshold(SB3_DEV_image_t* image, uint8_t* output, uint8_t level)
+{
+    uint8_t* buffer = __SB3_DEV_malloc(image->w);
+    for(int y = 0; y < image->h; y++)
+    {
+        const uint8_t* gray = __SB3_DEV_gray_row(image, y, buffer);
+        uint8_t* out = output + (size_t)y * image->w;
+        for(int x = 0; x < image->w; x++)
+            out[x] = -(gray[x] > level);
+    }
+    __SB3_DEV_free(buffer);
+}
+
+int SB3_DEV_otsu_level(SB3_DEV_image_t* image)
+{
+    if(!__SB3_DEV_threshold_check(image))
+        return -1;
+
+    uint64_t histogram[256] = { 0 };
+    uint8_t* buffer = __SB3_DEV_malloc(image->w);
+    for(int y = 0; y < image->h; y++)
+    {
+        const uint8_t* gray = __SB3_DEV_gray_row(image, y, buffer);
+        for(int x = 0; x < image->w; x++)
+            histogram[gray[x]]++;
+    }
+    __SB3_DEV_free(buffer);
+
+    double total = (double)image->w * image->h, sum = 0;
+    for(int i = 0; i < 256; i++)
+        sum += (double)i * histogram[i];
+
+    // maximize the between-class variance w0 * w1 * (m0 - m1)^2
+    double w0 = 0, sum0 = 0, best = -1;
+    int level = 0;
+    for(int t = 0; t < 256; t++)
+    {
+        w0 += histogram[t];
+        sum0 += (double)t * histogram[t];
+        double w1 = total - w0;
+        if(w0 == 0 || w1 == 0)
+            continue;
+        double diff = sum0 / w0 - (sum - sum0) / w1;
+        double variance = w0 * w1 * diff * diff;
+        if(variance > best)
+        {
+            best = variance;
+            level = t;
+        }
+    }
+    SB3_DEV_SetError(SB3_DEV_SUCCESS_EXIT);
+    return level;
+}
+
+SB3_DEV_image_t* SB3_DEV_threshold(SB3_DEV_image_t* image, uint8_t level)
+{
+    if(!__SB3_DEV_threshold_check(image))
+        return NULL;
+    SB3_DEV_image_t* res;
+    __SB3_DEV_threshold(image, __SB3_DEV_binary_output(image, &res), level);
+    SB3_DEV_SetError(SB3_DEV_SUCCESS_EXIT);
+    return res;
+}
+
+SB3_DEV_errors_t SB3_DEV_apply_threshold(SB3_DEV_image_t* image, uint8_t level)
+{
+    if(!__SB3_DEV_threshold_check(image))
+        return SB3_DEV_NULL_IMAGE_ERROR;
+    uint8_t* output = __SB3_DEV_binary_output(image, NULL);
+    __SB3_DEV_threshold(image, output, level);
+    __SB3_DEV_binary_output_done(image, output, 1);
+    SB3_DEV_SetError(SB3_DEV_SUCCESS_EXIT);
+    return SB3_DEV_SUCCESS_EXIT;
+}
+
+SB3_DEV_image_t* SB3_DEV_otsu_threshold(SB3_DEV_image_t* image)
+{
+    int level = SB3_DEV_otsu_level(image);
+    return level < 0 ? NULL : SB3_DEV_threshold(image, level);
+}
+
+SB3_DEV_errors_t SB3_DEV_apply_otsu_threshold(SB3_DEV_image_t* image)
+{
+    int level = SB3_DEV_otsu_level(image);
+    return level < 0 ? SB3_DEV_NULL_IMAGE_ERROR : SB3_DEV_apply_threshold(image, level);
+}
+
+/* ADAPTIVE THRESHOLDS */
+
+// window [x0, x1[ * [y0, y1[ clamped in the image
+void __SB3_DEV_adaptive_threshold(SB3_DEV_image_t* image, uint8_t* output, unsigned int radius,
+        int offset, double k, char sauvola)
+{
+    __SB3_DEV_integral_t* integral = __SB3_DEV_integral(image, sauvola);
+    int stride = image->w + 1, r = radius;
+    uint8_t* buffer = __SB3_DEV_malloc(image->w);
+
+    // the whole table is built before writing so output can be the image storage
+    for(int y = 0; y < image->h; y++)
+    {
+        int y0 = y - r < 0 ? 0 : y - r;
+        int y1 = y + r + 1 > image->h ? image->h : y + r + 1;
+        const uint8_t* gray = __SB3_DEV_gray_row(image, y, buffer);
+        uint8_t* out = output + (size_t)y * image->w;
+        for(int x = 0; x < image->w; x++)
+        {
+            int x0 = x - r < 0 ? 0 : x - r;
+            int x1 = x + r + 1 > image->w ? image->w : x + r + 1;
+            int64_t area = (int64_t)(x1 - x0) * (y1 - y0);
+            uint64_t sum = __SB3_DEV_integral_sum(integral, x0, y0, x1, y1);
+            if(sauvola)
+            {
+                uint64_t squares = __SB3_DEV_WINDOW(integral->squares, stride, x0, y0, x1, y1);
+                double mean = (double)sum / area;
+                double variance = (double)squares / area - mean * mean;
+                double deviation = variance > 0 ? sqrt(variance) : 0;
+                out[x] = -(gray[x] > mean * (1 + k * (deviation / 128. - 1)));
+            }
+            else
+                out[x] = -((int64_t)gray[x] * area > (int64_t)sum - offset * area);
+        }
+    }
+    __SB3_DEV_free(buffer);
+    __SB3_DEV_FreeIntegral(integral);
+}
+
+SB3_DEV_image_t* SB3_DEV_mean_threshold(SB3_DEV_image_t* image, unsigned int radius, int offset)
+{
+    if(!__SB3_DEV_threshold_check(image))
+        return NULL;
+    SB3_DEV_image_t* res;
+    __SB3_DEV_adaptive_threshold(image, __SB3_DEV_binary_output(image, &res), radius, offset, 0, 0);
+    SB3_DEV_SetError(SB3_DEV_SUCCESS_EXIT);
+    return res;
+}
+
+SB3_DEV_errors_t SB3_DEV_apply_mean_threshold(SB3_DEV_image_t* image, unsigned int radius, int offset)
+{
+    if(!__SB3_DEV_threshold_check(image))
+        return SB3_DEV_NULL_IMAGE_ERROR;
+    uint8_t* output = __SB3_DEV_binary_output(image, NULL);
+    __SB3_DEV_adaptive_threshold(image, output, radius, offset, 0, 0);
+    __SB3_DEV_binary_output_done(image, output, 1);
+    SB3_DEV_SetError(SB3_DEV_SUCCESS_EXIT);
+    return SB3_DEV_SUCCESS_EXIT;
+}
+
+SB3_DEV_image_t* SB3_DEV_sauvola_threshold(SB3_DEV_image_t* image, unsigned int radius, double k)
+{
+    if(!__SB3_DEV_threshold_check(image))
+        return NULL;
+    SB3_DEV_image_t* res;
+    __SB3_DEV_adaptive_threshold(image, __SB3_DEV_binary_output(image, &res), radius, 0, k, 1);
+    SB3_DEV_SetError(SB3_DEV_SUCCESS_EXIT);
+    return res;
+}
+
+SB3_DEV_errors_t SB3_DEV_apply_sauvola_threshold(SB3_DEV_image_t* image, unsigned int radius, double k)
+{
+    if(!__SB3_DEV_threshold_check(image))
+        return SB3_DEV_NULL_IMAGE_ERROR;
+    uint8_t* output = __SB3_DEV_binary_output(image, NULL);
+    __SB3_DEV_adaptive_threshold(image, output, radius, 0, k, 1);
+    __SB3_DEV_binary_output_done(image, output, 1);
+    SB3_DEV_SetError(SB3_DEV_SUCCESS_EXIT);
+    return SB3_DEV_SUCCESS_EXIT;
+}
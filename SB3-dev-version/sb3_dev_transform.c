@@ -0,0 +1,284 @@
+/*
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 AyAztuB
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ *
+ * AUTHOR
+ *
+ * AyAztuB (ayaztub@gmail.com) from https://github.com/AyAztuB/SB3-Project
+ *
+ */
+
+
+
+#include "sb3_dev_internal.h"
+#include <err.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// square tiles of the transposes (a tile of source rows and one of destination rows stay in L1)
+#define __SB3_DEV_TILE 32
+
+/* ROWS */
+
+void __SB3_DEV_reverse_row(const uint8_t* src, uint8_t* dst, int w, int ps)
+{
+    int x = 0;
+    if(ps == 1)
+    {
+#ifdef __SSE2__
+        for(; x + 16 <= w; x += 16)
+        {
+            __m128i v = _mm_loadu_si128((const __m128i*)(src + w - 16 - x));
+            v = _mm_shuffle_epi32(v, _MM_SHUFFLE(0, 1, 2, 3));
+            v = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1)), _MM_SHUFFLE(2, 3, 0, 1));
+            v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+            _mm_storeu_si128((__m128i*)(dst + x), v);
+        }
+#endif
+        for(; x < w; x++)
+            dst[x] = src[w - 1 - x];
+        return;
+    }
+    for(; x < w; x++)
+    {
+        const uint8_t* p = src + (size_t)(w - 1 - x) * 3;
+        dst[3*x] = p[0];
+        dst[3*x+1] = p[1];
+        dst[3*x+2] = p[2];
+    }
+}
+
+/* TRANSPOSE */
+
+// dst(x', y') = src(x, y) for x in [x0, x1), y in [y0, y1)
+// with x' = y (src->h - 1 - y if flip_x) and y' = x (src->w - 1 - x if flip_y)
+void __SB3_DEV_transpose_rect(SB3_DEV_image_t* src, SB3_DEV_image_t* dst, int x0, int x1, int y0, int y1,
+        char flip_x, char flip_y)
+{
+    int ps = __SB3_DEV_pixel_size(src->format);
+    for(int x = x0; x < x1; x++)
+    {
+        uint8_t* out = __SB3_DEV_row(dst, flip_y ? src->w - 1 - x : x);
+        for(int y = y0; y < y1; y++)
+        {
+            const uint8_t* in = __SB3_DEV_row(src, y) + (size_t)x * ps;
+            uint8_t* p = out + (size_t)(flip_x ? src->h - 1 - y : y) * ps;
+            p[0] = in[0];
+            if(ps == 3)
+            {
+                p[1] = in[1];
+                p[2] = in[2];
+            }
+        }
+    }
+}
+
+#ifdef __SSE2__
+// 8x8 bytes block at (x, y) of a one byte per pixel image
+void __SB3_DEV_transpose_8x8(SB3_DEV_image_t* src, SB3_DEV_image_t* dst, int x, int y, char flip_x, char flip_y)
+{
+    __m128i r[8];
+    for(int i = 0; i < 8; i++)
+        r[i] = _mm_loadl_epi64((const __m128i*)(__SB3_DEV_row(src, y + i) + x));
+    __m128i a0 = _mm_unpacklo_epi8(r[0], r[1]), a1 = _mm_unpacklo_epi8(r[2], r[3]);
+    __m128i a2 = _mm_unpacklo_epi8(r[4], r[5]), a3 = _mm_unpacklo_epi8(r[6], r[7]);
+    __m128i b0 = _mm_unpacklo_epi16(a0, a1), b1 = _mm_unpackhi_epi16(a0, a1);
+    __m128i b2 = _mm_unpacklo_epi16(a2, a3), b3 = _mm_unpackhi_epi16(a2, a3);
+    // columns 2k, 2k + 1 in the low, high halves of c[k]
+    __m128i c[4] = {
+        _mm_unpacklo_epi32(b0, b2), _mm_unpackhi_epi32(b0, b2),
+        _mm_unpacklo_epi32(b1, b3), _mm_unpackhi_epi32(b1, b3),
+    };
+    int offset = flip_x ? src->h - 8 - y : y;
+    for(int i = 0; i < 8; i++)
+    {
+        uint64_t column;
+        _mm_storel_epi64((__m128i*)&column, i & 1 ? _mm_unpackhi_epi64(c[i / 2], c[i / 2]) : c[i / 2]);
+        if(flip_x)
+            column = __builtin_bswap64(column);
+        memcpy(__SB3_DEV_row(dst, flip_y ? src->w - 1 - x - i : x + i) + offset, &column, 8);
+    }
+}
+#endif
+
+void __SB3_DEV_transpose(SB3_DEV_image_t* src, SB3_DEV_image_t* dst, char flip_x, char flip_y)
+{
+    for(int y0 = 0; y0 < src->h; y0 += __SB3_DEV_TILE)
+        for(int x0 = 0; x0 < src->w; x0 += __SB3_DEV_TILE)
+        {
+            int y1 = y0 + __SB3_DEV_TILE < src->h ? y0 + __SB3_DEV_TILE : src->h;
+            int x1 = x0 + __SB3_DEV_TILE < src->w ? x0 + __SB3_DEV_TILE : src->w;
+            int bx = x0, by = y0;
+#ifdef __SSE2__
+            if(src->format != SB3_DEV_RGB_FORMAT)
+            {
+                bx = x0 + ((x1 - x0) & ~7);
+                by = y0 + ((y1 - y0) & ~7);
+                for(int y = y0; y < by; y += 8)
+                    for(int x = x0; x < bx; x += 8)
+                        __SB3_DEV_transpose_8x8(src, dst, x, y, flip_x, flip_y);
+                // edges of the tile not covered by whole blocks
+                __SB3_DEV_transpose_rect(src, dst, bx, x1, y0, y1, flip_x, flip_y);
+                __SB3_DEV_transpose_rect(src, dst, x0, bx, by, y1, flip_x, flip_y);
+                continue;
+            }
+#endif
+            __SB3_DEV_transpose_rect(src, dst, bx, x1, by, y1, flip_x, flip_y);
+        }
+}
+
+/* TRANSFORMS */
+
+char __SB3_DEV_transform_check(SB3_DEV_image_t* image, SB3_DEV_transform_t transform)
+{
+    if(!image)
+    {
+        #ifdef SB3_DEV_CRASH_WHEN_ERROR
+            errx(EXIT_FAILURE, "TRANSFORM: NULL image");
+        #else
+            SB3_DEV_SetError(SB3_DEV_NULL_IMAGE_ERROR);
+            return 0;
+        #endif
+    }
+    if(transform < SB3_DEV_ROTATE_90 || transform > SB3_DEV_TRANSVERSE)
+    {
+        #ifdef SB3_DEV_CRASH_WHEN_ERROR
+            errx(EXIT_FAILURE, "TRANSFORM: unknown transform %d", transform);
+        #else
+            SB3_DEV_SetError(SB3_DEV_BAD_FORMAT_ERROR);
+            return 0;
+        #endif
+    }
+    return 1;
+}
+
+static inline char __SB3_DEV_transform_swaps(SB3_DEV_transform_t transform)
+{
+    return transform == SB3_DEV_ROTATE_90 || transform == SB3_DEV_ROTATE_270
+        || transform == SB3_DEV_TRANSPOSE || transform == SB3_DEV_TRANSVERSE;
+}
+
+// rows are stored bottom to top: a transverse is the plain transpose of the storage
+void __SB3_DEV_transform(SB3_DEV_image_t* src, SB3_DEV_image_t* dst, SB3_DEV_transform_t transform)
+{
+    int ps = __SB3_DEV_pixel_size(src->format);
+    switch(transform)
+    {
+        case SB3_DEV_ROTATE_90:
+            __SB3_DEV_transpose(src, dst, 0, 1);
+            break;
+        case SB3_DEV_ROTATE_270:
+            __SB3_DEV_transpose(src, dst, 1, 0);
+            break;
+        case SB3_DEV_TRANSPOSE:
+            __SB3_DEV_transpose(src, dst, 1, 1);
+            break;
+        case SB3_DEV_TRANSVERSE:
+            __SB3_DEV_transpose(src, dst, 0, 0);
+            break;
+        default:
+            for(int y = 0; y < src->h; y++)
+            {
+                const uint8_t* in = __SB3_DEV_row(src, y);
+                uint8_t* out = __SB3_DEV_row(dst, transform == SB3_DEV_FLIP_HORIZONTAL ? y : src->h - 1 - y);
+                if(transform == SB3_DEV_FLIP_VERTICAL)
+                    memcpy(out, in, (size_t)src->w * ps);
+                else
+                    __SB3_DEV_reverse_row(in, out, src->w, ps);
+            }
+    }
+}
+
+SB3_DEV_image_t* SB3_DEV_transform(SB3_DEV_image_t* image, SB3_DEV_transform_t transform)
+{
+    if(!__SB3_DEV_transform_check(image, transform))
+        return NULL;
+    char swaps = __SB3_DEV_transform_swaps(transform);
+    SB3_DEV_image_t* res = SB3_DEV_NewImage(swaps ? image->h : image->w, swaps ? image->w : image->h, image->format);
+    if(image->palette)
+    {
+        memcpy(res->palette, image->palette, 256 * sizeof(SB3_DEV_RGBColor_t));
+        res->palette_size = image->palette_size;
+    }
+    __SB3_DEV_transform(image, res, transform);
+    SB3_DEV_SetError(SB3_DEV_SUCCESS_EXIT);
+    return res;
+}
+
+SB3_DEV_errors_t SB3_DEV_apply_transform(SB3_DEV_image_t* image, SB3_DEV_transform_t transform)
+{
+    if(!__SB3_DEV_transform_check(image, transform))
+        return __SB3_DEV_LastError();
+    int ps = __SB3_DEV_pixel_size(image->format);
+    if(__SB3_DEV_transform_swaps(transform))
+    {
+        SB3_DEV_image_t tmp = {
+            .w = image->h,
+            .h = image->w,
+            .format = image->format,
+            .pixels = __SB3_DEV_pixels_alloc((size_t)image->w * image->h * ps, 0),
+            .stride = (size_t)image->h * ps,
+        };
+        __SB3_DEV_transform(image, &tmp, transform);
+        image->w = tmp.w;
+        image->h = tmp.h;
+        __SB3_DEV_set_pixels(image, image->format, tmp.pixels);
+    }
+    else
+    {
+        // flips in place, rows swapped through two row buffers
+        __SB3_DEV_writable(image, 1);
+        size_t row_bytes = (size_t)image->w * ps;
+        uint8_t* top = __SB3_DEV_malloc(row_bytes);
+        uint8_t* bottom = __SB3_DEV_malloc(row_bytes);
+        for(int y = 0; y < (transform == SB3_DEV_FLIP_HORIZONTAL ? image->h : (image->h + 1) / 2); y++)
+        {
+            uint8_t* a = __SB3_DEV_row(image, y);
+            uint8_t* b = __SB3_DEV_row(image, image->h - 1 - y);
+            if(transform == SB3_DEV_FLIP_HORIZONTAL)
+            {
+                __SB3_DEV_reverse_row(a, top, image->w, ps);
+                memcpy(a, top, row_bytes);
+                continue;
+            }
+            if(transform == SB3_DEV_FLIP_VERTICAL)
+            {
+                memcpy(top, a, row_bytes);
+                memcpy(bottom, b, row_bytes);
+            }
+            else
+            {
+                __SB3_DEV_reverse_row(a, top, image->w, ps);
+                __SB3_DEV_reverse_row(b, bottom, image->w, ps);
+            }
+            memcpy(a, bottom, row_bytes);
+            memcpy(b, top, row_bytes);
+        }
+        __SB3_DEV_free(top);
+        __SB3_DEV_free(bottom);
+    }
+    SB3_DEV_SetError(SB3_DEV_SUCCESS_EXIT);
+    return SB3_DEV_SUCCESS_EXIT;
+}
@@ -30,16 +30,32 @@
  */
 
 
-#include "sb3_dev.h"
+#include "sb3_dev_internal.h"
 #include <err.h>
 
 
-SB3_DEV_errors_t last_error = SB3_DEV_SUCCESS_EXIT;
+_Thread_local SB3_DEV_errors_t last_error = SB3_DEV_SUCCESS_EXIT;
 
 char* SB3_DEV_GetError(void)
 {
     switch (last_error)
     {
+        case SB3_DEV_OUT_OF_MEMORY_ERROR:
+            return "not enough memory to complete the operation";
+        case SB3_DEV_IMAGES_MISMATCH_ERROR:
+            return "the images compared don't have the same dimensions and format";
+        case SB3_DEV_BUFFER_TOO_SMALL_ERROR:
+            return "the buffer given in parameter is too small for the encoded image";
+        case SB3_DEV_NULL_BUFFER_ERROR:
+            return "buffer or io passed in parameter was NULL";
+        case SB3_DEV_SIZE_MISMATCH_ERROR:
+            return "the file hasn't the dimensions of the destination image";
+        case SB3_DEV_IO_ERROR:
+            return "reading or writing the file failed";
+        case SB3_DEV_OUT_OF_BOUNDS_ERROR:
+            return "the region or the dimensions given in parameter are outside of the image";
+        case SB3_DEV_NULL_PIPELINE_ERROR:
+            return "pipeline passed in parameter was NULL";
         case SB3_DEV_NULL_PATH_ERROR:
             return "image path was NULL";
         case SB3_DEV_UNSUPORTED_BMP_FORMAT_ERROR:
@@ -64,9 +80,14 @@ void SB3_DEV_SetError(SB3_DEV_errors_t error)
     last_error = error;
 }
 
+SB3_DEV_errors_t __SB3_DEV_LastError(void)
+{
+    return last_error;
+}
+
 SB3_DEV_RGBColor_t* SB3_DEV_NewRGB(uint8_t r, uint8_t g, uint8_t b)
 {
-    SB3_DEV_RGBColor_t* color = malloc(sizeof(*color));
+    SB3_DEV_RGBColor_t* color = __SB3_DEV_malloc(sizeof(*color));
     *color = (SB3_DEV_RGBColor_t) {
         .r = r,
         .g = g,
@@ -77,7 +98,7 @@ SB3_DEV_RGBColor_t* SB3_DEV_NewRGB(uint8_t r, uint8_t g, uint8_t b)
 
 SB3_DEV_monoColor_t* SB3_DEV_NewMonoColor(uint8_t color)
 {
-    SB3_DEV_monoColor_t* res = malloc(sizeof(*res));
+    SB3_DEV_monoColor_t* res = __SB3_DEV_malloc(sizeof(*res));
     *res = (SB3_DEV_monoColor_t) {
         .color = color,
     };
@@ -86,64 +107,109 @@ SB3_DEV_monoColor_t* SB3_DEV_NewMonoColor(uint8_t color)
 
 void SB3_DEV_RGBFreeColor(SB3_DEV_RGBColor_t* color)
 {
-    free(color);
+    __SB3_DEV_free(color);
 }
 
 void SB3_DEV_MonoFreeColor(SB3_DEV_monoColor_t* color)
 {
-    free(color);
+    __SB3_DEV_free(color);
+}
+
+_Static_assert(sizeof(SB3_DEV_RGBColor_t) == 3, "rgb pixels must be packed");
+
+void __SB3_DEV_buffer_release(SB3_DEV_buffer_t* buffer)
+{
+    if(buffer && atomic_fetch_sub(&buffer->references, 1) == 1)
+    {
+        __SB3_DEV_free(buffer->data);
+        __SB3_DEV_free(buffer);
+    }
+}
+
+void __SB3_DEV_set_pixels(SB3_DEV_image_t* image, SB3_DEV_image_format_t format, void* pixels)
+{
+    __SB3_DEV_buffer_release(image->buffer);
+    __SB3_DEV_free(image->rgb_pixels);
+    __SB3_DEV_free(image->mono_pixels);
+    image->format = format;
+    image->pixels = pixels;
+    image->stride = (size_t)image->w * __SB3_DEV_pixel_size(format);
+    image->buffer = __SB3_DEV_malloc(sizeof(SB3_DEV_buffer_t));
+    atomic_init(&image->buffer->references, 1);
+    image->buffer->data = pixels;
+    image->rgb_pixels = NULL;
+    image->mono_pixels = NULL;
+    if(format == SB3_DEV_RGB_FORMAT)
+    {
+        SB3_DEV_RGBColor_t* colors = pixels;
+        image->rgb_pixels = __SB3_DEV_malloc(image->w * image->h * sizeof(SB3_DEV_RGBColor_t*));
+        for(int i = 0; i < image->w * image->h; i++)
+            image->rgb_pixels[i] = colors + i;
+    }
+    else
+    {
+        SB3_DEV_monoColor_t* colors = pixels;
+        image->mono_pixels = __SB3_DEV_malloc(image->w * image->h * sizeof(SB3_DEV_monoColor_t*));
+        for(int i = 0; i < image->w * image->h; i++)
+            image->mono_pixels[i] = colors + i;
+    }
 }
 
 SB3_DEV_image_t* SB3_DEV_NewImage(int width, int height, SB3_DEV_image_format_t format)
 {
-    SB3_DEV_image_t* image = malloc(sizeof(*image));
+    SB3_DEV_image_t* image = __SB3_DEV_malloc(sizeof(*image));
     *image = (SB3_DEV_image_t) {
         .w = width,
         .h = height,
         .format = format,
         .mono_pixels = NULL,
         .rgb_pixels = NULL,
+        .pixels = NULL,
+        .stride = 0,
+        .buffer = NULL,
+        .palette = NULL,
+        .palette_size = 0,
     };
-    if(format == SB3_DEV_RGB_FORMAT)
+    if(format == SB3_DEV_INDEXED_FORMAT)
     {
-        SB3_DEV_RGBColor_t** pixels = malloc(width * height * sizeof(SB3_DEV_RGBColor_t*));
-        for(int i = 0; i < width*height; i++)
-            pixels[i] = SB3_DEV_NewRGB(0,0,0);
-        image->rgb_pixels = pixels;
-    }
-    else
-    {
-        SB3_DEV_monoColor_t** pixels = malloc(width * height * sizeof(SB3_DEV_monoColor_t*));
-        for(int i = 0; i < width*height; i++)
-            pixels[i] = SB3_DEV_NewMonoColor(0);
-        image->mono_pixels = pixels;
+        image->palette = __SB3_DEV_calloc(256, sizeof(SB3_DEV_RGBColor_t));
+        image->palette_size = 256;
     }
+    // one block for every pixels (initially black)
+    __SB3_DEV_set_pixels(image, format,
+        __SB3_DEV_pixels_alloc((size_t)width * height * __SB3_DEV_pixel_size(format), 1));
     return image;
 }
 
+void __SB3_DEV_writable(SB3_DEV_image_t* image, char keep)
+{
+    size_t row_bytes = (size_t)image->w * __SB3_DEV_pixel_size(image->format);
+    if(image->stride == row_bytes && atomic_load_explicit(&image->buffer->references, memory_order_acquire) == 1)
+        return;
+    uint8_t* pixels = __SB3_DEV_pixels_alloc(row_bytes * image->h, 0);
+    for(int y = 0; keep && y < image->h; y++)
+        memcpy(pixels + y * row_bytes, __SB3_DEV_row(image, y), row_bytes);
+    __SB3_DEV_set_pixels(image, image->format, pixels);
+}
+
 void SB3_DEV_FreeImage(SB3_DEV_image_t* image)
 {
-    if(image->format == SB3_DEV_RGB_FORMAT)
-    {
-        for(int i = 0; i < image->w * image->h; i++)
-            SB3_DEV_RGBFreeColor(image->rgb_pixels[i]);
-        free(image->rgb_pixels);
-    }
-    else
-    {
-        for(int i = 0; i < image->w * image->h; i++)
-            SB3_DEV_MonoFreeColor(image->mono_pixels[i]);
-        free(image->mono_pixels);
-    }
-    free(image);
+    __SB3_DEV_buffer_release(image->buffer);
+    __SB3_DEV_free(image->rgb_pixels);
+    __SB3_DEV_free(image->mono_pixels);
+    __SB3_DEV_free(image->palette);
+    __SB3_DEV_free(image);
 }
 
 /* to cast in SB3_DEV_RGBColor_t* or in SB3_DEV_monoColor_t* */
 void* SB3_DEV_GetPixel(SB3_DEV_image_t* image, int index)
 {
-    if(image->format == SB3_DEV_RGB_FORMAT)
+    if(image->rgb_pixels)
         return (void*)(image->rgb_pixels[index]);
-    return (void*)(image->mono_pixels[index]);
+    if(image->mono_pixels)
+        return (void*)(image->mono_pixels[index]);
+    // views: no pointer arrays
+    return __SB3_DEV_row(image, index / image->w) + (size_t)(index % image->w) * __SB3_DEV_pixel_size(image->format);
 }
 
 void* SB3_DEV_GetPixelPos(SB3_DEV_image_t* image, int x, int y)
@@ -153,15 +219,16 @@ void* SB3_DEV_GetPixelPos(SB3_DEV_image_t* image, int x, int y)
 
 void SB3_DEV_SetPixel(SB3_DEV_image_t* image, void* pixel, int index)
 {
+    __SB3_DEV_writable(image, 1);
     if(image->format == SB3_DEV_RGB_FORMAT)
     {
-        SB3_DEV_RGBFreeColor(image->rgb_pixels[index]);
-        image->rgb_pixels[index] = (SB3_DEV_RGBColor_t*)pixel;
+        *image->rgb_pixels[index] = *(SB3_DEV_RGBColor_t*)pixel;
+        SB3_DEV_RGBFreeColor((SB3_DEV_RGBColor_t*)pixel);
     }
     else
     {
-        SB3_DEV_MonoFreeColor(image->mono_pixels[index]);
-        image->mono_pixels[index] = (SB3_DEV_monoColor_t*)pixel;
+        *image->mono_pixels[index] = *(SB3_DEV_monoColor_t*)pixel;
+        SB3_DEV_MonoFreeColor((SB3_DEV_monoColor_t*)pixel);
     }
 }
 
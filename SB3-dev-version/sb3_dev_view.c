@@ -0,0 +1,136 @@
+/*
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 AyAztuB
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ *
+ * AUTHOR
+ *
+ * AyAztuB (ayaztub@gmail.com) from https://github.com/AyAztuB/SB3-Project
+ *
+ */
+
+
+
+#include "sb3_dev_internal.h"
+#include <err.h>
+
+// image sharing the storage of parent from pixel (x, y)
+SB3_DEV_image_t* __SB3_DEV_view(SB3_DEV_image_t* parent, int x, int y, int width, int height)
+{
+    SB3_DEV_image_t* view = __SB3_DEV_malloc(sizeof(*view));
+    *view = (SB3_DEV_image_t) {
+        .w = width,
+        .h = height,
+        .format = parent->format,
+        .mono_pixels = NULL,
+        .rgb_pixels = NULL,
+        .pixels = __SB3_DEV_row(parent, y) + (size_t)x * __SB3_DEV_pixel_size(parent->format),
+        .stride = parent->stride,
+        .buffer = parent->buffer,
+        .palette = NULL,
+        .palette_size = parent->palette_size,
+    };
+    atomic_fetch_add(&parent->buffer->references, 1);
+    if(parent->palette)
+    {
+        view->palette = __SB3_DEV_malloc(256 * sizeof(SB3_DEV_RGBColor_t));
+        memcpy(view->palette, parent->palette, 256 * sizeof(SB3_DEV_RGBColor_t));
+    }
+    return view;
+}
+
+SB3_DEV_image_t* SB3_DEV_crop(SB3_DEV_image_t* image, int x, int y, int width, int height)
+{
+    if(!image)
+    {
+        #ifdef SB3_DEV_CRASH_WHEN_ERROR
+            errx(EXIT_FAILURE, "CROP: NULL image");
+        #else
+            SB3_DEV_SetError(SB3_DEV_NULL_IMAGE_ERROR);
+            return NULL;
+        #endif
+    }
+    if(x < 0 || y < 0 || width <= 0 || height <= 0 || x > image->w - width || y > image->h - height)
+    {
+        #ifdef SB3_DEV_CRASH_WHEN_ERROR
+            errx(EXIT_FAILURE, "CROP: region %dx%d at (%d, %d) outside of the %dx%d image", width, height, x, y, image->w, image->h);
+        #else
+            SB3_DEV_SetError(SB3_DEV_OUT_OF_BOUNDS_ERROR);
+            return NULL;
+        #endif
+    }
+    SB3_DEV_SetError(SB3_DEV_SUCCESS_EXIT);
+    return __SB3_DEV_view(image, x, y, width, height);
+}
+
+SB3_DEV_image_t* SB3_DEV_row_band(SB3_DEV_image_t* image, int y, int height)
+{
+    return SB3_DEV_crop(image, 0, y, image ? image->w : 0, height);
+}
+
+SB3_DEV_image_t* SB3_DEV_channel(SB3_DEV_image_t* image, int channel)
+{
+    if(!image)
+    {
+        #ifdef SB3_DEV_CRASH_WHEN_ERROR
+            errx(EXIT_FAILURE, "CHANNEL: NULL image");
+        #else
+            SB3_DEV_SetError(SB3_DEV_NULL_IMAGE_ERROR);
+            return NULL;
+        #endif
+    }
+    if(image->format != SB3_DEV_RGB_FORMAT || channel < 0 || channel > 2)
+    {
+        #ifdef SB3_DEV_CRASH_WHEN_ERROR
+            errx(EXIT_FAILURE, "CHANNEL: expected an rgb image and a channel between 0 and 2 (received %d)", channel);
+        #else
+            SB3_DEV_SetError(SB3_DEV_BAD_FORMAT_ERROR);
+            return NULL;
+        #endif
+    }
+    SB3_DEV_image_t* res = SB3_DEV_NewImage(image->w, image->h, SB3_DEV_MONO_COLOR_FORMAT);
+    for(int y = 0; y < image->h; y++)
+    {
+        const uint8_t* src = __SB3_DEV_row(image, y) + channel;
+        uint8_t* dst = __SB3_DEV_row(res, y);
+        for(int x = 0; x < image->w; x++)
+            dst[x] = src[3 * x];
+    }
+    SB3_DEV_SetError(SB3_DEV_SUCCESS_EXIT);
+    return res;
+}
+
+void SB3_DEV_detach(SB3_DEV_image_t* image)
+{
+    if(!image)
+    {
+        #ifdef SB3_DEV_CRASH_WHEN_ERROR
+            errx(EXIT_FAILURE, "DETACH: NULL image");
+        #else
+            SB3_DEV_SetError(SB3_DEV_NULL_IMAGE_ERROR);
+            return;
+        #endif
+    }
+    __SB3_DEV_writable(image, 1);
+    SB3_DEV_SetError(SB3_DEV_SUCCESS_EXIT);
+}
@@ -74,10 +74,35 @@ typedef struct {
     SB3_monoColor_t** mono_pixels;
 } SB3_image_t;
 
+// library memory accounting (see SB3_GetAllocatorStats)
+typedef struct {
+    size_t live_bytes; // allocated and not freed yet
+    size_t peak_bytes; // highest live_bytes since the last reset
+    size_t allocations; // count since the last reset
+} SB3_allocator_stats_t;
+
+// memory accounting of one operation (see SB3_NewAllocatorScope)
+typedef struct SB3_allocator_scope_s SB3_allocator_scope_t;
+
 // FUNCTIONS
 
 // last error message (don't reset it)
 char* SB3_GetError(void);
+// allocator of the library (NULL malloc_fn or free_fn: back to malloc / free), set it before any allocation
+// aligned_alloc_fn (may be NULL) receives the pixel arrays, its memory is released by free_fn
+// images and colors given to the library (SetPixel, FreeImage) must come from it too (NewImage, NewRGB, NewMonoColor)
+void SB3_SetAllocator(void* (*malloc_fn)(size_t size, void* userdata), void (*free_fn)(void* ptr, void* userdata),
+        void* (*aligned_alloc_fn)(size_t alignment, size_t size, void* userdata), void* userdata);
+// counters of every allocation: reset them before an operation to get its peak and allocation count
+void SB3_GetAllocatorStats(SB3_allocator_stats_t* stats);
+void SB3_ResetAllocatorStats(void);
+// per operation counters: the blocks allocated while a scope is set are counted in it until they are freed
+SB3_allocator_scope_t* SB3_NewAllocatorScope(void);
+// the scope stays valid until its last block is freed
+void SB3_FreeAllocatorScope(SB3_allocator_scope_t* scope);
+// current scope (NULL: none), returns the previous one
+SB3_allocator_scope_t* SB3_SetAllocatorScope(SB3_allocator_scope_t* scope);
+void SB3_GetAllocatorScopeStats(SB3_allocator_scope_t* scope, SB3_allocator_stats_t* stats);
 // read and write bitmap files
 SB3_errors_t SB3_BMP_write_image(const char* path, SB3_image_t* image);
 SB3_image_t* SB3_BMP_read_image(const char* path, SB3_image_format_t format);
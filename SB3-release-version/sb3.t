@@ -38,6 +38,12 @@ used for mono color and binary color image format. It contains one attribut colo
 the image type: contening w (int: image width), h (int: image height), format (SB3_image_format_t: image format) and 2 pixels array (only one can be used)
 [rgb_pixels (SB3_RGBColor_t**) and mono_pixels (SB3_monoColor_t**)]
 
+.IP SB3_allocator_stats_t
+memory accounting of the library: live_bytes (size_t: allocated and not freed yet), peak_bytes (size_t: highest live_bytes since the last reset) and allocations (size_t: count since the last reset)
+
+.IP SB3_allocator_scope_t
+opaque counters of one operation (see \fBSB3_NewAllocatorScope\fR)
+
 .RE
 
 .PP
@@ -49,6 +55,34 @@ the image type: contening w (int: image width), h (int: image height), format (S
 \fBchar*\fR SB3_GetError (\fBvoid\fR)
 return an error message for the last error occured. Don't resset this last error.
 
+.TP
+\fBvoid\fR SB3_SetAllocator (\fBvoid* (*\fR\fImalloc_fn\fR\fB)(size_t, void*)\fR, \fBvoid (*\fR\fIfree_fn\fR\fB)(void*, void*)\fR, \fBvoid* (*\fR\fIaligned_alloc_fn\fR\fB)(size_t, size_t, void*)\fR, \fBvoid*\fR \fIuserdata\fR)
+route every allocation of the library to \fImalloc_fn\fR and \fIfree_fn\fR (called with \fIuserdata\fR), set it before any allocation. A NULL \fImalloc_fn\fR or \fIfree_fn\fR goes back to malloc and free. \fIaligned_alloc_fn\fR (may be NULL) receives the pixel arrays, its memory is released by \fIfree_fn\fR. Images and colors given to the library (\fBSB3_SetPixel\fR, \fBSB3_FreeImage\fR) must come from it too.
+
+.TP
+\fBvoid\fR SB3_GetAllocatorStats (\fBSB3_allocator_stats_t*\fR \fIstats\fR)
+fill \fIstats\fR with the counters of every allocation of the library
+
+.TP
+\fBvoid\fR SB3_ResetAllocatorStats (\fBvoid\fR)
+reset the peak to the live bytes and the allocation count to 0 (call it before an operation to get its peak and allocation count)
+
+.TP
+\fBSB3_allocator_scope_t*\fR SB3_NewAllocatorScope (\fBvoid\fR)
+create the counters of one operation. The blocks allocated while it is set (see \fBSB3_SetAllocatorScope\fR) are counted in it until they are freed
+
+.TP
+\fBvoid\fR SB3_FreeAllocatorScope (\fBSB3_allocator_scope_t*\fR \fIscope\fR)
+release \fIscope\fR, it stays valid until its last block is freed
+
+.TP
+\fBSB3_allocator_scope_t*\fR SB3_SetAllocatorScope (\fBSB3_allocator_scope_t*\fR \fIscope\fR)
+count the next allocations in \fIscope\fR (NULL: none), return the previous scope
+
+.TP
+\fBvoid\fR SB3_GetAllocatorScopeStats (\fBSB3_allocator_scope_t*\fR \fIscope\fR, \fBSB3_allocator_stats_t*\fR \fIstats\fR)
+fill \fIstats\fR with the counters of \fIscope\fR
+
 .TP
 \fBSB3_error_t\fR SB3_BMP_write_image (\fBconst char*\fR \fIpath\fR, \fBSB3_image_t*\fR \fIimage\fR)
 write \fIimage\fR in file specified at \fIpath\fR. return error_code if an error occured (the error can also be catch by \fBSB3_GetError\fR), else 0 or SB3_SUCCESS_EXIT. If \f(BIimage\fB\->format\fR is RGB then write each color on 24bits, if it's monoColor, write each on 8bits, else write each on 1bit (not supported by feh).
@@ -31,11 +31,16 @@
 
 
 #include "sb3.h"
+#include "../SB3-common/sb3_bmp_rows.h"
 #include <err.h>
 #include <stdio.h>
 #include <string.h>
 
 void SB3_SetError(SB3_errors_t error);
+// allocator of sb3_utils.c
+void* __SB3_malloc(size_t size);
+void* __SB3_pixels_alloc(size_t size);
+void __SB3_free(void* ptr);
 
 SB3_errors_t SB3_BMP_write_image(const char* path, SB3_image_t* image)
 {
@@ -197,51 +202,43 @@ SB3_errors_t SB3_BMP_write_image(const char* path, SB3_image_t* image)
         fputc(color_table[i], file);
     
     // IMAGE DATA
+    // each row is gathered in row, converted by one kernel and written at once
+    int pixel_size = image->format == SB3_RGB_FORMAT ? 3 : 1;
+    uint8_t* row = __SB3_malloc(image->w * pixel_size);
+    uint8_t* out = __SB3_malloc(image->w * pixel_size + padding);
+    int out_size = (image->w * bits_per_pixels + 7) / 8;
     for(int y = 0; y < image->h; y++)
     {
-        for(int x = 0; x < image->w; x++)
+        if(image->format == SB3_RGB_FORMAT)
         {
-            uint8_t r, g, b;
-            if(image->format == SB3_RGB_FORMAT)
-            {
-                SB3_RGBColor_t* color = image->rgb_pixels[y * image->w + x];
-                r = color->r; g = color->g; b = color->b;
-                fputc(b, file);
-                fputc(g, file);
-                fputc(r, file);
-            }
-            else if(image->format == SB3_MONO_COLOR_FORMAT)
-            {
-                fputc(image->mono_pixels[y * image->w + x]->color, file);
-            }
-            else
+            for(int x = 0; x < image->w; x++)
+                memcpy(row + x * 3, image->rgb_pixels[y * image->w + x], 3);
+            __SB3_BMP_swap_rb(row, out, image->w);
+        }
+        else
+        {
+            for(int x = 0; x < image->w; x++)
+                row[x] = image->mono_pixels[y * image->w + x]->color;
+            if(image->format == SB3_MONO_COLOR_FORMAT)
+                memcpy(out, row, image->w);
+            else if(__SB3_BMP_pack_binary(row, out, image->w))
             {
-                uint8_t to_put = 0;
-                for(int i = 0; i < 8 && x+i < image->w; i++)
-                {
-                    uint color = image->mono_pixels[y * image->w + x+i]->color;
-                    if(color == 0)
-                        to_put = to_put | (0 << (7-i));
-                    else if(color == 255)
-                        to_put = to_put | (1 << (7-i));
-                    else
-                    {
-                        fclose(file);
-                        #ifdef SB3_CRASH_WHEN_ERROR
-                            errx(EXIT_FAILURE, "WRITE_IMAGE: Bad binary format for image not only white and black");
-                        #else
-                            SB3_SetError(SB3_BAD_FORMAT_ERROR);
-                            return SB3_BAD_FORMAT_ERROR;
-                        #endif
-                    }
-                }
-                fputc(to_put, file);
-                x += 7;
+                fclose(file);
+                __SB3_free(row);
+                __SB3_free(out);
+                #ifdef SB3_CRASH_WHEN_ERROR
+                    errx(EXIT_FAILURE, "WRITE_IMAGE: Bad binary format for image not only white and black");
+                #else
+                    SB3_SetError(SB3_BAD_FORMAT_ERROR);
+                    return SB3_BAD_FORMAT_ERROR;
+                #endif
             }
         }
-        for(int i = 0; i < padding; i++)
-            fputc(0, file);
+        memset(out + out_size, 0, padding);
+        fwrite(out, 1, out_size + padding, file);
     }
+    __SB3_free(row);
+    __SB3_free(out);
     fclose(file);
     SB3_SetError(SB3_SUCCESS_EXIT);
     return SB3_SUCCESS_EXIT;
@@ -387,7 +384,7 @@ SB3_image_t* SB3_BMP_read_image(const char* path, SB3_image_format_t format)
     int cool_size = colors_used * 4;
     if(bit_color < 16)
     {
-        color_table = malloc(cool_size * sizeof(uint8_t));
+        color_table = __SB3_malloc(cool_size * sizeof(uint8_t));
         for(int i = 0; i < cool_size; i++)
             color_table[i] = fgetc(file);
     }
@@ -399,7 +396,7 @@ SB3_image_t* SB3_BMP_read_image(const char* path, SB3_image_format_t format)
             if(r!=g || g!=b || (r!=0 && r!=255))
             {
                 fclose(file);
-                free(color_table);
+                __SB3_free(color_table);
                 #ifdef SB3_CRASH_WHEN_ERROR
                     errx(EXIT_FAILURE, "READ_IMAGE: Bad format: expected black and white image");
                 #else
@@ -415,9 +412,9 @@ SB3_image_t* SB3_BMP_read_image(const char* path, SB3_image_format_t format)
     SB3_monoColor_t** mono_pixels = NULL;
     
     if(format == SB3_RGB_FORMAT)
-        rgb_pixels = malloc(width*height*sizeof(SB3_RGBColor_t*));
+        rgb_pixels = __SB3_pixels_alloc(width*height*sizeof(SB3_RGBColor_t*));
     else
-        mono_pixels = malloc(width*height*sizeof(SB3_monoColor_t*));
+        mono_pixels = __SB3_pixels_alloc(width*height*sizeof(SB3_monoColor_t*));
 
     int padding = ((4 - (width * 3) % 4) % 4);
     if(bit_color == 8)
@@ -429,154 +426,71 @@ SB3_image_t* SB3_BMP_read_image(const char* path, SB3_image_format_t format)
     else if(bit_color == 1)
         padding = ((width % 8) + (width / 8)%4) % 4;
 
+    // one kernel for the whole file, palette bounds and grayness are checked once per row
+    __SB3_BMP_lut_t lut;
+    if(bit_color < 16)
+        __SB3_BMP_lut(&lut, color_table, colors_used);
+    __SB3_BMP_decode_t decode = __SB3_BMP_decoder(bit_color, format == SB3_RGB_FORMAT ? __SB3_BMP_TO_RGB : __SB3_BMP_TO_GRAY);
+    uint8_t checked = format == SB3_RGB_FORMAT ? __SB3_BMP_OUT_OF_TABLE : __SB3_BMP_OUT_OF_TABLE | __SB3_BMP_NOT_GRAY;
+    int packed_size = (width * bit_color + 7) / 8;
+    uint8_t* packed = __SB3_malloc(packed_size);
+    uint8_t* row = __SB3_malloc(width * (format == SB3_RGB_FORMAT ? 3 : 1));
+
     for (int y = 0; y < height; y++)
     {
-        for(int x = 0; x < width; x++)
+        int n = fread(packed, 1, packed_size, file);
+        // bytes past the end read as EOF
+        memset(packed + n, (uint8_t)EOF, packed_size - n);
+        uint8_t flags = decode(packed, row, width, &lut) & checked;
+        if(flags)
         {
-            uint8_t r, g, b;
-            if(bit_color == 24)
-            {
-                b = fgetc(file);
-                g = fgetc(file);
-                r = fgetc(file);
-            }
+            __SB3_free(color_table);
+            __SB3_free(packed);
+            __SB3_free(row);
+            fclose(file);
+            if(format == SB3_RGB_FORMAT)
+            { for(int k = 0; k < y*width; k++) __SB3_free(rgb_pixels[k]); __SB3_free(rgb_pixels); }
             else
+            { for(int k = 0; k < y*width; k++) __SB3_free(mono_pixels[k]); __SB3_free(mono_pixels); }
+            if(flags & __SB3_BMP_OUT_OF_TABLE)
             {
-                uint8_t color_table_index = fgetc(file);
-                if(bit_color == 8)
-                {
-                    if(color_table_index >= colors_used)
-                    {
-                        free(color_table);
-                        fclose(file);
-                        if(format == SB3_RGB_FORMAT)
-                        { for(int k = 0; k < y*width+x; k++) free(rgb_pixels[k]); free(rgb_pixels); }
-                        else
-                        { for(int k = 0; k < y*width+x; k++) free(mono_pixels[k]); free(mono_pixels); }
-                        #ifdef SB3_CRASH_WHEN_ERROR
-                            errx(EXIT_FAILURE, "READ_FILE: Corrupted color table size");
-                        #else
-                            SB3_SetError(SB3_CORRUPTED_FILE_ERROR);
-                            return NULL;
-                        #endif
-                    }
-                    b = color_table[color_table_index*4+0];
-                    g = color_table[color_table_index*4+1];
-                    r = color_table[color_table_index*4+2];
-                }
-                else
-                {
-                    for(int i = 0; i*bit_color < 8 && x+i < width; i++)
-                    {
-                        uint bit_color_index = color_table_index >> (8 - bit_color - (i * bit_color));
-                        switch(bit_color)
-                        {
-                            case 4:
-                                bit_color_index = bit_color_index & 0b1111;
-                                break;
-                            case 2:
-                                bit_color_index = bit_color_index & 0b11;
-                                break;
-                            case 1:
-                                bit_color_index = bit_color_index & 0b1;
-                                break;
-                        }
-                        if(bit_color_index >= colors_used)
-                        {
-                            free(color_table);
-                            fclose(file);
-                            if(format == SB3_RGB_FORMAT)
-                            { for(int k = 0; k < y*width+x+i; k++) free(rgb_pixels[k]); free(rgb_pixels); }
-                            else
-                            { for(int k = 0; k < y*width+x+i; k++) free(mono_pixels[k]); free(mono_pixels); }
-                            #ifdef SB3_CRASH_WHEN_ERROR
-                                errx(EXIT_FAILURE, "READ_FILE: Corrupted color table size (color_table_size = %d and index = %d)", colors_used, bit_color_index);
-                            #else
-                                SB3_SetError(SB3_CORRUPTED_FILE_ERROR);
-                                return NULL;
-                            #endif
-                        }
-                        b = color_table[bit_color_index*4+0];
-                        g = color_table[bit_color_index*4+1];
-                        r = color_table[bit_color_index*4+2];
-                        if(format == SB3_RGB_FORMAT)
-                        {
-                            SB3_RGBColor_t* color = malloc(sizeof(*color));
-                            *color = (SB3_RGBColor_t) {
-                                .r = r,
-                                .g = g,
-                                .b = b,
-                            };
-                            rgb_pixels[y*width+x+i] = color;
-                        }
-                        else
-                        {
-                            if(r==g&&g==b)
-                            {
-                                SB3_monoColor_t* color = malloc(sizeof(*color));
-                                color->color = r;
-                                mono_pixels[y*width+x+i] = color;
-                            }
-                            else
-                            {
-                                free(color_table); fclose(file);
-                                for(int k = 0; k < y*width+x+i; k++)
-                                    free(mono_pixels[k]);
-                                free(mono_pixels);
-                                #ifdef SB3_CRASH_WHEN_ERROR
-                                    errx(EXIT_FAILURE, "READ_FILE: Incorrect Mono color format");
-                                #else
-                                    SB3_SetError(SB3_BAD_FORMAT_ERROR);
-                                    return NULL;
-                                #endif
-                            }
-                        }
-                    }
-                    x += 8/bit_color -1;
-                    continue;
-                }
+                #ifdef SB3_CRASH_WHEN_ERROR
+                    errx(EXIT_FAILURE, "READ_FILE: Corrupted color table size (color_table_size = %d)", colors_used);
+                #else
+                    SB3_SetError(SB3_CORRUPTED_FILE_ERROR);
+                    return NULL;
+                #endif
             }
+            #ifdef SB3_CRASH_WHEN_ERROR
+                errx(EXIT_FAILURE, "READ_FILE: Incorrect Mono color format");
+            #else
+                SB3_SetError(SB3_BAD_FORMAT_ERROR);
+                return NULL;
+            #endif
+        }
+        for(int x = 0; x < width; x++)
+        {
             if(format == SB3_RGB_FORMAT)
             {
-                SB3_RGBColor_t* color = malloc(sizeof(*color));
-                *color = (SB3_RGBColor_t) {
-                    .r = r,
-                    .g = g,
-                    .b = b,
-                };
+                SB3_RGBColor_t* color = __SB3_malloc(sizeof(*color));
+                memcpy(color, row + x * 3, 3);
                 rgb_pixels[y * width + x] = color;
             }
             else
             {
-                if(r == g && g == b)
-                {
-                    SB3_monoColor_t* color = malloc(sizeof(*color));
-                    color->color = r;
-                    mono_pixels[y * width + x] = color;
-                }
-                else
-                {
-                    if(bit_color < 16)
-                        free(color_table);
-                    fclose(file);
-                    for(int i = 0; i < y * width + x; i++)
-                        free(mono_pixels[i]);
-                    free(mono_pixels);
-                    #ifdef SB3_CRASH_WHEN_ERROR
-                        errx(EXIT_FAILURE, "READ_FILE: Incorrect Mono color format");
-                    #else
-                        SB3_SetError(SB3_BAD_FORMAT_ERROR);
-                        return NULL;
-                    #endif
-                }
+                SB3_monoColor_t* color = __SB3_malloc(sizeof(*color));
+                color->color = row[x];
+                mono_pixels[y * width + x] = color;
             }
         }
         for(int i = 0; i < padding; i++)
             fgetc(file);
     }
+    __SB3_free(packed);
+    __SB3_free(row);
     fclose(file);
 
-    SB3_image_t* image = malloc(sizeof(*image));
+    SB3_image_t* image = __SB3_malloc(sizeof(*image));
     *image = (SB3_image_t) {
         .w = width,
         .h = height,
@@ -586,7 +500,7 @@ SB3_image_t* SB3_BMP_read_image(const char* path, SB3_image_format_t format)
     };
     
     if(bit_color < 16)
-        free(color_table);
+        __SB3_free(color_table);
 
     SB3_SetError(SB3_SUCCESS_EXIT);
     return image;
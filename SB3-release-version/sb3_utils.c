@@ -63,9 +63,165 @@ void SB3_SetError(SB3_errors_t error)
     last_error = error;
 }
 
+/* ALLOCATOR */
+
+// counters of the blocks of one scope, freed with its last reference (the owner and each live block)
+// scopes use plain malloc, not the allocator that may change meanwhile
+struct SB3_allocator_scope_s {
+    size_t live_bytes, peak_bytes, allocations;
+    size_t references;
+};
+
+// every block starts with its size, the pointer given by the allocator and its scope, right before the returned address
+typedef struct {
+    size_t size;
+    void* base;
+    SB3_allocator_scope_t* scope;
+    size_t padding;
+} __SB3_block_t;
+
+_Static_assert(sizeof(__SB3_block_t) == 32, "block headers keep the 16 bytes alignment of malloc");
+
+// alignment of the pixel arrays given to aligned_alloc_fn
+#define __SB3_PIXELS_ALIGNMENT 64
+
+void* __SB3_default_malloc(size_t size, void* userdata)
+{
+    (void)userdata;
+    return malloc(size);
+}
+
+void __SB3_default_free(void* ptr, void* userdata)
+{
+    (void)userdata;
+    free(ptr);
+}
+
+static struct {
+    void* (*malloc_fn)(size_t size, void* userdata);
+    void (*free_fn)(void* ptr, void* userdata);
+    void* (*aligned_alloc_fn)(size_t alignment, size_t size, void* userdata);
+    void* userdata;
+} __SB3_allocator = {
+    .malloc_fn = __SB3_default_malloc,
+    .free_fn = __SB3_default_free,
+};
+
+static SB3_allocator_stats_t __SB3_stats;
+static SB3_allocator_scope_t* __SB3_scope = NULL;
+
+void SB3_SetAllocator(void* (*malloc_fn)(size_t size, void* userdata), void (*free_fn)(void* ptr, void* userdata),
+        void* (*aligned_alloc_fn)(size_t alignment, size_t size, void* userdata), void* userdata)
+{
+    char custom = malloc_fn && free_fn;
+    __SB3_allocator.malloc_fn = custom ? malloc_fn : __SB3_default_malloc;
+    __SB3_allocator.free_fn = custom ? free_fn : __SB3_default_free;
+    __SB3_allocator.aligned_alloc_fn = custom ? aligned_alloc_fn : NULL;
+    __SB3_allocator.userdata = custom ? userdata : NULL;
+}
+
+void SB3_GetAllocatorStats(SB3_allocator_stats_t* stats)
+{
+    *stats = __SB3_stats;
+}
+
+void SB3_ResetAllocatorStats(void)
+{
+    __SB3_stats.peak_bytes = __SB3_stats.live_bytes;
+    __SB3_stats.allocations = 0;
+}
+
+SB3_allocator_scope_t* SB3_NewAllocatorScope(void)
+{
+    SB3_allocator_scope_t* scope = malloc(sizeof(*scope));
+    *scope = (SB3_allocator_scope_t) {
+        .references = 1,
+    };
+    return scope;
+}
+
+void SB3_FreeAllocatorScope(SB3_allocator_scope_t* scope)
+{
+    if(scope && !--scope->references)
+        free(scope);
+}
+
+SB3_allocator_scope_t* SB3_SetAllocatorScope(SB3_allocator_scope_t* scope)
+{
+    SB3_allocator_scope_t* previous = __SB3_scope;
+    __SB3_scope = scope;
+    return previous;
+}
+
+void SB3_GetAllocatorScopeStats(SB3_allocator_scope_t* scope, SB3_allocator_stats_t* stats)
+{
+    *stats = (SB3_allocator_stats_t) {
+        .live_bytes = scope->live_bytes,
+        .peak_bytes = scope->peak_bytes,
+        .allocations = scope->allocations,
+    };
+}
+
+// header written, accounting updated (global counters and current scope)
+void* __SB3_block(void* base, size_t offset, size_t size)
+{
+    if(!base)
+        return NULL;
+    uint8_t* ptr = (uint8_t*)base + offset;
+    ((__SB3_block_t*)ptr)[-1] = (__SB3_block_t) { .size = size, .base = base, .scope = __SB3_scope };
+    __SB3_stats.live_bytes += size;
+    if(__SB3_stats.live_bytes > __SB3_stats.peak_bytes)
+        __SB3_stats.peak_bytes = __SB3_stats.live_bytes;
+    __SB3_stats.allocations++;
+    if(__SB3_scope)
+    {
+        __SB3_scope->references++;
+        __SB3_scope->live_bytes += size;
+        if(__SB3_scope->live_bytes > __SB3_scope->peak_bytes)
+            __SB3_scope->peak_bytes = __SB3_scope->live_bytes;
+        __SB3_scope->allocations++;
+    }
+    return ptr;
+}
+
+void* __SB3_malloc(size_t size)
+{
+    if(size > SIZE_MAX - sizeof(__SB3_block_t))
+        return NULL;
+    return __SB3_block(__SB3_allocator.malloc_fn(size + sizeof(__SB3_block_t), __SB3_allocator.userdata),
+        sizeof(__SB3_block_t), size);
+}
+
+// pixel pointer arrays: aligned_alloc_fn when given, the header lives in the first alignment bytes
+void* __SB3_pixels_alloc(size_t size)
+{
+    if(!__SB3_allocator.aligned_alloc_fn)
+        return __SB3_malloc(size);
+    if(size > SIZE_MAX - __SB3_PIXELS_ALIGNMENT)
+        return NULL;
+    return __SB3_block(__SB3_allocator.aligned_alloc_fn(__SB3_PIXELS_ALIGNMENT, size + __SB3_PIXELS_ALIGNMENT, __SB3_allocator.userdata),
+        __SB3_PIXELS_ALIGNMENT, size);
+}
+
+void __SB3_free(void* ptr)
+{
+    if(!ptr)
+        return;
+    __SB3_block_t block = ((__SB3_block_t*)ptr)[-1];
+    __SB3_stats.live_bytes -= block.size;
+    if(block.scope)
+    {
+        block.scope->live_bytes -= block.size;
+        SB3_FreeAllocatorScope(block.scope);
+    }
+    __SB3_allocator.free_fn(block.base, __SB3_allocator.userdata);
+}
+
+/* UTILS */
+
 SB3_RGBColor_t* SB3_NewRGB(uint8_t r, uint8_t g, uint8_t b)
 {
-    SB3_RGBColor_t* color = malloc(sizeof(*color));
+    SB3_RGBColor_t* color = __SB3_malloc(sizeof(*color));
     *color = (SB3_RGBColor_t) {
         .r = r,
         .g = g,
@@ -76,7 +232,7 @@ SB3_RGBColor_t* SB3_NewRGB(uint8_t r, uint8_t g, uint8_t b)
 
 SB3_monoColor_t* SB3_NewMonoColor(uint8_t color)
 {
-    SB3_monoColor_t* res = malloc(sizeof(*res));
+    SB3_monoColor_t* res = __SB3_malloc(sizeof(*res));
     *res = (SB3_monoColor_t) {
         .color = color,
     };
@@ -85,17 +241,17 @@ SB3_monoColor_t* SB3_NewMonoColor(uint8_t color)
 
 void SB3_RGBFreeColor(SB3_RGBColor_t* color)
 {
-    free(color);
+    __SB3_free(color);
 }
 
 void SB3_MonoFreeColor(SB3_monoColor_t* color)
 {
-    free(color);
+    __SB3_free(color);
 }
 
 SB3_image_t* SB3_NewImage(int width, int height, SB3_image_format_t format)
 {
-    SB3_image_t* image = malloc(sizeof(*image));
+    SB3_image_t* image = __SB3_malloc(sizeof(*image));
     *image = (SB3_image_t) {
         .w = width,
         .h = height,
@@ -105,14 +261,14 @@ SB3_image_t* SB3_NewImage(int width, int height, SB3_image_format_t format)
     };
     if(format == SB3_RGB_FORMAT)
     {
-        SB3_RGBColor_t** pixels = malloc(width * height * sizeof(SB3_RGBColor_t*));
+        SB3_RGBColor_t** pixels = __SB3_pixels_alloc(width * height * sizeof(SB3_RGBColor_t*));
         for(int i = 0; i < width*height; i++)
             pixels[i] = SB3_NewRGB(0,0,0);
         image->rgb_pixels = pixels;
     }
     else
     {
-        SB3_monoColor_t** pixels = malloc(width * height * sizeof(SB3_monoColor_t*));
+        SB3_monoColor_t** pixels = __SB3_pixels_alloc(width * height * sizeof(SB3_monoColor_t*));
         for(int i = 0; i < width*height; i++)
             pixels[i] = SB3_NewMonoColor(0);
         image->mono_pixels = pixels;
@@ -126,15 +282,15 @@ void SB3_FreeImage(SB3_image_t* image)
     {
         for(int i = 0; i < image->w * image->h; i++)
             SB3_RGBFreeColor(image->rgb_pixels[i]);
-        free(image->rgb_pixels);
+        __SB3_free(image->rgb_pixels);
     }
     else
     {
         for(int i = 0; i < image->w * image->h; i++)
             SB3_MonoFreeColor(image->mono_pixels[i]);
-        free(image->mono_pixels);
+        __SB3_free(image->mono_pixels);
     }
-    free(image);
+    __SB3_free(image);
 }
 
 /* to cast in SB3_RGBColor_t* or in SB3_monoColor_t* */